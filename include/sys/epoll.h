@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+
+/*
+ * Events are reported from nsysnet select, so EPOLLERR and EPOLLHUP are
+ * never set: a failed or closed socket shows up as readable and the error
+ * is returned by the next recv.
+ */
+#define EPOLLIN       0x001
+#define EPOLLPRI      0x002
+#define EPOLLOUT      0x004
+#define EPOLLERR      0x008
+#define EPOLLHUP      0x010
+#define EPOLLONESHOT  (1u << 30)
+#define EPOLLET       (1u << 31)
+
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
+#define EPOLL_CLOEXEC 0x80000
+
+typedef union epoll_data
+{
+   void *ptr;
+   int fd;
+   uint32_t u32;
+   uint64_t u64;
+} epoll_data_t;
+
+struct epoll_event
+{
+   uint32_t events;
+   epoll_data_t data;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int
+epoll_create(int size);
+
+int
+epoll_create1(int flags);
+
+int
+epoll_ctl(int epfd,
+          int op,
+          int fd,
+          struct epoll_event *event);
+
+int
+epoll_wait(int epfd,
+           struct epoll_event *events,
+           int maxevents,
+           int timeout);
+
+#ifdef __cplusplus
+}
+#endif
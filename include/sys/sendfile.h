@@ -0,0 +1,26 @@
+#pragma once
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Copy count bytes from a file opened on the fs devoptab to out_fd, which is
+ * usually a socket.
+ *
+ * Transfers larger than one chunk read the next chunk on a helper thread
+ * while the current one is written. If offset is not NULL the transfer
+ * starts there and *offset is advanced, leaving the file offset unchanged.
+ * On a non-blocking socket the call returns as soon as the socket would
+ * block, and the offset only counts the bytes actually written.
+ */
+ssize_t
+sendfile(int out_fd,
+         int in_fd,
+         off_t *offset,
+         size_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,7 @@
 #pragma once
 #include <stdint.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 
 #define SOL_SOCKET     -1
 
@@ -17,6 +18,7 @@
 #define MSG_PEEK       0x0002
 #define MSG_DONTROUTE  0x0004
 #define MSG_DONTWAIT   0x0020
+#define MSG_WAITFORONE 0x10000 // recvmmsg only, handled by wut
 
 #define SHUT_RD        0
 #define SHUT_WR        1
@@ -72,6 +74,23 @@ struct sockaddr_storage
    char ss_padding[14];
 };
 
+struct msghdr
+{
+   void *msg_name;
+   socklen_t msg_namelen;
+   struct iovec *msg_iov;
+   int msg_iovlen;
+   void *msg_control;
+   socklen_t msg_controllen;
+   int msg_flags;
+};
+
+struct mmsghdr
+{
+   struct msghdr msg_hdr;
+   unsigned int msg_len;
+};
+
 struct linger
 {
    int l_onoff;
@@ -132,12 +151,35 @@ recvfrom(int sockfd,
          struct sockaddr *src_addr,
          socklen_t *addrlen);
 
+ssize_t
+recvmsg(int sockfd,
+        struct msghdr *msg,
+        int flags);
+
+int
+recvmmsg(int sockfd,
+         struct mmsghdr *msgvec,
+         unsigned int vlen,
+         int flags,
+         struct timespec *timeout);
+
 ssize_t
 send(int sockfd,
      const void *buf,
      size_t len,
      int flags);
 
+int
+sendmmsg(int sockfd,
+         struct mmsghdr *msgvec,
+         unsigned int vlen,
+         int flags);
+
+ssize_t
+sendmsg(int sockfd,
+        const struct msghdr *msg,
+        int flags);
+
 ssize_t
 sendto(int sockfd,
        const void *buf,
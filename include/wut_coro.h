@@ -0,0 +1,818 @@
+#pragma once
+#include <wut.h>
+#include <coreinit/alarm.h>
+#include <coreinit/event.h>
+#include <coreinit/filesystem.h>
+#include <coreinit/messagequeue.h>
+#include <coreinit/spinlock.h>
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+#include <poll.h>
+
+/**
+ * \defgroup wut_coro Coroutines
+ *
+ * C++20 coroutines driven by executors, with awaitables for timers, file
+ * I/O, socket readiness and GPU timestamps.
+ *
+ * An executor runs the coroutines posted to it on a single thread, either
+ * the thread calling Executor::run or one of the threads of a
+ * PerCoreExecutor which runs an executor on each core. Awaiting an I/O
+ * operation suspends the coroutine until the executor resumes it with the
+ * result, so thousands of concurrent flows need no thread each.
+ *
+ * \code
+ * wut::coro::Task<void>
+ * echo(wut::coro::Executor &executor, int fd)
+ * {
+ *    char buffer[512];
+ *    while (co_await wut::coro::readable(executor, fd) & POLLIN) {
+ *       int length = recv(fd, buffer, sizeof(buffer), 0);
+ *       if (length <= 0) {
+ *          break;
+ *       }
+ *
+ *       co_await wut::coro::writable(executor, fd);
+ *       send(fd, buffer, length, 0);
+ *    }
+ *
+ *    close(fd);
+ * }
+ *
+ * wut::coro::Executor executor;
+ * wut::coro::spawn(executor, echo(executor, fd));
+ * executor.run();
+ * \endcode
+ *
+ * Coroutine frames are allocated from size class pools, so starting a
+ * coroutine does not touch the heap once the pools have grown.
+ *
+ * The executors are available to any C++ code, the coroutine types and
+ * awaitables require C++20.
+ * @{
+ */
+
+#ifdef __cplusplus
+
+#include <cstddef>
+#include <cstdint>
+
+namespace wut
+{
+
+namespace coro
+{
+
+/**
+ * Something an executor runs, awaitables derive from this to resume their
+ * coroutine.
+ */
+struct Operation
+{
+   Operation *next = nullptr;
+   void (*complete)(Operation *operation) = nullptr;
+};
+
+//! Wait for a socket to become ready.
+struct SocketWait : Operation
+{
+   SocketWait *nextWait = nullptr;
+   int fd               = -1;
+   int events           = 0;
+   int revents          = 0;
+};
+
+//! Wait until the system time reaches a deadline.
+struct TimerWait : Operation
+{
+   TimerWait *nextWait = nullptr;
+   OSTime deadline     = 0;
+};
+
+//! Wait for the GPU to retire a timestamp.
+struct GpuWait : Operation
+{
+   GpuWait *nextWait = nullptr;
+   OSTime timestamp  = 0;
+};
+
+/**
+ * Runs operations on a single thread.
+ *
+ * post may be called from any thread and from alarm and file system
+ * callbacks, everything else must be called on the thread running the
+ * executor.
+ */
+class Executor
+{
+public:
+   Executor();
+   ~Executor();
+
+   Executor(const Executor &) = delete;
+   Executor &operator=(const Executor &) = delete;
+
+   //! Queue an operation to run on the executor thread.
+   void
+   post(Operation *operation);
+
+   //! Complete operation once the socket is ready for the given poll events.
+   void
+   wait_socket(SocketWait *wait);
+
+   //! Complete operation once GX2GetRetiredTimeStamp reaches its timestamp.
+   void
+   wait_gpu(GpuWait *wait);
+
+   //! Complete operation once OSGetSystemTime reaches its deadline, may be
+   //! called from any thread.
+   void
+   wait_timer(TimerWait *wait);
+
+   //! Run operations until stop is called.
+   void
+   run();
+
+   //! Run operations which are ready without blocking, returns the number run.
+   uint32_t
+   poll();
+
+   //! Make run return, may be called from any thread.
+   void
+   stop();
+
+   //! Reset a stopped executor so it can run again.
+   void
+   restart();
+
+private:
+   uint32_t
+   run_ready();
+
+   uint32_t
+   poll_waits();
+
+   void
+   poll_each_socket();
+
+   OSSpinLock mLock;
+   Operation *mHead = nullptr;
+   Operation *mTail = nullptr;
+
+   OSEvent mWakeEvent;
+   volatile uint32_t mStopping = 0;
+
+   //! Milliseconds to sleep between polls of socket and GPU waits.
+   uint32_t mPollBackoff;
+
+   SocketWait *mSocketWaits = nullptr;
+   uint32_t mSocketWaitCount = 0;
+   GpuWait *mGpuWaits = nullptr;
+
+   //! Sorted by deadline, protected by mLock.
+   TimerWait *mTimerWaits = nullptr;
+
+   struct pollfd *mPollFds = nullptr;
+   uint32_t mPollCapacity = 0;
+};
+
+/**
+ * One executor per core, each running on a thread pinned to its core.
+ */
+class PerCoreExecutor
+{
+public:
+   static constexpr uint32_t CoreCount = 3;
+
+   PerCoreExecutor();
+   ~PerCoreExecutor();
+
+   PerCoreExecutor(const PerCoreExecutor &) = delete;
+   PerCoreExecutor &operator=(const PerCoreExecutor &) = delete;
+
+   //! Start the threads, returns false if they could not be created.
+   bool
+   start();
+
+   //! Stop and join the threads.
+   void
+   stop();
+
+   //! Executor running on the given core.
+   Executor &
+   core(uint32_t core)
+   {
+      return mExecutors[core % CoreCount];
+   }
+
+   //! Pick an executor in round robin order.
+   Executor &
+   next();
+
+private:
+   Executor mExecutors[CoreCount];
+   OSThread *mThreads[CoreCount] = {};
+   volatile uint32_t mNext = 0;
+};
+
+namespace detail
+{
+
+//! Allocate a coroutine frame from the size class pools.
+void *
+allocate_frame(std::size_t size);
+
+void
+free_frame(void *frame,
+           std::size_t size);
+
+} // namespace detail
+
+} // namespace coro
+
+} // namespace wut
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#include <gx2/event.h>
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <new>
+#include <utility>
+
+namespace wut
+{
+
+namespace coro
+{
+
+namespace detail
+{
+
+struct PooledFrame
+{
+   static void *
+   operator new(std::size_t size)
+   {
+      void *frame = allocate_frame(size);
+      if (!frame) {
+         std::terminate();
+      }
+      return frame;
+   }
+
+   static void
+   operator delete(void *frame,
+                   std::size_t size)
+   {
+      free_frame(frame, size);
+   }
+};
+
+template<typename T>
+struct TaskResult
+{
+   alignas(T) unsigned char storage[sizeof(T)];
+   bool hasValue = false;
+
+   template<typename U>
+   void
+   return_value(U &&value)
+   {
+      new (storage) T(std::forward<U>(value));
+      hasValue = true;
+   }
+
+   T &
+   value()
+   {
+      return *reinterpret_cast<T *>(storage);
+   }
+
+   ~TaskResult()
+   {
+      if (hasValue) {
+         value().~T();
+      }
+   }
+};
+
+template<>
+struct TaskResult<void>
+{
+   void
+   return_void()
+   {
+   }
+
+   void
+   value()
+   {
+   }
+};
+
+} // namespace detail
+
+/**
+ * Lazily started coroutine, runs when awaited and resumes the awaiting
+ * coroutine when it finishes.
+ */
+template<typename T = void>
+class [[nodiscard]] Task
+{
+public:
+   struct promise_type : detail::PooledFrame, detail::TaskResult<T>
+   {
+      std::coroutine_handle<> continuation = std::noop_coroutine();
+
+      Task
+      get_return_object()
+      {
+         return Task { std::coroutine_handle<promise_type>::from_promise(*this) };
+      }
+
+      std::suspend_always
+      initial_suspend() noexcept
+      {
+         return {};
+      }
+
+      auto
+      final_suspend() noexcept
+      {
+         struct FinalAwaiter
+         {
+            bool
+            await_ready() noexcept
+            {
+               return false;
+            }
+
+            std::coroutine_handle<>
+            await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+            {
+               return handle.promise().continuation;
+            }
+
+            void
+            await_resume() noexcept
+            {
+            }
+         };
+
+         return FinalAwaiter {};
+      }
+
+      void
+      unhandled_exception()
+      {
+         std::terminate();
+      }
+   };
+
+   Task(Task &&other) noexcept :
+      mHandle(std::exchange(other.mHandle, nullptr))
+   {
+   }
+
+   Task &
+   operator=(Task &&other) noexcept
+   {
+      if (this != &other) {
+         if (mHandle) {
+            mHandle.destroy();
+         }
+         mHandle = std::exchange(other.mHandle, nullptr);
+      }
+      return *this;
+   }
+
+   ~Task()
+   {
+      if (mHandle) {
+         mHandle.destroy();
+      }
+   }
+
+   bool
+   await_ready() const noexcept
+   {
+      return !mHandle || mHandle.done();
+   }
+
+   std::coroutine_handle<>
+   await_suspend(std::coroutine_handle<> awaiting) noexcept
+   {
+      mHandle.promise().continuation = awaiting;
+      return mHandle;
+   }
+
+   auto
+   await_resume()
+   {
+      if constexpr (std::is_void_v<T>) {
+         return;
+      } else {
+         return std::move(mHandle.promise().value());
+      }
+   }
+
+private:
+   explicit Task(std::coroutine_handle<promise_type> handle) :
+      mHandle(handle)
+   {
+   }
+
+   std::coroutine_handle<promise_type> mHandle;
+};
+
+namespace detail
+{
+
+struct DetachedTask
+{
+   struct promise_type : PooledFrame
+   {
+      DetachedTask
+      get_return_object()
+      {
+         return {};
+      }
+
+      std::suspend_never
+      initial_suspend() noexcept
+      {
+         return {};
+      }
+
+      std::suspend_never
+      final_suspend() noexcept
+      {
+         return {};
+      }
+
+      void
+      return_void()
+      {
+      }
+
+      void
+      unhandled_exception()
+      {
+         std::terminate();
+      }
+   };
+};
+
+/**
+ * Base for awaiters completed by an executor.
+ */
+struct ResumeOperation : Operation
+{
+   std::coroutine_handle<> handle;
+
+   ResumeOperation()
+   {
+      complete = [](Operation *operation) {
+         static_cast<ResumeOperation *>(operation)->handle.resume();
+      };
+   }
+};
+
+} // namespace detail
+
+/**
+ * Resume on the executor's thread.
+ */
+inline auto
+schedule(Executor &executor)
+{
+   struct Awaiter : detail::ResumeOperation
+   {
+      Executor &executor;
+
+      explicit Awaiter(Executor &executor) :
+         executor(executor)
+      {
+      }
+
+      bool
+      await_ready() noexcept
+      {
+         return false;
+      }
+
+      void
+      await_suspend(std::coroutine_handle<> awaiting) noexcept
+      {
+         handle = awaiting;
+         executor.post(this);
+      }
+
+      void
+      await_resume() noexcept
+      {
+      }
+   };
+
+   return Awaiter { executor };
+}
+
+namespace detail
+{
+
+inline DetachedTask
+run_detached(Executor &executor,
+             Task<void> task)
+{
+   co_await schedule(executor);
+   co_await std::move(task);
+}
+
+} // namespace detail
+
+/**
+ * Start a task on an executor without waiting for it, the task frees
+ * itself once finished.
+ */
+inline void
+spawn(Executor &executor,
+      Task<void> task)
+{
+   detail::run_detached(executor, std::move(task));
+}
+
+/**
+ * Sleep for a number of ticks, resuming on executor.
+ *
+ * The executor keeps the timer itself rather than using an OSAlarm, whose
+ * handler could still be using the alarm after the coroutine owning it has
+ * resumed on another core.
+ */
+inline auto
+sleep_for(Executor &executor,
+          OSTime ticks)
+{
+   struct Awaiter : TimerWait
+   {
+      Executor &executor;
+      OSTime ticks;
+      std::coroutine_handle<> handle;
+
+      Awaiter(Executor &executor, OSTime ticks) :
+         executor(executor),
+         ticks(ticks)
+      {
+         complete = [](Operation *operation) {
+            static_cast<Awaiter *>(operation)->handle.resume();
+         };
+      }
+
+      bool
+      await_ready() noexcept
+      {
+         return ticks <= 0;
+      }
+
+      void
+      await_suspend(std::coroutine_handle<> awaiting) noexcept
+      {
+         handle   = awaiting;
+         deadline = OSGetSystemTime() + ticks;
+         executor.wait_timer(this);
+      }
+
+      void
+      await_resume() noexcept
+      {
+      }
+   };
+
+   return Awaiter { executor, ticks };
+}
+
+template<typename Rep, typename Period>
+inline auto
+sleep_for(Executor &executor,
+          std::chrono::duration<Rep, Period> duration)
+{
+   auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+   return sleep_for(executor, (OSTime)OSMicrosecondsToTicks(us));
+}
+
+namespace detail
+{
+
+struct FileAwaiter : ResumeOperation
+{
+   using AsyncFn = FSStatus (*)(FSClient *, FSCmdBlock *, uint8_t *, uint32_t, uint32_t,
+                                FSFileHandle, uint32_t, FSErrorFlag, FSAsyncData *);
+
+   Executor &executor;
+   AsyncFn function;
+   FSClient *client;
+   FSCmdBlock *block;
+   uint8_t *buffer;
+   uint32_t size;
+   uint32_t count;
+   FSFileHandle file;
+   FSErrorFlag errorMask;
+   FSAsyncData asyncData;
+   FSStatus status = FS_STATUS_OK;
+
+   FileAwaiter(Executor &executor, AsyncFn function, FSClient *client, FSCmdBlock *block,
+               uint8_t *buffer, uint32_t size, uint32_t count, FSFileHandle file,
+               FSErrorFlag errorMask) :
+      executor(executor),
+      function(function),
+      client(client),
+      block(block),
+      buffer(buffer),
+      size(size),
+      count(count),
+      file(file),
+      errorMask(errorMask)
+   {
+   }
+
+   bool
+   await_ready() noexcept
+   {
+      return false;
+   }
+
+   void
+   await_suspend(std::coroutine_handle<> awaiting) noexcept
+   {
+      // The callback runs on the file system thread, hand the result over
+      // to the executor.
+      handle               = awaiting;
+      asyncData.callback   = [](FSClient *, FSCmdBlock *, FSStatus status, uint32_t context) {
+         auto self    = reinterpret_cast<FileAwaiter *>(context);
+         self->status = status;
+         self->executor.post(self);
+      };
+      asyncData.param      = reinterpret_cast<uint32_t>(this);
+      asyncData.ioMsgQueue = nullptr;
+
+      FSStatus result = function(client, block, buffer, size, count, file, 0, errorMask, &asyncData);
+      if (result < 0) {
+         status = result;
+         executor.post(this);
+      }
+   }
+
+   FSStatus
+   await_resume() noexcept
+   {
+      return status;
+   }
+};
+
+} // namespace detail
+
+/**
+ * Read from a file, the awaited value is the FSReadFile result: the number
+ * of elements read or a negative FSStatus.
+ */
+inline detail::FileAwaiter
+read_file(Executor &executor,
+          FSClient *client,
+          FSCmdBlock *block,
+          uint8_t *buffer,
+          uint32_t size,
+          uint32_t count,
+          FSFileHandle handle,
+          FSErrorFlag errorMask = FS_ERROR_FLAG_ALL)
+{
+   return detail::FileAwaiter { executor, FSReadFileAsync, client, block, buffer, size, count, handle, errorMask };
+}
+
+/**
+ * Write to a file, the awaited value is the FSWriteFile result: the number
+ * of elements written or a negative FSStatus.
+ */
+inline detail::FileAwaiter
+write_file(Executor &executor,
+           FSClient *client,
+           FSCmdBlock *block,
+           uint8_t *buffer,
+           uint32_t size,
+           uint32_t count,
+           FSFileHandle handle,
+           FSErrorFlag errorMask = FS_ERROR_FLAG_ALL)
+{
+   return detail::FileAwaiter { executor, FSWriteFileAsync, client, block, buffer, size, count, handle, errorMask };
+}
+
+namespace detail
+{
+
+struct SocketAwaiter : SocketWait
+{
+   Executor &executor;
+   std::coroutine_handle<> handle;
+
+   SocketAwaiter(Executor &executor, int fd, int events) :
+      executor(executor)
+   {
+      this->fd     = fd;
+      this->events = events;
+      complete     = [](Operation *operation) {
+         static_cast<SocketAwaiter *>(operation)->handle.resume();
+      };
+   }
+
+   bool
+   await_ready() noexcept
+   {
+      return false;
+   }
+
+   void
+   await_suspend(std::coroutine_handle<> awaiting) noexcept
+   {
+      handle = awaiting;
+      executor.wait_socket(this);
+   }
+
+   //! The poll revents of the socket.
+   int
+   await_resume() noexcept
+   {
+      return revents;
+   }
+};
+
+} // namespace detail
+
+//! Wait until a socket is readable, returns the poll revents.
+inline detail::SocketAwaiter
+readable(Executor &executor,
+         int fd)
+{
+   return detail::SocketAwaiter { executor, fd, POLLIN };
+}
+
+//! Wait until a socket is writable, returns the poll revents.
+inline detail::SocketAwaiter
+writable(Executor &executor,
+         int fd)
+{
+   return detail::SocketAwaiter { executor, fd, POLLOUT };
+}
+
+/**
+ * Wait until the GPU has retired a timestamp, for example one returned by
+ * GX2GetLastSubmittedTimeStamp after submitting a frame.
+ */
+inline auto
+gpu_timestamp(Executor &executor,
+              OSTime timestamp)
+{
+   struct Awaiter : GpuWait
+   {
+      Executor &executor;
+      std::coroutine_handle<> handle;
+
+      Awaiter(Executor &executor, OSTime timestamp) :
+         executor(executor)
+      {
+         this->timestamp = timestamp;
+         complete        = [](Operation *operation) {
+            static_cast<Awaiter *>(operation)->handle.resume();
+         };
+      }
+
+      bool
+      await_ready() noexcept
+      {
+         return GX2GetRetiredTimeStamp() >= timestamp;
+      }
+
+      void
+      await_suspend(std::coroutine_handle<> awaiting) noexcept
+      {
+         handle = awaiting;
+         executor.wait_gpu(this);
+      }
+
+      void
+      await_resume() noexcept
+      {
+      }
+   };
+
+   return Awaiter { executor, timestamp };
+}
+
+} // namespace coro
+
+} // namespace wut
+
+#endif
+
+#endif
+
+/** @} */
@@ -0,0 +1,92 @@
+#pragma once
+#include <wut.h>
+#include <netdb.h>
+
+/**
+ * \defgroup wut_dns DNS Resolver
+ *
+ * Caching and asynchronous name resolution on top of nsysnet.
+ *
+ * getaddrinfo keeps successful lookups for `__wut_dns_cache_ttl` seconds
+ * and names which do not exist for `__wut_dns_negative_ttl` seconds, and
+ * threads asking for the same name at the same time share a single query.
+ * Numeric hosts and AI_NUMERICHOST lookups bypass the cache. The settings
+ * are weak symbols an application can override:
+ *
+ * \code
+ * uint32_t __wut_dns_cache_size = 64;
+ * uint32_t __wut_dns_cache_ttl  = 300;
+ * \endcode
+ *
+ * WUTGetAddrInfoAsync runs a lookup on one of `__wut_dns_threads` resolver
+ * threads, started on first use, and calls back when it completes:
+ *
+ * \code
+ * static void
+ * onResolved(int status, struct addrinfo *res, void *context)
+ * {
+ *    if (status == 0) {
+ *       OSMessage message = { res, { 0 } };
+ *       OSSendMessage((OSMessageQueue *)context, &message, OS_MESSAGE_FLAGS_BLOCKING);
+ *    }
+ * }
+ *
+ * WUTGetAddrInfoAsync("example.com", "443", &hints, onResolved, &queue);
+ * \endcode
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Called on a resolver thread when an asynchronous lookup completes.
+ *
+ * \param status
+ * 0 or an EAI_* error as returned by getaddrinfo.
+ *
+ * \param res
+ * The result, which the callback owns and frees with freeaddrinfo.
+ */
+typedef void (*WUTAddrInfoCallback)(int status,
+                                    struct addrinfo *res,
+                                    void *context);
+
+//! Number of cached names, 0 disables the cache. Defaults to 32.
+extern uint32_t __wut_dns_cache_size;
+
+//! Seconds a successful lookup is cached. Defaults to 60.
+extern uint32_t __wut_dns_cache_ttl;
+
+//! Seconds a lookup of a name which does not exist is cached. Defaults to 5.
+extern uint32_t __wut_dns_negative_ttl;
+
+//! Number of threads serving asynchronous lookups. Defaults to 2.
+extern uint32_t __wut_dns_threads;
+
+/**
+ * Resolve a name asynchronously, the arguments match getaddrinfo.
+ *
+ * \return
+ * 0 if the lookup was queued, otherwise an EAI_* error and callback is not
+ * called.
+ */
+int
+WUTGetAddrInfoAsync(const char *node,
+                    const char *service,
+                    const struct addrinfo *hints,
+                    WUTAddrInfoCallback callback,
+                    void *context);
+
+/**
+ * Drop every cached lookup, including the nsysnet resolver cache.
+ */
+void
+WUTFlushAddrInfoCache(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
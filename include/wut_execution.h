@@ -0,0 +1,670 @@
+#pragma once
+#include <wut.h>
+
+/**
+ * \defgroup wut_execution Parallel Algorithms
+ *
+ * Parallel versions of the C++17 standard algorithms, running on the
+ * wut_sched workers pinned to each core.
+ *
+ * libstdc++ chooses the backend for `std::execution::par` when it is built
+ * and there is none for the Wii U, so parallel `std::` algorithms run
+ * serially. The algorithms here take the same arguments with a
+ * `wut::execution` policy instead:
+ *
+ * \code
+ * std::sort(std::execution::par, queue.begin(), queue.end(), byDepth);
+ * // becomes
+ * wut::sort(wut::execution::par, queue.begin(), queue.end(), byDepth);
+ * \endcode
+ *
+ * Only random access iterators are supported. Ranges too small to be worth
+ * splitting run serially on the calling thread. Like the standard parallel
+ * algorithms, reduce and the scans may combine elements in any grouping so
+ * their operation should be associative.
+ * @{
+ */
+
+#ifdef __cplusplus
+
+#include <wut_sched.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace wut
+{
+
+namespace execution
+{
+
+struct sequenced_policy
+{
+};
+
+struct parallel_policy
+{
+};
+
+struct parallel_unsequenced_policy : parallel_policy
+{
+};
+
+inline constexpr sequenced_policy seq {};
+inline constexpr parallel_policy par {};
+inline constexpr parallel_unsequenced_policy par_unseq {};
+
+} // namespace execution
+
+namespace detail
+{
+
+//! Ranges below this many elements are not split further.
+constexpr uint32_t ParallelMinGrain = 512;
+
+//! Number of pieces a range is split into per worker.
+constexpr uint32_t ParallelSplitsPerCore = 4;
+
+template<typename Iterator>
+using is_random_access = std::is_base_of<std::random_access_iterator_tag,
+                                         typename std::iterator_traits<Iterator>::iterator_category>;
+
+inline uint32_t
+parallel_grain(uint32_t size)
+{
+   uint32_t grain = size / (3 * ParallelSplitsPerCore);
+   return grain < ParallelMinGrain ? ParallelMinGrain : grain;
+}
+
+/**
+ * Split [0, size) into equal chunks and call function(chunk, begin, end)
+ * for each of them in parallel, returns the number of chunks.
+ */
+template<typename Function>
+uint32_t
+parallel_chunks(uint32_t size,
+                Function &&function)
+{
+   uint32_t grain  = parallel_grain(size);
+   uint32_t chunks = (size + grain - 1) / grain;
+
+   wut::parallel_for(0, chunks, 1, [&](uint32_t chunk) {
+      uint32_t begin = chunk * grain;
+      uint32_t end   = (size - begin > grain) ? begin + grain : size;
+      function(chunk, begin, end);
+   });
+
+   return chunks;
+}
+
+/**
+ * Iterator over the integers, used to walk two ranges in step.
+ */
+struct IndexIterator
+{
+   using iterator_category = std::random_access_iterator_tag;
+   using value_type        = uint32_t;
+   using difference_type   = std::ptrdiff_t;
+   using pointer           = const uint32_t *;
+   using reference         = uint32_t;
+
+   uint32_t index;
+
+   uint32_t
+   operator*() const
+   {
+      return index;
+   }
+
+   uint32_t
+   operator[](difference_type n) const
+   {
+      return static_cast<uint32_t>(index + n);
+   }
+
+   IndexIterator &
+   operator++()
+   {
+      ++index;
+      return *this;
+   }
+
+   IndexIterator
+   operator+(difference_type n) const
+   {
+      return { static_cast<uint32_t>(index + n) };
+   }
+
+   difference_type
+   operator-(const IndexIterator &other) const
+   {
+      return static_cast<difference_type>(index) - static_cast<difference_type>(other.index);
+   }
+
+   bool
+   operator!=(const IndexIterator &other) const
+   {
+      return index != other.index;
+   }
+};
+
+template<typename RandomIt, typename Compare, typename Sort>
+void
+parallel_sort(RandomIt first,
+              RandomIt last,
+              Compare comp,
+              Sort sortChunk)
+{
+   static_assert(is_random_access<RandomIt>::value, "wut::sort requires random access iterators");
+   uint32_t size = static_cast<uint32_t>(last - first);
+
+   if (size < 2 * ParallelMinGrain) {
+      sortChunk(first, last, comp);
+      return;
+   }
+
+   // Sort equal chunks in parallel, then merge neighbouring runs in pairs
+   // until a single run is left.
+   uint32_t grain  = parallel_grain(size);
+   uint32_t chunks = (size + grain - 1) / grain;
+
+   wut::parallel_for(0, chunks, 1, [&](uint32_t chunk) {
+      uint32_t begin = chunk * grain;
+      uint32_t end   = (size - begin > grain) ? begin + grain : size;
+      sortChunk(first + begin, first + end, comp);
+   });
+
+   for (uint32_t run = grain; run < size; run *= 2) {
+      uint32_t pairs = (size + 2 * run - 1) / (2 * run);
+
+      wut::parallel_for(0, pairs, 1, [&](uint32_t pair) {
+         uint32_t begin = pair * 2 * run;
+         uint32_t mid   = (size - begin > run) ? begin + run : size;
+         uint32_t end   = (size - mid > run) ? mid + run : size;
+         if (mid < end) {
+            std::inplace_merge(first + begin, first + mid, first + end, comp);
+         }
+      });
+   }
+}
+
+} // namespace detail
+
+/*
+ * for_each, for_each_n
+ */
+template<typename RandomIt, typename Function>
+void
+for_each(const execution::sequenced_policy &,
+         RandomIt first,
+         RandomIt last,
+         Function function)
+{
+   std::for_each(first, last, function);
+}
+
+template<typename RandomIt, typename Function>
+void
+for_each(const execution::parallel_policy &,
+         RandomIt first,
+         RandomIt last,
+         Function function)
+{
+   static_assert(detail::is_random_access<RandomIt>::value, "wut::for_each requires random access iterators");
+   uint32_t size = static_cast<uint32_t>(last - first);
+
+   wut::parallel_for(0, size, detail::parallel_grain(size), [&](uint32_t i) {
+      function(first[i]);
+   });
+}
+
+template<typename Policy, typename RandomIt, typename Size, typename Function>
+RandomIt
+for_each_n(const Policy &policy,
+           RandomIt first,
+           Size count,
+           Function function)
+{
+   if (count <= 0) {
+      return first;
+   }
+
+   wut::for_each(policy, first, first + count, function);
+   return first + count;
+}
+
+/*
+ * transform
+ */
+template<typename InputIt, typename OutputIt, typename UnaryOp>
+OutputIt
+transform(const execution::sequenced_policy &,
+          InputIt first,
+          InputIt last,
+          OutputIt result,
+          UnaryOp op)
+{
+   return std::transform(first, last, result, op);
+}
+
+template<typename InputIt, typename OutputIt, typename UnaryOp>
+OutputIt
+transform(const execution::parallel_policy &,
+          InputIt first,
+          InputIt last,
+          OutputIt result,
+          UnaryOp op)
+{
+   static_assert(detail::is_random_access<InputIt>::value && detail::is_random_access<OutputIt>::value,
+                 "wut::transform requires random access iterators");
+   uint32_t size = static_cast<uint32_t>(last - first);
+
+   wut::parallel_for(0, size, detail::parallel_grain(size), [&](uint32_t i) {
+      result[i] = op(first[i]);
+   });
+
+   return result + size;
+}
+
+template<typename InputIt1, typename InputIt2, typename OutputIt, typename BinaryOp>
+OutputIt
+transform(const execution::sequenced_policy &,
+          InputIt1 first1,
+          InputIt1 last1,
+          InputIt2 first2,
+          OutputIt result,
+          BinaryOp op)
+{
+   return std::transform(first1, last1, first2, result, op);
+}
+
+template<typename InputIt1, typename InputIt2, typename OutputIt, typename BinaryOp>
+OutputIt
+transform(const execution::parallel_policy &,
+          InputIt1 first1,
+          InputIt1 last1,
+          InputIt2 first2,
+          OutputIt result,
+          BinaryOp op)
+{
+   static_assert(detail::is_random_access<InputIt1>::value && detail::is_random_access<InputIt2>::value &&
+                    detail::is_random_access<OutputIt>::value,
+                 "wut::transform requires random access iterators");
+   uint32_t size = static_cast<uint32_t>(last1 - first1);
+
+   wut::parallel_for(0, size, detail::parallel_grain(size), [&](uint32_t i) {
+      result[i] = op(first1[i], first2[i]);
+   });
+
+   return result + size;
+}
+
+/*
+ * transform_reduce, reduce
+ */
+template<typename RandomIt, typename T, typename BinaryOp, typename UnaryOp>
+T
+transform_reduce(const execution::sequenced_policy &,
+                 RandomIt first,
+                 RandomIt last,
+                 T init,
+                 BinaryOp reduce,
+                 UnaryOp transform)
+{
+   for (; first != last; ++first) {
+      init = reduce(std::move(init), transform(*first));
+   }
+
+   return init;
+}
+
+template<typename RandomIt, typename T, typename BinaryOp, typename UnaryOp>
+T
+transform_reduce(const execution::parallel_policy &,
+                 RandomIt first,
+                 RandomIt last,
+                 T init,
+                 BinaryOp reduce,
+                 UnaryOp transform)
+{
+   static_assert(detail::is_random_access<RandomIt>::value, "wut::reduce requires random access iterators");
+   uint32_t size = static_cast<uint32_t>(last - first);
+
+   if (size < 2 * detail::ParallelMinGrain) {
+      return wut::transform_reduce(execution::seq, first, last, std::move(init), reduce, transform);
+   }
+
+   // Every chunk starts from its first element, so no identity is needed
+   std::vector<T> partials((size + detail::parallel_grain(size) - 1) / detail::parallel_grain(size), init);
+   detail::parallel_chunks(size, [&](uint32_t chunk, uint32_t begin, uint32_t end) {
+      T value = transform(first[begin]);
+      for (uint32_t i = begin + 1; i < end; ++i) {
+         value = reduce(std::move(value), transform(first[i]));
+      }
+      partials[chunk] = std::move(value);
+   });
+
+   for (auto &partial : partials) {
+      init = reduce(std::move(init), std::move(partial));
+   }
+
+   return init;
+}
+
+template<typename Policy, typename RandomIt1, typename RandomIt2, typename T, typename BinaryOp1, typename BinaryOp2>
+T
+transform_reduce(const Policy &policy,
+                 RandomIt1 first1,
+                 RandomIt1 last1,
+                 RandomIt2 first2,
+                 T init,
+                 BinaryOp1 reduce,
+                 BinaryOp2 transform)
+{
+   static_assert(detail::is_random_access<RandomIt2>::value, "wut::transform_reduce requires random access iterators");
+
+   // Reduce over indices so both ranges are read at the same position
+   return wut::transform_reduce(
+      policy, detail::IndexIterator { 0 }, detail::IndexIterator { static_cast<uint32_t>(last1 - first1) },
+      std::move(init), reduce, [&](uint32_t i) { return transform(first1[i], first2[i]); });
+}
+
+template<typename Policy, typename RandomIt1, typename RandomIt2, typename T>
+T
+transform_reduce(const Policy &policy,
+                 RandomIt1 first1,
+                 RandomIt1 last1,
+                 RandomIt2 first2,
+                 T init)
+{
+   return wut::transform_reduce(
+      policy, first1, last1, first2, std::move(init), std::plus<>(), std::multiplies<>());
+}
+
+template<typename Policy, typename RandomIt, typename T, typename BinaryOp>
+T
+reduce(const Policy &policy,
+       RandomIt first,
+       RandomIt last,
+       T init,
+       BinaryOp op)
+{
+   using Value = typename std::iterator_traits<RandomIt>::value_type;
+   return wut::transform_reduce(policy, first, last, std::move(init), op,
+                                [](const Value &value) -> const Value & { return value; });
+}
+
+template<typename Policy, typename RandomIt, typename T>
+T
+reduce(const Policy &policy,
+       RandomIt first,
+       RandomIt last,
+       T init)
+{
+   return wut::reduce(policy, first, last, std::move(init), std::plus<>());
+}
+
+template<typename Policy, typename RandomIt>
+typename std::iterator_traits<RandomIt>::value_type
+reduce(const Policy &policy,
+       RandomIt first,
+       RandomIt last)
+{
+   return wut::reduce(policy, first, last, typename std::iterator_traits<RandomIt>::value_type {});
+}
+
+/*
+ * Scans: sum every chunk in parallel, scan the chunk sums serially, then
+ * scan every chunk in parallel starting from the sum of the chunks before it.
+ */
+template<typename RandomIt, typename OutputIt, typename BinaryOp, typename UnaryOp, typename T>
+OutputIt
+transform_inclusive_scan(const execution::sequenced_policy &,
+                         RandomIt first,
+                         RandomIt last,
+                         OutputIt result,
+                         BinaryOp op,
+                         UnaryOp transform,
+                         T init)
+{
+   for (; first != last; ++first, ++result) {
+      init    = op(std::move(init), transform(*first));
+      *result = init;
+   }
+
+   return result;
+}
+
+template<typename RandomIt, typename OutputIt, typename BinaryOp, typename UnaryOp, typename T>
+OutputIt
+transform_inclusive_scan(const execution::parallel_policy &,
+                         RandomIt first,
+                         RandomIt last,
+                         OutputIt result,
+                         BinaryOp op,
+                         UnaryOp transform,
+                         T init)
+{
+   static_assert(detail::is_random_access<RandomIt>::value && detail::is_random_access<OutputIt>::value,
+                 "wut::inclusive_scan requires random access iterators");
+   uint32_t size = static_cast<uint32_t>(last - first);
+
+   if (size < 2 * detail::ParallelMinGrain) {
+      return wut::transform_inclusive_scan(execution::seq, first, last, result, op, transform, std::move(init));
+   }
+
+   uint32_t grain = detail::parallel_grain(size);
+   std::vector<T> sums((size + grain - 1) / grain, init);
+
+   detail::parallel_chunks(size, [&](uint32_t chunk, uint32_t begin, uint32_t end) {
+      T value = transform(first[begin]);
+      for (uint32_t i = begin + 1; i < end; ++i) {
+         value = op(std::move(value), transform(first[i]));
+      }
+      sums[chunk] = std::move(value);
+   });
+
+   // sums[i] becomes the value carried into chunk i
+   for (auto &sum : sums) {
+      T next = op(init, sum);
+      sum    = init;
+      init   = std::move(next);
+   }
+
+   detail::parallel_chunks(size, [&](uint32_t chunk, uint32_t begin, uint32_t end) {
+      T value = sums[chunk];
+      for (uint32_t i = begin; i < end; ++i) {
+         value     = op(std::move(value), transform(first[i]));
+         result[i] = value;
+      }
+   });
+
+   return result + size;
+}
+
+template<typename Policy, typename RandomIt, typename OutputIt, typename BinaryOp, typename UnaryOp>
+OutputIt
+transform_inclusive_scan(const Policy &policy,
+                         RandomIt first,
+                         RandomIt last,
+                         OutputIt result,
+                         BinaryOp op,
+                         UnaryOp transform)
+{
+   if (first == last) {
+      return result;
+   }
+
+   // Seed with the first element, scan the rest
+   auto init = transform(*first);
+   *result   = init;
+   return wut::transform_inclusive_scan(policy, first + 1, last, result + 1, op, transform, std::move(init));
+}
+
+template<typename Policy, typename RandomIt, typename OutputIt, typename T, typename BinaryOp, typename UnaryOp>
+OutputIt
+transform_exclusive_scan(const Policy &policy,
+                         RandomIt first,
+                         RandomIt last,
+                         OutputIt result,
+                         T init,
+                         BinaryOp op,
+                         UnaryOp transform)
+{
+   uint32_t size = static_cast<uint32_t>(last - first);
+   if (!size) {
+      return result;
+   }
+
+   // Element i of an exclusive scan is element i - 1 of the inclusive scan,
+   // scan into the output shifted by one unless it aliases the input.
+   if (static_cast<const void *>(&*result) == static_cast<const void *>(&*first)) {
+      std::vector<T> temp(size, init);
+      wut::transform_inclusive_scan(policy, first, last - 1, temp.begin() + 1, op, transform, init);
+      temp[0] = std::move(init);
+      return std::move(temp.begin(), temp.end(), result);
+   }
+
+   wut::transform_inclusive_scan(policy, first, last - 1, result + 1, op, transform, init);
+   result[0] = std::move(init);
+   return result + size;
+}
+
+template<typename Policy, typename RandomIt, typename OutputIt, typename BinaryOp, typename T>
+OutputIt
+inclusive_scan(const Policy &policy,
+               RandomIt first,
+               RandomIt last,
+               OutputIt result,
+               BinaryOp op,
+               T init)
+{
+   using Value = typename std::iterator_traits<RandomIt>::value_type;
+   return wut::transform_inclusive_scan(policy, first, last, result, op,
+                                        [](const Value &value) -> const Value & { return value; },
+                                        std::move(init));
+}
+
+template<typename Policy, typename RandomIt, typename OutputIt, typename BinaryOp>
+OutputIt
+inclusive_scan(const Policy &policy,
+               RandomIt first,
+               RandomIt last,
+               OutputIt result,
+               BinaryOp op)
+{
+   using Value = typename std::iterator_traits<RandomIt>::value_type;
+   return wut::transform_inclusive_scan(policy, first, last, result, op,
+                                        [](const Value &value) -> const Value & { return value; });
+}
+
+template<typename Policy, typename RandomIt, typename OutputIt>
+OutputIt
+inclusive_scan(const Policy &policy,
+               RandomIt first,
+               RandomIt last,
+               OutputIt result)
+{
+   return wut::inclusive_scan(policy, first, last, result, std::plus<>());
+}
+
+template<typename Policy, typename RandomIt, typename OutputIt, typename T, typename BinaryOp>
+OutputIt
+exclusive_scan(const Policy &policy,
+               RandomIt first,
+               RandomIt last,
+               OutputIt result,
+               T init,
+               BinaryOp op)
+{
+   using Value = typename std::iterator_traits<RandomIt>::value_type;
+   return wut::transform_exclusive_scan(policy, first, last, result, std::move(init), op,
+                                        [](const Value &value) -> const Value & { return value; });
+}
+
+template<typename Policy, typename RandomIt, typename OutputIt, typename T>
+OutputIt
+exclusive_scan(const Policy &policy,
+               RandomIt first,
+               RandomIt last,
+               OutputIt result,
+               T init)
+{
+   return wut::exclusive_scan(policy, first, last, result, std::move(init), std::plus<>());
+}
+
+/*
+ * sort, stable_sort
+ */
+template<typename RandomIt, typename Compare>
+void
+sort(const execution::sequenced_policy &,
+     RandomIt first,
+     RandomIt last,
+     Compare comp)
+{
+   std::sort(first, last, comp);
+}
+
+template<typename RandomIt, typename Compare>
+void
+sort(const execution::parallel_policy &,
+     RandomIt first,
+     RandomIt last,
+     Compare comp)
+{
+   detail::parallel_sort(first, last, comp, [](RandomIt begin, RandomIt end, Compare &compare) {
+      std::sort(begin, end, compare);
+   });
+}
+
+template<typename Policy, typename RandomIt>
+void
+sort(const Policy &policy,
+     RandomIt first,
+     RandomIt last)
+{
+   wut::sort(policy, first, last, std::less<>());
+}
+
+template<typename RandomIt, typename Compare>
+void
+stable_sort(const execution::sequenced_policy &,
+            RandomIt first,
+            RandomIt last,
+            Compare comp)
+{
+   std::stable_sort(first, last, comp);
+}
+
+template<typename RandomIt, typename Compare>
+void
+stable_sort(const execution::parallel_policy &,
+            RandomIt first,
+            RandomIt last,
+            Compare comp)
+{
+   detail::parallel_sort(first, last, comp, [](RandomIt begin, RandomIt end, Compare &compare) {
+      std::stable_sort(begin, end, compare);
+   });
+}
+
+template<typename Policy, typename RandomIt>
+void
+stable_sort(const Policy &policy,
+            RandomIt first,
+            RandomIt last)
+{
+   wut::stable_sort(policy, first, last, std::less<>());
+}
+
+} // namespace wut
+
+#endif
+
+/** @} */
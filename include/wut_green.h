@@ -0,0 +1,279 @@
+#pragma once
+#include <wut.h>
+#include <coreinit/spinlock.h>
+#include <coreinit/time.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+/**
+ * \defgroup wut_green Green Threads
+ *
+ * Cooperatively scheduled threads multiplexed on a few OS threads.
+ *
+ * Green threads switch with OSSwitchCoroutine and run on small pooled
+ * stacks, so a program can keep thousands of them, for example one per
+ * network connection. Every scheduler is an OS thread pinned to a core with
+ * its own run queue, a green thread stays on the scheduler it was created
+ * on.
+ *
+ * A green thread runs until it yields, sleeps or waits. The WUTGreen*
+ * socket and file functions below park the calling green thread instead of
+ * blocking the scheduler: socket calls wait for readiness with poll, file
+ * calls run on a helper OS thread. Called from a regular OS thread they
+ * behave like the function they wrap.
+ *
+ * \code
+ * static void
+ * client(void *arg)
+ * {
+ *    int fd = (int)arg;
+ *    char buffer[512];
+ *    ssize_t length;
+ *
+ *    while ((length = WUTGreenRecv(fd, buffer, sizeof(buffer), 0)) > 0) {
+ *       WUTGreenSend(fd, buffer, length, 0);
+ *    }
+ *    close(fd);
+ * }
+ *
+ * WUTInitGreenScheduler(OS_THREAD_ATTRIB_AFFINITY_CPU1 | OS_THREAD_ATTRIB_AFFINITY_CPU2);
+ * while (running) {
+ *    int fd = WUTGreenAccept(listenFd, NULL, NULL);
+ *    WUTDetachGreenThread(WUTCreateGreenThread(client, (void *)fd, 0, -1));
+ * }
+ * \endcode
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct WUTGreenThread WUTGreenThread;
+typedef struct WUTGreenChannel WUTGreenChannel;
+typedef struct WUTGreenWaiter WUTGreenWaiter;
+
+typedef void (*WUTGreenThreadFn)(void *arg);
+
+//! Default green thread stack size, stacks of this size are pooled.
+#define WUT_GREEN_DEFAULT_STACK_SIZE (16 * 1024)
+
+struct WUTGreenWaiter
+{
+   WUTGreenWaiter *next;
+   WUTGreenThread *thread;
+   void *data;
+   BOOL ok;
+};
+
+/**
+ * Channel passing fixed size messages between green threads.
+ *
+ * With a capacity of 0 every send waits for a matching receive.
+ */
+struct WUTGreenChannel
+{
+   OSSpinLock lock;
+   uint8_t *buffer;
+   uint32_t elementSize;
+   uint32_t capacity;
+   uint32_t head;
+   uint32_t count;
+   BOOL closed;
+   WUTGreenWaiter *sendHead;
+   WUTGreenWaiter *sendTail;
+   WUTGreenWaiter *recvHead;
+   WUTGreenWaiter *recvTail;
+};
+
+/**
+ * Start one scheduler thread on each core in affinity.
+ *
+ * \param affinity
+ * A combination of OS_THREAD_ATTRIB_AFFINITY_CPU* flags.
+ */
+BOOL
+WUTInitGreenScheduler(uint32_t affinity);
+
+/**
+ * Wait for every green thread to finish, then stop the schedulers.
+ */
+void
+WUTShutdownGreenScheduler(void);
+
+/**
+ * Create and start a green thread.
+ *
+ * \param stackSize
+ * Stack size in bytes, 0 for WUT_GREEN_DEFAULT_STACK_SIZE.
+ *
+ * \param core
+ * Core of the scheduler to run on, or -1 to spread threads over the
+ * schedulers.
+ *
+ * \return
+ * The thread which must be joined or detached, or NULL on failure.
+ */
+WUTGreenThread *
+WUTCreateGreenThread(WUTGreenThreadFn function,
+                     void *arg,
+                     uint32_t stackSize,
+                     int32_t core);
+
+/**
+ * Wait for a green thread to finish and free it. May be called from a green
+ * thread or an OS thread.
+ */
+void
+WUTJoinGreenThread(WUTGreenThread *thread);
+
+/**
+ * Let the thread free itself when it finishes.
+ */
+void
+WUTDetachGreenThread(WUTGreenThread *thread);
+
+/**
+ * Get the calling green thread, or NULL when called from an OS thread.
+ */
+WUTGreenThread *
+WUTGetCurrentGreenThread(void);
+
+/**
+ * Let other green threads on the same scheduler run.
+ */
+void
+WUTYieldGreenThread(void);
+
+/**
+ * Sleep the calling green thread, or the OS thread when not called from a
+ * green thread.
+ */
+void
+WUTSleepGreenThread(OSTime ticks);
+
+/**
+ * Run function(arg) on a helper OS thread, parking the calling green thread
+ * until it returns.
+ */
+void
+WUTGreenBlockingCall(void (*function)(void *arg),
+                     void *arg);
+
+/**
+ * Wait until a socket is ready for the given poll events.
+ *
+ * \return
+ * The poll revents.
+ */
+int
+WUTGreenWaitSocket(int fd,
+                   int events);
+
+int
+WUTGreenAccept(int fd,
+               struct sockaddr *address,
+               socklen_t *addressLength);
+
+int
+WUTGreenConnect(int fd,
+                const struct sockaddr *address,
+                socklen_t addressLength);
+
+ssize_t
+WUTGreenRecv(int fd,
+             void *buffer,
+             size_t length,
+             int flags);
+
+ssize_t
+WUTGreenSend(int fd,
+             const void *buffer,
+             size_t length,
+             int flags);
+
+ssize_t
+WUTGreenRecvFrom(int fd,
+                 void *buffer,
+                 size_t length,
+                 int flags,
+                 struct sockaddr *address,
+                 socklen_t *addressLength);
+
+ssize_t
+WUTGreenSendTo(int fd,
+               const void *buffer,
+               size_t length,
+               int flags,
+               const struct sockaddr *address,
+               socklen_t addressLength);
+
+int
+WUTGreenOpen(const char *path,
+             int flags,
+             int mode);
+
+int
+WUTGreenClose(int fd);
+
+ssize_t
+WUTGreenRead(int fd,
+             void *buffer,
+             size_t length);
+
+ssize_t
+WUTGreenWrite(int fd,
+              const void *buffer,
+              size_t length);
+
+/**
+ * Initialise a channel.
+ *
+ * \param capacity
+ * Number of messages buffered before send waits, may be 0.
+ */
+BOOL
+WUTInitGreenChannel(WUTGreenChannel *channel,
+                    uint32_t elementSize,
+                    uint32_t capacity);
+
+/**
+ * Free a channel, no thread may be waiting on it.
+ */
+void
+WUTDestroyGreenChannel(WUTGreenChannel *channel);
+
+/**
+ * Send a message, waiting while the channel is full. Must be called from a
+ * green thread.
+ *
+ * \return
+ * TRUE if sent, FALSE if the channel is closed.
+ */
+BOOL
+WUTGreenChannelSend(WUTGreenChannel *channel,
+                    const void *message);
+
+/**
+ * Receive a message, waiting while the channel is empty. Must be called
+ * from a green thread.
+ *
+ * \return
+ * TRUE if a message was received, FALSE once the channel is closed and
+ * drained.
+ */
+BOOL
+WUTGreenChannelRecv(WUTGreenChannel *channel,
+                    void *message);
+
+/**
+ * Close a channel, waking every thread waiting on it.
+ */
+void
+WUTGreenChannelClose(WUTGreenChannel *channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
@@ -0,0 +1,96 @@
+#pragma once
+#include <wut.h>
+#include <coreinit/memheap.h>
+
+/**
+ * \defgroup wut_heap Heap Layout
+ *
+ * Partitioning of MEM2 between malloc and other heaps at startup.
+ *
+ * The default `__preinit_user` splits the MEM2 heap according to
+ * `__wut_heap_layout`, which an application can override by defining its own:
+ *
+ * \code
+ * const WUTHeapLayout __wut_heap_layout = {
+ *    .mallocSize        = WUT_HEAP_PERCENT(60),
+ *    .mallocInitialSize = 16 * 1024 * 1024,
+ *    .gpuHeapSize       = 64 * 1024 * 1024,
+ *    .reserveSize       = 8 * 1024 * 1024,
+ * };
+ * \endcode
+ *
+ * The GPU and unit heaps are taken from the tail of MEM2 and the malloc heap
+ * from the head. Any memory not given to one of them remains allocatable from
+ * the MEM2 heap.
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Express a size as a percentage of the allocatable MEM2 memory at startup.
+#define WUT_HEAP_PERCENT(percent) (0x80000000u | (uint32_t)(percent))
+
+typedef struct WUTHeapLayout WUTHeapLayout;
+
+struct WUTHeapLayout
+{
+   //! Maximum size of the malloc heap, 0 to use all remaining memory.
+   uint32_t mallocSize;
+
+   //! Size claimed by the malloc heap at startup, 0 to claim mallocSize.
+   //! The heap grows on demand up to mallocSize as long as the memory
+   //! directly after it is still free in MEM2.
+   uint32_t mallocInitialSize;
+
+   //! Size of an expanded heap reserved for GPU resources, 0 to disable.
+   uint32_t gpuHeapSize;
+
+   //! Size of a unit heap pool, 0 to disable.
+   uint32_t unitHeapSize;
+
+   //! Block size of the unit heap pool.
+   uint32_t unitHeapBlockSize;
+
+   //! Memory left untouched in MEM2 for the system and other users.
+   uint32_t reserveSize;
+};
+
+/**
+ * Heap layout used by the default `__preinit_user`.
+ *
+ * The default layout gives all of MEM2 to malloc upfront.
+ */
+extern const WUTHeapLayout __wut_heap_layout;
+
+/**
+ * Get the expanded heap reserved for GPU resources, or NULL if the layout
+ * does not contain one.
+ */
+MEMHeapHandle
+WUTGetGPUHeap(void);
+
+/**
+ * Get the unit heap pool, or NULL if the layout does not contain one.
+ */
+MEMHeapHandle
+WUTGetUnitHeap(void);
+
+/**
+ * Get the number of bytes currently claimed from MEM2 by the malloc heap.
+ */
+uint32_t
+WUTGetMallocHeapSize(void);
+
+/**
+ * Get the number of bytes the malloc heap is allowed to grow to.
+ */
+uint32_t
+WUTGetMallocHeapMaxSize(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
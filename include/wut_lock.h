@@ -0,0 +1,47 @@
+#pragma once
+#include <wut.h>
+
+/**
+ * \defgroup wut_lock Libc Locks
+ *
+ * Statistics for the locks newlib uses internally, for example one per
+ * `FILE` stream.
+ *
+ * Locks are allocated in blocks of 32 as they are created. Acquiring a lock
+ * first tries an OSFastMutex without blocking, then spins for a short while
+ * before sleeping on the mutex.
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct WUTLibcLockStats WUTLibcLockStats;
+
+struct WUTLibcLockStats
+{
+   //! Number of locks currently initialised.
+   uint32_t locksInUse;
+
+   //! Number of lock slots allocated so far.
+   uint32_t locksAllocated;
+
+   //! Number of acquires that found the lock already held.
+   uint32_t contended;
+
+   //! Number of contended acquires that had to sleep after spinning.
+   uint32_t blocked;
+};
+
+/**
+ * Get a snapshot of the libc lock statistics.
+ */
+void
+WUTGetLibcLockStats(WUTLibcLockStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
@@ -0,0 +1,123 @@
+#pragma once
+#include <wut.h>
+#include <nn/nets2/somemopt.h>
+
+/**
+ * \defgroup wut_net Socket Memory
+ *
+ * Socket buffer memory provisioning and per socket buffer tuning.
+ *
+ * By default the network stack only has its small system buffer pool, which
+ * limits sustained TCP throughput. An application can give it a larger pool
+ * at startup by overriding `__wut_socket_memory`:
+ *
+ * \code
+ * const WUTSocketMemoryConfig __wut_socket_memory = {
+ *    .bufferSize     = 0x200000,
+ *    .flags          = SOMEMOPT_FLAGS_BIG_BUFFERS,
+ *    .recvBufferSize = 256 * 1024,
+ *    .sendBufferSize = 128 * 1024,
+ * };
+ * \endcode
+ *
+ * The default `__init_wut_socket` then hands the buffer to nsysnet with
+ * somemopt on a dedicated thread, as the request only returns once the
+ * network stack shuts down, and waits for it to take effect before the
+ * first socket is created. A size outside WUT_SOCKET_MEMORY_MIN and
+ * WUT_SOCKET_MEMORY_MAX is ignored.
+ *
+ * nsysnet only receives into the pool on sockets with SO_RUSRBUF set, so
+ * while a pool is provisioned every new stream socket gets SO_RUSRBUF.
+ * Accepted sockets inherit it from their listening socket.
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Smallest buffer which can be given to the network stack.
+#define WUT_SOCKET_MEMORY_MIN (0x20000)
+
+//! Largest buffer which can be given to the network stack.
+#define WUT_SOCKET_MEMORY_MAX (0x300000)
+
+//! Smallest socket buffer size WUTSetSocketBufferSizes falls back to.
+#define WUT_SOCKET_BUFFER_MIN (8 * 1024)
+
+//! Largest socket buffer size chosen by WUTTuneSocketBuffers.
+#define WUT_SOCKET_BUFFER_MAX (512 * 1024)
+
+typedef struct WUTSocketMemoryConfig WUTSocketMemoryConfig;
+
+struct WUTSocketMemoryConfig
+{
+   //! Size of the buffer given to the network stack, 0 to keep the system
+   //! default. Must be between WUT_SOCKET_MEMORY_MIN and
+   //! WUT_SOCKET_MEMORY_MAX bytes.
+   uint32_t bufferSize;
+
+   //! SOMemOptFlags for the buffer.
+   uint32_t flags;
+
+   //! SO_RCVBUF set on every new stream socket, 0 for the system default.
+   //! Accepted sockets inherit the size of their listening socket.
+   uint32_t recvBufferSize;
+
+   //! SO_SNDBUF set on every new stream socket, 0 for the system default.
+   uint32_t sendBufferSize;
+};
+
+/**
+ * Socket memory configuration used by the default `__init_wut_socket`.
+ *
+ * The default configuration keeps the system defaults.
+ */
+extern const WUTSocketMemoryConfig __wut_socket_memory;
+
+/**
+ * Get the number of bytes in use from the buffer given to the network stack.
+ *
+ * \return
+ * The number of bytes, or -1 if no buffer was provisioned.
+ */
+int
+WUTGetSocketMemoryUsed(void);
+
+/**
+ * Set SO_RCVBUF and SO_SNDBUF on a socket, halving each size the network
+ * stack refuses down to WUT_SOCKET_BUFFER_MIN. A size of 0 is left
+ * unchanged.
+ *
+ * \return
+ * 0 on success, -1 if a size could not be set at all.
+ */
+int
+WUTSetSocketBufferSizes(int fd,
+                        uint32_t recvSize,
+                        uint32_t sendSize);
+
+/**
+ * Size a socket's buffers for a link from its expected bandwidth and round
+ * trip time.
+ *
+ * Both buffers are set to twice the bandwidth-delay product, clamped to
+ * WUT_SOCKET_BUFFER_MIN and WUT_SOCKET_BUFFER_MAX and to a quarter of the
+ * provisioned socket memory.
+ *
+ * \param bytesPerSecond
+ * Expected throughput of the connection.
+ *
+ * \param rttMilliseconds
+ * Expected round trip time of the connection.
+ */
+int
+WUTTuneSocketBuffers(int fd,
+                     uint32_t bytesPerSecond,
+                     uint32_t rttMilliseconds);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
@@ -0,0 +1,190 @@
+#pragma once
+#include <wut.h>
+#include <coreinit/mutex.h>
+#include <coreinit/time.h>
+#include <nsysnet/nssl.h>
+
+/**
+ * \defgroup wut_nssl_pool NSSL Connection Pool
+ *
+ * Keeps idle NSSL connections open so requests to the same host can skip
+ * the TCP and TLS handshakes.
+ *
+ * A connection is checked out for a host and port, used with NSSLRead and
+ * NSSLWrite, then checked back in. Idle connections are kept per host and
+ * port up to the configured limits and closed once they have been idle for
+ * too long. A connection is checked for a pending error, or for the peer
+ * having closed it, before it is handed out again.
+ *
+ * \code
+ * static WUTNSSLPool sPool;
+ * WUTInitNSSLPool(&sPool, context, NULL);
+ *
+ * WUTNSSLPoolConnection *connection;
+ * if (WUTNSSLPoolCheckout(&sPool, "api.example.com", 443, &connection) == 0) {
+ *    BOOL ok = sendRequest(connection->connection);
+ *    WUTNSSLPoolCheckin(&sPool, connection, ok);
+ * }
+ * \endcode
+ *
+ * A server may still close a reused connection just as a request is sent,
+ * so a request which fails on a connection with `reused` set is usually
+ * worth retrying once on a fresh connection.
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct WUTNSSLPool WUTNSSLPool;
+typedef struct WUTNSSLPoolConfig WUTNSSLPoolConfig;
+typedef struct WUTNSSLPoolConnection WUTNSSLPoolConnection;
+typedef struct WUTNSSLPoolStats WUTNSSLPoolStats;
+
+struct WUTNSSLPoolConfig
+{
+   //! Maximum number of idle connections kept per host and port.
+   uint32_t maxIdlePerHost;
+
+   //! Maximum number of idle connections kept in total.
+   uint32_t maxIdle;
+
+   //! Milliseconds a connection may stay idle before it is closed.
+   uint32_t idleTimeoutMs;
+
+   //! Milliseconds after which a connection is no longer reused, 0 for no
+   //! limit.
+   uint32_t maxLifetimeMs;
+
+   //! Options passed to NSSLCreateConnection.
+   int32_t options;
+};
+
+struct WUTNSSLPoolStats
+{
+   //! Successful checkouts, reused / checkouts is the reuse rate.
+   uint32_t checkouts;
+
+   //! Checkouts served by an idle connection.
+   uint32_t reused;
+
+   //! Connections opened, each with a full handshake.
+   uint32_t created;
+
+   //! Checkouts which could not open a connection.
+   uint32_t failed;
+
+   //! Idle connections which failed the check on checkout.
+   uint32_t stale;
+
+   //! Idle connections closed by the idle timeout or lifetime limit.
+   uint32_t expired;
+
+   //! Idle connections closed to stay within the limits.
+   uint32_t evicted;
+
+   //! Connections currently idle in the pool.
+   uint32_t idle;
+};
+
+struct WUTNSSLPoolConnection
+{
+   NSSLConnectionHandle connection;
+
+   //! Socket the connection runs over.
+   int socket;
+
+   //! TRUE if the connection was used before this checkout.
+   BOOL reused;
+
+   const char *host;
+   uint16_t port;
+   OSTime created;
+   OSTime idleSince;
+   WUTNSSLPoolConnection *next;
+};
+
+struct WUTNSSLPool
+{
+   OSMutex mutex;
+   NSSLContextHandle context;
+   WUTNSSLPoolConfig config;
+   WUTNSSLPoolStats stats;
+
+   //! Idle connections, most recently used first.
+   WUTNSSLPoolConnection *idle;
+};
+
+/**
+ * Initialise a pool.
+ *
+ * \param context
+ * NSSL context new connections are created under, must outlive the pool.
+ *
+ * \param config
+ * Limits for the pool, or NULL to keep up to 4 idle connections per host and
+ * 16 in total for 30 seconds each.
+ */
+void
+WUTInitNSSLPool(WUTNSSLPool *pool,
+                NSSLContextHandle context,
+                const WUTNSSLPoolConfig *config);
+
+/**
+ * Close every idle connection in a pool.
+ *
+ * All checked out connections must be checked in first.
+ */
+void
+WUTDestroyNSSLPool(WUTNSSLPool *pool);
+
+/**
+ * Get a connection to a host, reusing an idle one when possible.
+ *
+ * \param host
+ * Host to connect to, also used to verify the server certificate.
+ *
+ * \param outConnection
+ * Set to the connection, which must be returned with WUTNSSLPoolCheckin.
+ *
+ * \return
+ * 0 on success, -1 with errno set if the host could not be reached, or a
+ * negative NSSLError if the handshake failed.
+ */
+int
+WUTNSSLPoolCheckout(WUTNSSLPool *pool,
+                    const char *host,
+                    uint16_t port,
+                    WUTNSSLPoolConnection **outConnection);
+
+/**
+ * Return a connection to its pool.
+ *
+ * \param reusable
+ * TRUE if the last request completed and the connection can be used again,
+ * FALSE to close it, such as after an error or an unread response.
+ */
+void
+WUTNSSLPoolCheckin(WUTNSSLPool *pool,
+                   WUTNSSLPoolConnection *connection,
+                   BOOL reusable);
+
+/**
+ * Close every idle connection, for example after the network changed.
+ */
+void
+WUTFlushNSSLPool(WUTNSSLPool *pool);
+
+/**
+ * Get a copy of the pool counters.
+ */
+void
+WUTGetNSSLPoolStats(WUTNSSLPool *pool,
+                    WUTNSSLPoolStats *outStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
@@ -0,0 +1,291 @@
+#pragma once
+#include <wut.h>
+#include <coreinit/memheap.h>
+#include <coreinit/spinlock.h>
+
+/**
+ * \defgroup wut_pool Object Pool
+ *
+ * Fixed-size object allocation backed by coreinit unit heaps.
+ *
+ * A pool grows in chunks, each chunk being a unit heap allocated from the
+ * default heap and aligned to its size so a freed object's chunk is found in
+ * constant time. Every core keeps a small cache (magazine) of free objects, so
+ * allocating and freeing only disables interrupts on the calling core, the
+ * pool lock is only taken to refill or flush half a magazine at a time.
+ * Objects may be freed from any thread or core.
+ *
+ * \code
+ * static WUTPool sPacketPool;
+ *
+ * WUTInitPool(&sPacketPool, sizeof(Packet), 4, 256, 0);
+ * Packet *packet = WUTAllocFromPool(&sPacketPool);
+ * WUTFreeToPool(&sPacketPool, packet);
+ * \endcode
+ *
+ * C++ code can use `wut::Pool<T>`, or `wut::PoolAllocator<T>` for node based
+ * standard containers such as `std::list` and `std::map`.
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Number of free objects cached per core.
+#define WUT_POOL_MAGAZINE_SIZE 32
+
+//! Number of cores with a magazine.
+#define WUT_POOL_MAX_CORES     3
+
+typedef struct WUTPool WUTPool;
+typedef struct WUTPoolChunk WUTPoolChunk;
+typedef struct WUTPoolMagazine WUTPoolMagazine;
+
+struct __attribute__((aligned(0x40))) WUTPoolMagazine
+{
+   uint32_t count;
+   void *objects[WUT_POOL_MAGAZINE_SIZE];
+};
+
+struct WUTPool
+{
+   //! Per-core free object caches, only touched with interrupts disabled.
+   WUTPoolMagazine magazines[WUT_POOL_MAX_CORES];
+
+   //! Protects the chunk list and the unit heaps inside the chunks.
+   OSSpinLock lock;
+
+   WUTPoolChunk *chunks;
+   uint32_t chunkCount;
+   uint32_t maxChunks;
+   uint32_t objectSize;
+   uint32_t objectsPerChunk;
+   int32_t alignment;
+
+   //! Power of two size and alignment of every chunk.
+   uint32_t chunkSize;
+};
+
+/**
+ * Initialise a pool.
+ *
+ * \param pool
+ * Pool to initialise.
+ *
+ * \param objectSize
+ * Size of every object in bytes.
+ *
+ * \param alignment
+ * Alignment of every object, at least 4.
+ *
+ * \param objectsPerChunk
+ * Number of objects added to the pool each time it grows.
+ *
+ * \param maxChunks
+ * Maximum number of chunks, 0 to let the pool grow until memory runs out.
+ *
+ * \return
+ * TRUE on success, FALSE if the parameters are invalid.
+ */
+BOOL
+WUTInitPool(WUTPool *pool,
+            uint32_t objectSize,
+            uint32_t alignment,
+            uint32_t objectsPerChunk,
+            uint32_t maxChunks);
+
+/**
+ * Free every chunk of a pool, all objects allocated from it become invalid.
+ */
+void
+WUTDestroyPool(WUTPool *pool);
+
+/**
+ * Allocate an object from a pool.
+ *
+ * \return
+ * The object, or NULL if the pool could not grow.
+ */
+void *
+WUTAllocFromPool(WUTPool *pool);
+
+/**
+ * Return an object to the pool it was allocated from.
+ */
+void
+WUTFreeToPool(WUTPool *pool,
+              void *object);
+
+/**
+ * Get the number of objects the pool can hold without growing.
+ */
+uint32_t
+WUTGetPoolCapacity(WUTPool *pool);
+
+#ifdef __cplusplus
+}
+
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace wut
+{
+
+/**
+ * Typed wrapper around WUTPool.
+ */
+template<typename T>
+class Pool
+{
+public:
+   explicit Pool(uint32_t objectsPerChunk = 64,
+                 uint32_t maxChunks = 0)
+   {
+      WUTInitPool(&mPool, sizeof(T), alignof(T) < 4 ? 4 : alignof(T),
+                  objectsPerChunk, maxChunks);
+   }
+
+   ~Pool()
+   {
+      WUTDestroyPool(&mPool);
+   }
+
+   Pool(const Pool &) = delete;
+   Pool &operator=(const Pool &) = delete;
+
+   //! Allocate uninitialised storage for one object, nullptr on failure.
+   T *
+   allocate()
+   {
+      return static_cast<T *>(WUTAllocFromPool(&mPool));
+   }
+
+   void
+   deallocate(T *object)
+   {
+      WUTFreeToPool(&mPool, object);
+   }
+
+   //! Allocate and construct an object, nullptr on failure.
+   template<typename... Args>
+   T *
+   create(Args &&...args)
+   {
+      void *storage = WUTAllocFromPool(&mPool);
+      if (!storage) {
+         return nullptr;
+      }
+
+      return new (storage) T(std::forward<Args>(args)...);
+   }
+
+   //! Destroy an object created with create().
+   void
+   destroy(T *object)
+   {
+      if (object) {
+         object->~T();
+         WUTFreeToPool(&mPool, object);
+      }
+   }
+
+   uint32_t
+   capacity()
+   {
+      return WUTGetPoolCapacity(&mPool);
+   }
+
+   WUTPool *
+   handle()
+   {
+      return &mPool;
+   }
+
+private:
+   WUTPool mPool;
+};
+
+/**
+ * Standard allocator serving single objects from a pool shared by every
+ * PoolAllocator of the same type, larger requests go to std::allocator.
+ */
+template<typename T>
+class PoolAllocator
+{
+public:
+   using value_type = T;
+
+   template<typename U>
+   struct rebind
+   {
+      using other = PoolAllocator<U>;
+   };
+
+   PoolAllocator() noexcept = default;
+
+   template<typename U>
+   PoolAllocator(const PoolAllocator<U> &) noexcept
+   {
+   }
+
+   T *
+   allocate(std::size_t n)
+   {
+      if (n != 1) {
+         return std::allocator<T>().allocate(n);
+      }
+
+      T *object = pool().allocate();
+      if (!object) {
+#ifdef __cpp_exceptions
+         throw std::bad_alloc();
+#else
+         std::abort();
+#endif
+      }
+
+      return object;
+   }
+
+   void
+   deallocate(T *object,
+              std::size_t n)
+   {
+      if (n != 1) {
+         std::allocator<T>().deallocate(object, n);
+      } else {
+         pool().deallocate(object);
+      }
+   }
+
+   static Pool<T> &
+   pool()
+   {
+      // Never destroyed, containers with static storage may outlive it
+      static Pool<T> *sPool = new Pool<T>();
+      return *sPool;
+   }
+};
+
+template<typename T, typename U>
+inline bool
+operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) noexcept
+{
+   return true;
+}
+
+template<typename T, typename U>
+inline bool
+operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) noexcept
+{
+   return false;
+}
+
+} // namespace wut
+
+#endif
+
+/** @} */
@@ -0,0 +1,338 @@
+#pragma once
+#include <wut.h>
+
+/**
+ * \defgroup wut_sched Task Scheduler
+ *
+ * Work-stealing task scheduler with one worker thread pinned to each core.
+ *
+ * Every worker owns a deque of ready tasks. Tasks spawned by a worker are
+ * pushed to its own deque and popped in LIFO order, idle workers steal the
+ * oldest task from another worker. Tasks submitted from other threads go
+ * to a shared queue which every worker drains.
+ *
+ * Tasks may depend on other tasks, a task only becomes ready once every
+ * task it depends on has finished:
+ *
+ * \code
+ * WUTTask *physics   = WUTCreateTask(stepPhysics, world);
+ * WUTTask *animation = WUTCreateTask(stepAnimation, world);
+ * WUTTask *render    = WUTCreateTask(buildDrawLists, world);
+ * WUTAddTaskDependency(render, physics);
+ * WUTAddTaskDependency(render, animation);
+ *
+ * WUTSubmitTask(physics);
+ * WUTSubmitTask(animation);
+ * WUTSubmitTask(render);
+ * WUTWaitTask(render);
+ *
+ * WUTReleaseTask(physics);
+ * WUTReleaseTask(animation);
+ * WUTReleaseTask(render);
+ * \endcode
+ *
+ * Waiting on a task from a worker or any other thread runs other ready
+ * tasks instead of blocking while there is work available.
+ *
+ * The scheduler is started on first use, or explicitly with
+ * WUTInitScheduler.
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct WUTTask WUTTask;
+
+typedef void (*WUTTaskFn)(void *arg);
+typedef void (*WUTParallelForFn)(uint32_t begin, uint32_t end, void *arg);
+
+/**
+ * Start the worker threads.
+ *
+ * \return
+ * TRUE if the scheduler is running.
+ */
+BOOL
+WUTInitScheduler(void);
+
+/**
+ * Stop and join the worker threads once they finish their current task.
+ *
+ * Tasks still queued are not run, the scheduler can be started again
+ * afterwards.
+ */
+void
+WUTShutdownScheduler(void);
+
+/**
+ * Get the index of the worker running the calling thread, or -1 when not
+ * called from a worker.
+ */
+int32_t
+WUTGetCurrentWorker(void);
+
+/**
+ * Create a task, it does not run until submitted with WUTSubmitTask.
+ *
+ * \return
+ * The task holding one reference owned by the caller, or NULL if out of
+ * memory.
+ */
+WUTTask *
+WUTCreateTask(WUTTaskFn function,
+              void *arg);
+
+/**
+ * Make task wait for dependency to finish before it runs.
+ *
+ * Must be called before task is submitted, dependency may be in any state.
+ *
+ * \return
+ * TRUE on success, FALSE if out of memory.
+ */
+BOOL
+WUTAddTaskDependency(WUTTask *task,
+                     WUTTask *dependency);
+
+/**
+ * Submit a task, it runs as soon as all its dependencies have finished.
+ * A task can only be submitted once.
+ */
+void
+WUTSubmitTask(WUTTask *task);
+
+/**
+ * Check whether a task has finished running.
+ */
+BOOL
+WUTIsTaskDone(WUTTask *task);
+
+/**
+ * Wait for a task to finish, running other ready tasks in the meantime.
+ */
+void
+WUTWaitTask(WUTTask *task);
+
+/**
+ * Drop the caller's reference to a task. A submitted task is kept alive by
+ * the scheduler until it has run.
+ */
+void
+WUTReleaseTask(WUTTask *task);
+
+/**
+ * Call function over [begin, end) split into ranges spread across the
+ * workers, returns once every range has been processed.
+ *
+ * \param grain
+ * Ranges are never split below this many elements, 0 to pick a grain from
+ * the size of the range.
+ */
+void
+WUTParallelFor(uint32_t begin,
+               uint32_t end,
+               uint32_t grain,
+               WUTParallelForFn function,
+               void *arg);
+
+#ifdef __cplusplus
+}
+
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace wut
+{
+
+/**
+ * Owning handle for a task running a callable.
+ */
+class Task
+{
+public:
+   Task() = default;
+
+   template<typename Function>
+   explicit Task(Function &&function)
+   {
+      mCallable = new std::function<void()>(std::forward<Function>(function));
+      mTask     = WUTCreateTask(&Task::invoke, mCallable);
+      if (!mTask) {
+         delete mCallable;
+         mCallable = nullptr;
+      }
+   }
+
+   ~Task()
+   {
+      reset();
+   }
+
+   Task(Task &&other) noexcept :
+      mTask(other.mTask),
+      mCallable(other.mCallable)
+   {
+      other.mTask     = nullptr;
+      other.mCallable = nullptr;
+   }
+
+   Task &
+   operator=(Task &&other) noexcept
+   {
+      if (this != &other) {
+         reset();
+         mTask           = other.mTask;
+         mCallable       = other.mCallable;
+         other.mTask     = nullptr;
+         other.mCallable = nullptr;
+      }
+      return *this;
+   }
+
+   Task(const Task &) = delete;
+   Task &operator=(const Task &) = delete;
+
+   //! Run this task only after dependency has finished.
+   bool
+   depends_on(const Task &dependency)
+   {
+      return WUTAddTaskDependency(mTask, dependency.mTask);
+   }
+
+   void
+   submit()
+   {
+      // Once submitted the callable is freed by invoke
+      mCallable = nullptr;
+      WUTSubmitTask(mTask);
+   }
+
+   bool
+   done() const
+   {
+      return WUTIsTaskDone(mTask);
+   }
+
+   void
+   wait()
+   {
+      WUTWaitTask(mTask);
+   }
+
+   //! Release the task, a submitted task still runs to completion.
+   void
+   reset()
+   {
+      if (mTask) {
+         WUTReleaseTask(mTask);
+         mTask = nullptr;
+      }
+
+      // Never submitted, so invoke will not free it
+      delete mCallable;
+      mCallable = nullptr;
+   }
+
+   explicit operator bool() const
+   {
+      return mTask != nullptr;
+   }
+
+   WUTTask *
+   handle() const
+   {
+      return mTask;
+   }
+
+private:
+   static void
+   invoke(void *arg)
+   {
+      auto callable = static_cast<std::function<void()> *>(arg);
+      (*callable)();
+      delete callable;
+   }
+
+   WUTTask *mTask = nullptr;
+
+   //! The callable while the task has not been submitted.
+   std::function<void()> *mCallable = nullptr;
+};
+
+/**
+ * Call function(i) for every i in [begin, end) across the workers.
+ */
+template<typename Function>
+void
+parallel_for(uint32_t begin,
+             uint32_t end,
+             uint32_t grain,
+             Function &&function)
+{
+   WUTParallelFor(
+      begin, end, grain,
+      [](uint32_t rangeBegin, uint32_t rangeEnd, void *arg) {
+         auto &fn = *static_cast<typename std::remove_reference<Function>::type *>(arg);
+         for (uint32_t i = rangeBegin; i < rangeEnd; ++i) {
+            fn(i);
+         }
+      },
+      const_cast<void *>(static_cast<const void *>(&function)));
+}
+
+/**
+ * Reduce map(i) over [begin, end) with reduce, starting from identity.
+ *
+ * Every grain sized range is reduced separately and the partial results are
+ * combined in order, so the result does not depend on how the work was
+ * spread across the cores.
+ */
+template<typename T, typename Map, typename Reduce>
+T
+parallel_reduce(uint32_t begin,
+                uint32_t end,
+                uint32_t grain,
+                T identity,
+                Map &&map,
+                Reduce &&reduce)
+{
+   if (end <= begin) {
+      return identity;
+   }
+
+   if (!grain) {
+      grain = (end - begin + 31) / 32;
+   }
+
+   uint32_t chunks = (end - begin + grain - 1) / grain;
+   std::vector<T> partials(chunks, identity);
+
+   parallel_for(0, chunks, 1, [&](uint32_t chunk) {
+      uint32_t chunkBegin = begin + chunk * grain;
+      uint32_t chunkEnd   = (end - chunkBegin > grain) ? chunkBegin + grain : end;
+      T value             = identity;
+
+      for (uint32_t i = chunkBegin; i < chunkEnd; ++i) {
+         value = reduce(std::move(value), map(i));
+      }
+
+      partials[chunk] = std::move(value);
+   });
+
+   T result = std::move(identity);
+   for (auto &partial : partials) {
+      result = reduce(std::move(result), std::move(partial));
+   }
+
+   return result;
+}
+
+} // namespace wut
+
+#endif
+
+/** @} */
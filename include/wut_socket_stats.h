@@ -0,0 +1,150 @@
+#pragma once
+#include <wut.h>
+
+/**
+ * \defgroup wut_socket_stats Socket Statistics
+ *
+ * Counters and latency histograms for the wutsocket wrappers, globally per
+ * call and per socket.
+ *
+ * Statistics are only recorded when wut is built with
+ * `make WUT_SOCKET_STATS=1`, which applies to both libwut and libwutd. In
+ * other builds the recording compiles away entirely and the functions below
+ * fail with ENOSYS.
+ *
+ * \code
+ * char text[4096];
+ * if (WUTFormatSocketStats(text, sizeof(text)) >= 0) {
+ *    WHBLogWrite(text);
+ * }
+ * \endcode
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Number of latency histogram buckets, bucket n counts calls which took
+//! 2^n to 2^(n+1) microseconds, the first and last buckets are open ended.
+#define WUT_SOCKET_STATS_BUCKETS   20
+
+//! Number of errno values counted, larger values are counted in errors[0].
+#define WUT_SOCKET_STATS_ERRNO_MAX 128
+
+//! Number of sockets with statistics, one per nsysnet socket.
+#define WUT_SOCKET_STATS_SOCKETS   32
+
+typedef enum WUTSocketCall
+{
+   WUT_SOCKET_CALL_SOCKET,
+   WUT_SOCKET_CALL_ACCEPT,
+   WUT_SOCKET_CALL_CONNECT,
+   WUT_SOCKET_CALL_CLOSE,
+   WUT_SOCKET_CALL_RECV,
+   WUT_SOCKET_CALL_RECVFROM,
+   //! recvmsg, recvmmsg and readv.
+   WUT_SOCKET_CALL_RECVMSG,
+   //! read on a socket.
+   WUT_SOCKET_CALL_READ,
+   WUT_SOCKET_CALL_SEND,
+   WUT_SOCKET_CALL_SENDTO,
+   //! sendmsg, sendmmsg and writev.
+   WUT_SOCKET_CALL_SENDMSG,
+   //! write on a socket.
+   WUT_SOCKET_CALL_WRITE,
+   WUT_SOCKET_CALL_SELECT,
+   WUT_SOCKET_CALL_POLL,
+   WUT_SOCKET_CALL_EPOLL_WAIT,
+   WUT_SOCKET_CALL_COUNT,
+} WUTSocketCall;
+
+typedef struct WUTSocketCallStats WUTSocketCallStats;
+typedef struct WUTSocketFdStats WUTSocketFdStats;
+typedef struct WUTSocketStats WUTSocketStats;
+
+struct WUTSocketCallStats
+{
+   uint32_t calls;
+
+   //! Calls which failed, not counting EWOULDBLOCK.
+   uint32_t errors;
+
+   //! Calls which failed with EWOULDBLOCK.
+   uint32_t wouldBlock;
+
+   //! Bytes transferred by the data calls.
+   uint64_t bytes;
+
+   //! Total and longest time spent in the call.
+   uint64_t totalUs;
+   uint32_t maxUs;
+
+   uint32_t latency[WUT_SOCKET_STATS_BUCKETS];
+};
+
+struct WUTSocketFdStats
+{
+   //! TRUE until the socket is closed, the statistics of a closed socket
+   //! are kept until its nsysnet socket is reused.
+   BOOL open;
+   uint32_t calls;
+   uint32_t errors;
+   uint32_t wouldBlock;
+   uint64_t bytesReceived;
+   uint64_t bytesSent;
+
+   //! Total time spent in calls on the socket.
+   uint64_t totalUs;
+};
+
+struct WUTSocketStats
+{
+   WUTSocketCallStats calls[WUT_SOCKET_CALL_COUNT];
+
+   //! Number of failed calls by errno.
+   uint32_t errors[WUT_SOCKET_STATS_ERRNO_MAX];
+};
+
+/**
+ * Get a copy of the global statistics.
+ *
+ * \return
+ * 0 on success, -1 with errno set to ENOSYS when statistics are not built in.
+ */
+int
+WUTGetSocketStats(WUTSocketStats *outStats);
+
+/**
+ * Get a copy of the statistics of a socket.
+ *
+ * \return
+ * 0 on success, -1 with errno set on failure.
+ */
+int
+WUTGetSocketFdStats(int fd,
+                    WUTSocketFdStats *outStats);
+
+/**
+ * Clear the global statistics and those of every socket.
+ */
+void
+WUTResetSocketStats(void);
+
+/**
+ * Format the statistics as text, in the style of /proc/net.
+ *
+ * \return
+ * The length of the full text like snprintf, which is truncated if it does
+ * not fit in size, or -1 with errno set to ENOSYS when statistics are not
+ * built in.
+ */
+int
+WUTFormatSocketStats(char *buffer,
+                     size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
@@ -0,0 +1,125 @@
+#pragma once
+#include <wut.h>
+#include <coreinit/thread.h>
+
+/**
+ * \defgroup wut_thread Thread Attributes
+ *
+ * Creation attributes for threads started through wut's gthread layer,
+ * which backs `std::thread`.
+ *
+ * Thread structures and stacks of finished threads are kept in a small pool
+ * and reused by the next thread with the same stack size, so short-lived
+ * workers do not allocate. The pool size can be changed by defining
+ * `uint32_t __wut_thread_pool_size`, the default stack size by defining
+ * `uint32_t __wut_thread_default_stack_size`.
+ *
+ * \code
+ * WUTThreadAttr attr;
+ * WUTInitThreadAttr(&attr);
+ * attr.affinity = OS_THREAD_ATTRIB_AFFINITY_CPU2;
+ * attr.priority = 10;
+ * attr.name     = "audio";
+ *
+ * std::thread audio = wut::make_thread(attr, audioMain);
+ * \endcode
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct WUTThreadAttr WUTThreadAttr;
+
+struct WUTThreadAttr
+{
+   //! Stack size in bytes, 0 to use __wut_thread_default_stack_size.
+   uint32_t stackSize;
+
+   //! Core affinity, a combination of OS_THREAD_ATTRIB_AFFINITY_* flags.
+   OSThreadAttributes affinity;
+
+   //! Priority from 0 (highest) to 31 (lowest).
+   int32_t priority;
+
+   //! Run quantum in microseconds, 0 to run until the thread yields.
+   uint32_t quantum;
+
+   //! Thread name, must remain valid for the lifetime of the thread.
+   const char *name;
+};
+
+/**
+ * Initialise attributes to the defaults used by std::thread: default stack
+ * size, any core, priority 16 and a 1 millisecond run quantum.
+ */
+void
+WUTInitThreadAttr(WUTThreadAttr *attr);
+
+/**
+ * Create and start a thread with the given attributes.
+ *
+ * The thread is created joinable, it must be joined with OSJoinThread or
+ * detached with OSDetachThread.
+ *
+ * \param outThread
+ * Receives the new thread.
+ *
+ * \param attr
+ * Attributes to use, or NULL for the defaults.
+ *
+ * \return
+ * 0 on success, ENOMEM or EINVAL on failure.
+ */
+int
+WUTCreateThread(OSThread **outThread,
+                const WUTThreadAttr *attr,
+                void *(*entryPoint)(void *),
+                void *entryArgs);
+
+/**
+ * Set the attributes used by the next std::thread or gthread created by the
+ * calling thread, NULL to go back to the defaults.
+ *
+ * The attributes are not copied and must remain valid until the thread has
+ * been created.
+ */
+void
+WUTSetNextThreadAttr(const WUTThreadAttr *attr);
+
+#ifdef __cplusplus
+}
+
+#include <thread>
+#include <utility>
+
+namespace wut
+{
+
+/**
+ * Construct a std::thread with the given attributes.
+ */
+template<typename Function, typename... Args>
+std::thread
+make_thread(const WUTThreadAttr &attr,
+            Function &&function,
+            Args &&...args)
+{
+   struct ResetAttr
+   {
+      ~ResetAttr()
+      {
+         WUTSetNextThreadAttr(NULL);
+      }
+   } reset;
+
+   WUTSetNextThreadAttr(&attr);
+   return std::thread(std::forward<Function>(function), std::forward<Args>(args)...);
+}
+
+} // namespace wut
+
+#endif
+
+/** @} */
@@ -1,7 +1,7 @@
 #include <coreinit/memdefaultheap.h>
 
 void
-__init_wut_sbrk_heap(MEMHeapHandle heapHandle);
+__init_wut_heap_layout(MEMHeapHandle heapHandle);
 void
 __init_wut_malloc_lock();
 void
@@ -12,7 +12,7 @@ __preinit_user(MEMHeapHandle *mem1,
                MEMHeapHandle *foreground,
                MEMHeapHandle *mem2)
 {
-   __init_wut_sbrk_heap(*mem2);
+   __init_wut_heap_layout(*mem2);
    __init_wut_malloc_lock();
    __init_wut_defaultheap();
 }
@@ -11,6 +11,12 @@ void *
 __wut_alloc_from_defaultheap_ex(uint32_t size,
                                 int32_t alignment)
 {
+   // Negative alignment requests an allocation from the tail of an expanded
+   // heap, which has no meaning for malloc so only the magnitude is used.
+   if (alignment < 0) {
+      alignment = -alignment;
+   }
+
    return memalign(alignment, size);
 }
 
@@ -50,6 +50,8 @@ __init_wut_devoptab()
    __wut_fsa_device_data.mounted     = false;
    __wut_fsa_device_data.isSDCard    = false;
 
+   __wut_fsa_init_sendfile();
+
    FSAInit();
    __wut_fsa_device_data.clientHandle = FSAAddClient(nullptr);
    if (__wut_fsa_device_data.clientHandle == 0) {
@@ -111,6 +113,8 @@ __fini_wut_devoptab()
       __wut_fsa_device_data.mounted = false;
    }
 
+   __wut_fsa_fini_sendfile();
+
    FSADelClient(__wut_fsa_device_data.clientHandle);
 
    RemoveDevice(__wut_fsa_device_data.device.name);
@@ -90,6 +90,11 @@ __init_wut_devoptab();
 FSError
 __fini_wut_devoptab();
 
+void
+__wut_fsa_init_sendfile();
+void
+__wut_fsa_fini_sendfile();
+
 int
 __wut_fsa_open(struct _reent *r, void *fileStruct, const char *path, int flags, int mode);
 int
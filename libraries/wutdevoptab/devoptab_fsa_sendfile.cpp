@@ -0,0 +1,319 @@
+#include <mutex>
+#include <sys/sendfile.h>
+#include <sys/param.h>
+#include <coreinit/messagequeue.h>
+#include <wut_thread.h>
+#include "devoptab_fsa.h"
+
+// Size of each of the two pipeline buffers
+#define SENDFILE_CHUNK_SIZE (0x20000)
+
+/**
+ * Reads the next chunk on a helper thread while the caller sends the
+ * previous one. FSA has no asynchronous read, so this is what lets the SD
+ * card and the network stack work at the same time.
+ */
+typedef struct
+{
+   //! Held by the sendfile using the pipeline, others read synchronously.
+   OSMutex mutex;
+   OSThread *thread;
+   OSMessageQueue requestQueue;
+   OSMessage requestMessages[1];
+   OSMessageQueue resultQueue;
+   OSMessage resultMessages[1];
+   uint8_t *buffers[2];
+
+   //! Client of the file being sent, set while the pipeline is claimed.
+   FSAClientHandle clientHandle;
+} __wut_fsa_sendfile_pipe_t;
+
+static __wut_fsa_sendfile_pipe_t __wut_fsa_sendfile_pipe;
+
+static void *
+__wut_fsa_sendfile_reader(void *arg)
+{
+   __wut_fsa_sendfile_pipe_t *pipe = &__wut_fsa_sendfile_pipe;
+   OSMessage message;
+
+   while (true) {
+      OSReceiveMessage(&pipe->requestQueue, &message, OS_MESSAGE_FLAGS_BLOCKING);
+      if (!message.message) {
+         break;
+      }
+
+      // args are position, size and file handle, the status goes back in args[0]
+      message.args[0] = (uint32_t)FSAReadFileWithPos(pipe->clientHandle,
+                                                     message.message, 1, message.args[1],
+                                                     message.args[0], message.args[2], 0);
+      OSSendMessage(&pipe->resultQueue, &message, OS_MESSAGE_FLAGS_BLOCKING);
+   }
+
+   return nullptr;
+}
+
+void
+__wut_fsa_init_sendfile()
+{
+   __wut_fsa_sendfile_pipe_t *pipe = &__wut_fsa_sendfile_pipe;
+
+   OSInitMutexEx(&pipe->mutex, "wut_sendfile");
+   OSInitMessageQueue(&pipe->requestQueue, pipe->requestMessages, 1);
+   OSInitMessageQueue(&pipe->resultQueue, pipe->resultMessages, 1);
+}
+
+void
+__wut_fsa_fini_sendfile()
+{
+   __wut_fsa_sendfile_pipe_t *pipe = &__wut_fsa_sendfile_pipe;
+   OSMessage message = {};
+
+   OSLockMutex(&pipe->mutex);
+   if (pipe->thread) {
+      OSSendMessage(&pipe->requestQueue, &message, OS_MESSAGE_FLAGS_BLOCKING);
+      OSJoinThread(pipe->thread, nullptr);
+      pipe->thread = nullptr;
+   }
+
+   free(pipe->buffers[0]);
+   pipe->buffers[0] = nullptr;
+   pipe->buffers[1] = nullptr;
+   OSUnlockMutex(&pipe->mutex);
+}
+
+/*
+ * Claim the pipeline, starting the reader on first use. Returns false if it
+ * is in use by another thread or could not be started.
+ */
+static bool
+__wut_fsa_sendfile_claim()
+{
+   __wut_fsa_sendfile_pipe_t *pipe = &__wut_fsa_sendfile_pipe;
+   WUTThreadAttr attr;
+
+   if (!OSTryLockMutex(&pipe->mutex)) {
+      return false;
+   }
+
+   if (pipe->thread) {
+      return true;
+   }
+
+   if (!pipe->buffers[0]) {
+      pipe->buffers[0] = (uint8_t *)memalign(0x40, SENDFILE_CHUNK_SIZE * 2);
+      if (!pipe->buffers[0]) {
+         OSUnlockMutex(&pipe->mutex);
+         return false;
+      }
+      pipe->buffers[1] = pipe->buffers[0] + SENDFILE_CHUNK_SIZE;
+   }
+
+   WUTInitThreadAttr(&attr);
+   attr.stackSize = 0x2000;
+   attr.name      = "wut sendfile reader";
+
+   if (WUTCreateThread(&pipe->thread, &attr, __wut_fsa_sendfile_reader, nullptr) != 0) {
+      pipe->thread = nullptr;
+      OSUnlockMutex(&pipe->mutex);
+      return false;
+   }
+
+   return true;
+}
+
+static void
+__wut_fsa_sendfile_request(uint8_t *buffer,
+                           uint32_t position,
+                           uint32_t size,
+                           FSAFileHandle handle)
+{
+   OSMessage message;
+   message.message = buffer;
+   message.args[0] = position;
+   message.args[1] = size;
+   message.args[2] = handle;
+   OSSendMessage(&__wut_fsa_sendfile_pipe.requestQueue, &message, OS_MESSAGE_FLAGS_BLOCKING);
+}
+
+static FSError
+__wut_fsa_sendfile_result()
+{
+   OSMessage message;
+   OSReceiveMessage(&__wut_fsa_sendfile_pipe.resultQueue, &message, OS_MESSAGE_FLAGS_BLOCKING);
+   return (FSError)message.args[0];
+}
+
+/*
+ * Write a whole chunk, returns the number of bytes written which is short
+ * when the output would block or fails after a partial write.
+ */
+static ssize_t
+__wut_fsa_sendfile_write(int out_fd,
+                         const uint8_t *buffer,
+                         size_t size)
+{
+   size_t written = 0;
+
+   while (written < size) {
+      ssize_t rc = write(out_fd, buffer + written, size - written);
+      if (rc <= 0) {
+         return written ? (ssize_t)written : rc;
+      }
+      written += rc;
+   }
+
+   return (ssize_t)written;
+}
+
+ssize_t
+sendfile(int out_fd,
+         int in_fd,
+         off_t *offset,
+         size_t count)
+{
+   __wut_fsa_sendfile_pipe_t *pipe = &__wut_fsa_sendfile_pipe;
+   __wut_fsa_device_t *deviceData;
+   __wut_fsa_file_t *file;
+   __handle *handle = __get_handle(in_fd);
+   uint32_t start, position, next;
+   FSError status      = FS_ERROR_OK;
+   size_t sent         = 0;
+   bool pipelined      = false;
+   bool error          = false;
+   int current         = 0;
+   int inFlight        = 0;
+   uint8_t *syncBuffer = nullptr;
+
+   if (!handle) {
+      errno = EBADF;
+      return -1;
+   }
+
+   if (devoptab_list[handle->device]->read_r != __wut_fsa_read) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   deviceData = (__wut_fsa_device_t *)devoptab_list[handle->device]->deviceData;
+   file       = (__wut_fsa_file_t *)handle->fileStruct;
+   if ((file->flags & O_ACCMODE) == O_WRONLY) {
+      errno = EBADF;
+      return -1;
+   }
+
+   if (offset && (*offset < 0 || *offset > UINT32_MAX)) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   std::scoped_lock lock(file->mutex);
+
+   start = offset ? (uint32_t)*offset : file->offset;
+   count = MIN(count, (size_t)(UINT32_MAX - start));
+
+   if (count > SENDFILE_CHUNK_SIZE) {
+      pipelined = __wut_fsa_sendfile_claim();
+      if (pipelined) {
+         pipe->clientHandle = deviceData->clientHandle;
+      }
+   }
+
+   if (!pipelined) {
+      syncBuffer = (uint8_t *)memalign(0x40, MIN(count, (size_t)SENDFILE_CHUNK_SIZE));
+      if (!syncBuffer && count) {
+         errno = ENOMEM;
+         return -1;
+      }
+   }
+
+   position = start;
+   next     = start;
+
+   if (pipelined) {
+      uint32_t size = MIN(count, (size_t)SENDFILE_CHUNK_SIZE);
+      __wut_fsa_sendfile_request(pipe->buffers[0], next, size, file->fd);
+      next += size;
+      inFlight++;
+   }
+
+   while (position - start < count) {
+      uint32_t requested = MIN(count - (position - start), (size_t)SENDFILE_CHUNK_SIZE);
+      uint8_t *buffer;
+      ssize_t written;
+
+      if (pipelined) {
+         buffer = pipe->buffers[current];
+         status = __wut_fsa_sendfile_result();
+         inFlight--;
+
+         // Start reading the next chunk before sending this one
+         if (status == (FSError)requested && next - start < count) {
+            uint32_t size = MIN(count - (next - start), (size_t)SENDFILE_CHUNK_SIZE);
+            __wut_fsa_sendfile_request(pipe->buffers[current ^ 1], next, size, file->fd);
+            next += size;
+            inFlight++;
+         }
+      } else {
+         buffer = syncBuffer;
+         status = FSAReadFileWithPos(deviceData->clientHandle, buffer, 1,
+                                     requested, position, file->fd, 0);
+      }
+
+      if (status < 0) {
+         WUT_DEBUG_REPORT("FSAReadFileWithPos(0x%08X, %p, 1, 0x%08X, 0x%08X, 0x%08X, 0) (%s) failed: %s\n",
+                          deviceData->clientHandle, buffer, requested, position, file->fd,
+                          file->fullPath, FSAGetStatusStr(status));
+         error = true;
+         break;
+      }
+
+      if (status == 0) {
+         break;
+      }
+
+      written = __wut_fsa_sendfile_write(out_fd, buffer, (size_t)status);
+      if (written > 0) {
+         sent     += written;
+         position += written;
+      }
+
+      if (written < 0 && !sent) {
+         error  = true;
+         status = FS_ERROR_OK;
+         break;
+      }
+
+      if (written < (ssize_t)status || (uint32_t)status < requested) {
+         // Output would block, or end of file
+         break;
+      }
+
+      current ^= 1;
+   }
+
+   if (pipelined) {
+      // Collect a read still in flight before releasing the buffers
+      while (inFlight--) {
+         __wut_fsa_sendfile_result();
+      }
+      OSUnlockMutex(&pipe->mutex);
+   }
+
+   if (offset) {
+      *offset = position;
+   } else {
+      file->offset = position;
+      FSASetPosFile(deviceData->clientHandle, file->fd, position);
+   }
+
+   free(syncBuffer);
+
+   if (error && !sent) {
+      if (status < 0) {
+         errno = __wut_fsa_translate_error(status);
+      }
+      return -1;
+   }
+
+   return (ssize_t)sent;
+}
@@ -0,0 +1,564 @@
+#include "wut_green_sched.h"
+#include <wut_thread.h>
+
+#include <coreinit/atomic.h>
+#include <coreinit/memdefaultheap.h>
+#include <errno.h>
+#include <malloc.h>
+#include <string.h>
+
+#define __WUT_GREEN_BLOCK_ALIGN  (0x40)
+#define __WUT_GREEN_HEADER_SIZE  ((sizeof(WUTGreenThread) + __WUT_GREEN_BLOCK_ALIGN - 1) & ~(__WUT_GREEN_BLOCK_ALIGN - 1))
+#define __WUT_GREEN_POLL_MIN_MS  (1)
+#define __WUT_GREEN_POLL_MAX_MS  (16)
+
+//! Maximum number of free default sized stacks kept for reuse.
+uint32_t __attribute__((weak)) __wut_green_stack_pool_size = 64;
+
+static __wut_green_sched sSchedulers[__WUT_GREEN_MAX_SCHEDULERS];
+static uint32_t sSchedulerCount   = 0;
+static volatile uint32_t sNextSched = 0;
+static volatile uint32_t sStopping  = 0;
+
+static OSSpinLock sJoinLock;
+
+static OSSpinLock sStackPoolLock;
+static WUTGreenThread *sStackPool = NULL;
+static uint32_t sStackPoolCount   = 0;
+
+static const OSThreadAttributes sCoreAffinity[__WUT_GREEN_MAX_SCHEDULERS] = {
+   OS_THREAD_ATTRIB_AFFINITY_CPU0,
+   OS_THREAD_ATTRIB_AFFINITY_CPU1,
+   OS_THREAD_ATTRIB_AFFINITY_CPU2,
+};
+
+extern BOOL __wut_green_io_init(void);
+extern void __wut_green_io_shutdown(void);
+
+static WUTGreenThread *
+__wut_green_alloc_block(uint32_t stackSize)
+{
+   WUTGreenThread *thread = NULL;
+
+   if (stackSize == WUT_GREEN_DEFAULT_STACK_SIZE) {
+      OSUninterruptibleSpinLock_Acquire(&sStackPoolLock);
+      thread = sStackPool;
+      if (thread) {
+         sStackPool = thread->next;
+         sStackPoolCount--;
+      }
+      OSUninterruptibleSpinLock_Release(&sStackPoolLock);
+   }
+
+   if (!thread) {
+      thread = (WUTGreenThread *)memalign(__WUT_GREEN_BLOCK_ALIGN, __WUT_GREEN_HEADER_SIZE + stackSize);
+   }
+
+   return thread;
+}
+
+static void
+__wut_green_free_block(WUTGreenThread *thread)
+{
+   if (thread->stackSize == WUT_GREEN_DEFAULT_STACK_SIZE) {
+      OSUninterruptibleSpinLock_Acquire(&sStackPoolLock);
+      if (sStackPoolCount < __wut_green_stack_pool_size) {
+         thread->next = sStackPool;
+         sStackPool   = thread;
+         sStackPoolCount++;
+         thread = NULL;
+      }
+      OSUninterruptibleSpinLock_Release(&sStackPoolLock);
+   }
+
+   free(thread);
+}
+
+__wut_green_sched *
+__wut_green_current_sched(void)
+{
+   OSThread *self = OSGetCurrentThread();
+   uint32_t i;
+
+   for (i = 0; i < sSchedulerCount; ++i) {
+      if (sSchedulers[i].thread == self) {
+         return &sSchedulers[i];
+      }
+   }
+
+   return NULL;
+}
+
+static void
+__wut_green_push(__wut_green_sched *sched,
+                 WUTGreenThread *thread)
+{
+   thread->next = NULL;
+
+   OSUninterruptibleSpinLock_Acquire(&sched->lock);
+   if (sched->runTail) {
+      sched->runTail->next = thread;
+   } else {
+      sched->runHead = thread;
+   }
+   sched->runTail = thread;
+   OSUninterruptibleSpinLock_Release(&sched->lock);
+
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if (sched->idle) {
+      OSSignalEvent(&sched->wakeEvent);
+   }
+}
+
+static WUTGreenThread *
+__wut_green_pop(__wut_green_sched *sched)
+{
+   WUTGreenThread *thread;
+
+   if (!sched->runHead) {
+      return NULL;
+   }
+
+   OSUninterruptibleSpinLock_Acquire(&sched->lock);
+   thread = sched->runHead;
+   if (thread) {
+      sched->runHead = thread->next;
+      if (!sched->runHead) {
+         sched->runTail = NULL;
+      }
+   }
+   OSUninterruptibleSpinLock_Release(&sched->lock);
+   return thread;
+}
+
+void
+__wut_green_park(WUTGreenThread *self)
+{
+   OSSwitchCoroutine(&self->context, &self->sched->context);
+}
+
+void
+__wut_green_wake(WUTGreenThread *thread)
+{
+   if (OSCompareAndSwapAtomic(&thread->state, __WUT_GREEN_BLOCKED, __WUT_GREEN_READY)) {
+      __wut_green_push(thread->sched, thread);
+   }
+}
+
+static void
+__wut_green_entry(void)
+{
+   __wut_green_sched *sched = __wut_green_current_sched();
+   WUTGreenThread *self     = sched->current;
+
+   self->function(self->arg);
+
+   // The scheduler cleans up once we have switched away, never returns
+   self->state = __WUT_GREEN_FINISHED;
+   __wut_green_park(self);
+}
+
+static void
+__wut_green_finish(__wut_green_sched *sched,
+                   WUTGreenThread *thread)
+{
+   BOOL detached;
+
+   OSUninterruptibleSpinLock_Acquire(&sJoinLock);
+   thread->finished = TRUE;
+   detached         = thread->detached;
+   if (thread->joiner) {
+      __wut_green_wake(thread->joiner);
+   }
+   OSUninterruptibleSpinLock_Release(&sJoinLock);
+
+   if (detached) {
+      __wut_green_free_block(thread);
+   } else {
+      OSSignalEvent(&thread->finishedEvent);
+   }
+
+   OSAddAtomic(&sched->liveCount, -1);
+}
+
+/*
+ * Move sleepers whose time has come to the run queue, returns the ticks
+ * until the next one wakes or -1 if there are none.
+ */
+static OSTime
+__wut_green_wake_sleepers(__wut_green_sched *sched)
+{
+   OSTime now = OSGetSystemTime();
+
+   while (sched->sleepers && sched->sleepers->wakeTime <= now) {
+      WUTGreenThread *thread = sched->sleepers;
+      sched->sleepers        = thread->next;
+      __wut_green_wake(thread);
+   }
+
+   return sched->sleepers ? sched->sleepers->wakeTime - now : -1;
+}
+
+/*
+ * poll fails as a whole if any fd is not a usable socket, so find out which
+ * waiters are ready or broken by polling each fd on its own.
+ */
+static void
+__wut_green_poll_each(__wut_green_sched *sched)
+{
+   uint32_t i;
+
+   for (i = 0; i < sched->socketWaiterCount; ++i) {
+      struct pollfd *pfd = &sched->pollFds[i];
+
+      if (poll(pfd, 1, 0) < 0) {
+         pfd->revents = (errno == EBADF || errno == ENOTSOCK) ? POLLNVAL : POLLERR;
+      }
+   }
+}
+
+/*
+ * Poll the sockets green threads are waiting on, waking those which are
+ * ready. Returns the number of threads woken.
+ */
+static uint32_t
+__wut_green_poll_sockets(__wut_green_sched *sched)
+{
+   WUTGreenThread **itr;
+   WUTGreenThread *thread;
+   uint32_t i = 0, woken = 0;
+   int rc;
+
+   if (sched->pollCapacity < sched->socketWaiterCount) {
+      struct pollfd *fds = (struct pollfd *)realloc(sched->pollFds,
+                                                    sched->socketWaiterCount * sizeof(struct pollfd));
+      if (!fds) {
+         return 0;
+      }
+
+      sched->pollFds      = fds;
+      sched->pollCapacity = sched->socketWaiterCount;
+   }
+
+   for (thread = sched->socketWaiters; thread; thread = thread->next, ++i) {
+      sched->pollFds[i].fd      = thread->waitFd;
+      sched->pollFds[i].events  = thread->waitEvents;
+      sched->pollFds[i].revents = 0;
+   }
+
+   rc = poll(sched->pollFds, sched->socketWaiterCount, 0);
+   if (rc < 0) {
+      __wut_green_poll_each(sched);
+   } else if (rc == 0) {
+      return 0;
+   }
+
+   itr = &sched->socketWaiters;
+   for (i = 0; *itr; ++i) {
+      thread = *itr;
+      if (sched->pollFds[i].revents) {
+         thread->waitRevents = sched->pollFds[i].revents;
+         *itr                = thread->next;
+         sched->socketWaiterCount--;
+         __wut_green_wake(thread);
+         woken++;
+      } else {
+         itr = &thread->next;
+      }
+   }
+
+   return woken;
+}
+
+static void
+__wut_green_idle(__wut_green_sched *sched,
+                 OSTime sleepTicks)
+{
+   if (sched->socketWaiterCount) {
+      // nsysnet cannot wake a poll early, so sleep on the wake event for a
+      // while and poll again, backing off the longer the sockets stay idle.
+      OSTime pollTicks = (OSTime)OSMillisecondsToTicks(sched->pollBackoff);
+      if (sleepTicks < 0 || pollTicks < sleepTicks) {
+         sleepTicks = pollTicks;
+      }
+
+      sched->pollBackoff *= 2;
+      if (sched->pollBackoff > __WUT_GREEN_POLL_MAX_MS) {
+         sched->pollBackoff = __WUT_GREEN_POLL_MAX_MS;
+      }
+   }
+
+   sched->idle = 1;
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+   if (!sched->runHead) {
+      if (sleepTicks < 0) {
+         OSWaitEvent(&sched->wakeEvent);
+      } else {
+         OSWaitEventWithTimeout(&sched->wakeEvent, OSTicksToNanoseconds(sleepTicks));
+      }
+   }
+
+   sched->idle = 0;
+}
+
+static void *
+__wut_green_sched_main(void *arg)
+{
+   __wut_green_sched *sched = (__wut_green_sched *)arg;
+
+   while (!sStopping || sched->liveCount > 0) {
+      OSTime sleepTicks      = __wut_green_wake_sleepers(sched);
+      WUTGreenThread *thread;
+
+      if (sched->socketWaiterCount && __wut_green_poll_sockets(sched)) {
+         sched->pollBackoff = __WUT_GREEN_POLL_MIN_MS;
+      }
+
+      thread = __wut_green_pop(sched);
+      if (!thread) {
+         if (!sStopping || sched->liveCount > 0) {
+            __wut_green_idle(sched, sleepTicks);
+         }
+         continue;
+      }
+
+      sched->pollBackoff = __WUT_GREEN_POLL_MIN_MS;
+      sched->current     = thread;
+      thread->state  = __WUT_GREEN_RUNNING;
+      OSSwitchCoroutine(&sched->context, &thread->context);
+      sched->current = NULL;
+
+      if (thread->state == __WUT_GREEN_FINISHED) {
+         __wut_green_finish(sched, thread);
+      }
+   }
+
+   return NULL;
+}
+
+BOOL
+WUTInitGreenScheduler(uint32_t affinity)
+{
+   uint32_t i;
+
+   if (sSchedulerCount) {
+      return TRUE;
+   }
+
+   if (!__wut_green_io_init()) {
+      return FALSE;
+   }
+
+   sStopping = 0;
+   memset(sSchedulers, 0, sizeof(sSchedulers));
+
+   for (i = 0; i < __WUT_GREEN_MAX_SCHEDULERS; ++i) {
+      __wut_green_sched *sched = &sSchedulers[sSchedulerCount];
+      WUTThreadAttr attr;
+
+      if (!(affinity & sCoreAffinity[i])) {
+         continue;
+      }
+
+      OSInitSpinLock(&sched->lock);
+      sched->affinity = sCoreAffinity[i];
+      OSInitEvent(&sched->wakeEvent, FALSE, OS_EVENT_MODE_AUTO);
+      sched->pollBackoff = __WUT_GREEN_POLL_MIN_MS;
+
+      WUTInitThreadAttr(&attr);
+      attr.affinity = sCoreAffinity[i];
+      attr.name     = "wut green thread scheduler";
+
+      if (WUTCreateThread(&sched->thread, &attr, __wut_green_sched_main, sched) != 0) {
+         break;
+      }
+
+      sSchedulerCount++;
+   }
+
+   return sSchedulerCount > 0;
+}
+
+void
+WUTShutdownGreenScheduler(void)
+{
+   uint32_t i;
+
+   sStopping = 1;
+   for (i = 0; i < sSchedulerCount; ++i) {
+      OSSignalEvent(&sSchedulers[i].wakeEvent);
+   }
+
+   for (i = 0; i < sSchedulerCount; ++i) {
+      OSJoinThread(sSchedulers[i].thread, NULL);
+      free(sSchedulers[i].pollFds);
+   }
+
+   sSchedulerCount = 0;
+   __wut_green_io_shutdown();
+}
+
+WUTGreenThread *
+WUTCreateGreenThread(WUTGreenThreadFn function,
+                     void *arg,
+                     uint32_t stackSize,
+                     int32_t core)
+{
+   __wut_green_sched *sched = NULL;
+   WUTGreenThread *thread;
+   uint32_t i;
+
+   if (!sSchedulerCount) {
+      return NULL;
+   }
+
+   if (core >= 0) {
+      for (i = 0; i < sSchedulerCount; ++i) {
+         if (sSchedulers[i].affinity & sCoreAffinity[core % __WUT_GREEN_MAX_SCHEDULERS]) {
+            sched = &sSchedulers[i];
+            break;
+         }
+      }
+   }
+
+   if (!sched) {
+      sched = &sSchedulers[OSAddAtomic((volatile int32_t *)&sNextSched, 1) % sSchedulerCount];
+   }
+
+   stackSize = stackSize ? ((stackSize + 15) & ~15) : WUT_GREEN_DEFAULT_STACK_SIZE;
+   thread    = __wut_green_alloc_block(stackSize);
+   if (!thread) {
+      return NULL;
+   }
+
+   memset(thread, 0, sizeof(WUTGreenThread));
+   thread->function  = function;
+   thread->arg       = arg;
+   thread->sched     = sched;
+   thread->stackSize = stackSize;
+   thread->state     = __WUT_GREEN_BLOCKED;
+   OSInitEvent(&thread->finishedEvent, FALSE, OS_EVENT_MODE_MANUAL);
+
+   // Leave room for the back chain at the top of the stack
+   OSInitCoroutine(&thread->context, (void *)__wut_green_entry,
+                   (uint8_t *)thread + __WUT_GREEN_HEADER_SIZE + stackSize - 16);
+
+   OSAddAtomic(&sched->liveCount, 1);
+   __wut_green_wake(thread);
+   return thread;
+}
+
+void
+WUTJoinGreenThread(WUTGreenThread *thread)
+{
+   WUTGreenThread *self = WUTGetCurrentGreenThread();
+
+   if (!thread) {
+      return;
+   }
+
+   if (self) {
+      OSUninterruptibleSpinLock_Acquire(&sJoinLock);
+      if (!thread->finished) {
+         thread->joiner = self;
+         self->state    = __WUT_GREEN_BLOCKED;
+         OSUninterruptibleSpinLock_Release(&sJoinLock);
+         __wut_green_park(self);
+      } else {
+         OSUninterruptibleSpinLock_Release(&sJoinLock);
+      }
+   }
+
+   // The scheduler signals the event after it is done with the thread
+   OSWaitEvent(&thread->finishedEvent);
+   __wut_green_free_block(thread);
+}
+
+void
+WUTDetachGreenThread(WUTGreenThread *thread)
+{
+   BOOL finished;
+
+   if (!thread) {
+      return;
+   }
+
+   OSUninterruptibleSpinLock_Acquire(&sJoinLock);
+   thread->detached = TRUE;
+   finished         = thread->finished;
+   OSUninterruptibleSpinLock_Release(&sJoinLock);
+
+   if (finished) {
+      // Wait for the scheduler to finish with it before freeing
+      OSWaitEvent(&thread->finishedEvent);
+      __wut_green_free_block(thread);
+   }
+}
+
+WUTGreenThread *
+WUTGetCurrentGreenThread(void)
+{
+   __wut_green_sched *sched = __wut_green_current_sched();
+   return sched ? sched->current : NULL;
+}
+
+void
+WUTYieldGreenThread(void)
+{
+   WUTGreenThread *self = WUTGetCurrentGreenThread();
+
+   if (!self) {
+      OSYieldThread();
+      return;
+   }
+
+   self->state = __WUT_GREEN_BLOCKED;
+   __wut_green_wake(self);
+   __wut_green_park(self);
+}
+
+void
+WUTSleepGreenThread(OSTime ticks)
+{
+   WUTGreenThread *self = WUTGetCurrentGreenThread();
+   WUTGreenThread **itr;
+
+   if (!self) {
+      OSSleepTicks(ticks);
+      return;
+   }
+
+   // Insert sorted by wake time, only this scheduler touches the list
+   self->wakeTime = OSGetSystemTime() + ticks;
+   for (itr = &self->sched->sleepers; *itr && (*itr)->wakeTime <= self->wakeTime; itr = &(*itr)->next);
+   self->next  = *itr;
+   *itr        = self;
+   self->state = __WUT_GREEN_BLOCKED;
+   __wut_green_park(self);
+}
+
+int
+WUTGreenWaitSocket(int fd,
+                   int events)
+{
+   WUTGreenThread *self = WUTGetCurrentGreenThread();
+   struct pollfd pfd;
+
+   if (!self) {
+      pfd.fd      = fd;
+      pfd.events  = events;
+      pfd.revents = 0;
+      return poll(&pfd, 1, -1) > 0 ? pfd.revents : 0;
+   }
+
+   self->waitFd      = fd;
+   self->waitEvents  = events;
+   self->waitRevents = 0;
+   self->next        = self->sched->socketWaiters;
+   self->sched->socketWaiters = self;
+   self->sched->socketWaiterCount++;
+   self->state = __WUT_GREEN_BLOCKED;
+   __wut_green_park(self);
+   return self->waitRevents;
+}
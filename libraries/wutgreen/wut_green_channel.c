@@ -0,0 +1,186 @@
+#include "wut_green_sched.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void
+__wut_green_waiter_push(WUTGreenWaiter **head,
+                        WUTGreenWaiter **tail,
+                        WUTGreenWaiter *waiter)
+{
+   waiter->next = NULL;
+   if (*tail) {
+      (*tail)->next = waiter;
+   } else {
+      *head = waiter;
+   }
+   *tail = waiter;
+}
+
+static WUTGreenWaiter *
+__wut_green_waiter_pop(WUTGreenWaiter **head,
+                       WUTGreenWaiter **tail)
+{
+   WUTGreenWaiter *waiter = *head;
+   if (waiter) {
+      *head = waiter->next;
+      if (!*head) {
+         *tail = NULL;
+      }
+   }
+   return waiter;
+}
+
+BOOL
+WUTInitGreenChannel(WUTGreenChannel *channel,
+                    uint32_t elementSize,
+                    uint32_t capacity)
+{
+   memset(channel, 0, sizeof(WUTGreenChannel));
+   OSInitSpinLock(&channel->lock);
+   channel->elementSize = elementSize;
+   channel->capacity    = capacity;
+
+   if (capacity) {
+      channel->buffer = (uint8_t *)malloc(elementSize * capacity);
+      if (!channel->buffer) {
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+void
+WUTDestroyGreenChannel(WUTGreenChannel *channel)
+{
+   free(channel->buffer);
+   channel->buffer = NULL;
+}
+
+/*
+ * Queue the waiter and park, the lock is released after the state is set so
+ * a wake from another core cannot be missed.
+ */
+static BOOL
+__wut_green_channel_wait(WUTGreenChannel *channel,
+                         WUTGreenWaiter **head,
+                         WUTGreenWaiter **tail,
+                         WUTGreenWaiter *waiter)
+{
+   WUTGreenThread *self = waiter->thread;
+
+   waiter->ok  = FALSE;
+   self->state = __WUT_GREEN_BLOCKED;
+   __wut_green_waiter_push(head, tail, waiter);
+   OSUninterruptibleSpinLock_Release(&channel->lock);
+
+   __wut_green_park(self);
+   return waiter->ok;
+}
+
+BOOL
+WUTGreenChannelSend(WUTGreenChannel *channel,
+                    const void *message)
+{
+   WUTGreenWaiter self;
+   WUTGreenWaiter *receiver;
+
+   OSUninterruptibleSpinLock_Acquire(&channel->lock);
+   if (channel->closed) {
+      OSUninterruptibleSpinLock_Release(&channel->lock);
+      return FALSE;
+   }
+
+   // Hand the message straight to a waiting receiver
+   receiver = __wut_green_waiter_pop(&channel->recvHead, &channel->recvTail);
+   if (receiver) {
+      memcpy(receiver->data, message, channel->elementSize);
+      receiver->ok = TRUE;
+      OSUninterruptibleSpinLock_Release(&channel->lock);
+      __wut_green_wake(receiver->thread);
+      return TRUE;
+   }
+
+   if (channel->count < channel->capacity) {
+      uint32_t tail = (channel->head + channel->count) % channel->capacity;
+      memcpy(channel->buffer + tail * channel->elementSize, message, channel->elementSize);
+      channel->count++;
+      OSUninterruptibleSpinLock_Release(&channel->lock);
+      return TRUE;
+   }
+
+   // Full, the receiver copies the message out of our stack
+   self.thread = WUTGetCurrentGreenThread();
+   self.data   = (void *)message;
+   return __wut_green_channel_wait(channel, &channel->sendHead, &channel->sendTail, &self);
+}
+
+BOOL
+WUTGreenChannelRecv(WUTGreenChannel *channel,
+                    void *message)
+{
+   WUTGreenWaiter self;
+   WUTGreenWaiter *sender;
+
+   OSUninterruptibleSpinLock_Acquire(&channel->lock);
+   sender = __wut_green_waiter_pop(&channel->sendHead, &channel->sendTail);
+
+   if (channel->count) {
+      uint8_t *slot = channel->buffer + channel->head * channel->elementSize;
+      memcpy(message, slot, channel->elementSize);
+
+      // Refill the slot from a waiting sender to keep messages in order
+      if (sender) {
+         memcpy(slot, sender->data, channel->elementSize);
+         channel->head = (channel->head + 1) % channel->capacity;
+      } else {
+         channel->head = (channel->head + 1) % channel->capacity;
+         channel->count--;
+      }
+   } else if (sender) {
+      memcpy(message, sender->data, channel->elementSize);
+   } else if (channel->closed) {
+      OSUninterruptibleSpinLock_Release(&channel->lock);
+      return FALSE;
+   } else {
+      self.thread = WUTGetCurrentGreenThread();
+      self.data   = message;
+      return __wut_green_channel_wait(channel, &channel->recvHead, &channel->recvTail, &self);
+   }
+
+   if (sender) {
+      sender->ok = TRUE;
+   }
+   OSUninterruptibleSpinLock_Release(&channel->lock);
+
+   if (sender) {
+      __wut_green_wake(sender->thread);
+   }
+   return TRUE;
+}
+
+void
+WUTGreenChannelClose(WUTGreenChannel *channel)
+{
+   WUTGreenWaiter *waiters[2];
+   WUTGreenWaiter *waiter;
+   int i;
+
+   OSUninterruptibleSpinLock_Acquire(&channel->lock);
+   channel->closed = TRUE;
+   waiters[0]      = channel->sendHead;
+   waiters[1]      = channel->recvHead;
+   channel->sendHead = channel->sendTail = NULL;
+   channel->recvHead = channel->recvTail = NULL;
+   OSUninterruptibleSpinLock_Release(&channel->lock);
+
+   for (i = 0; i < 2; ++i) {
+      while ((waiter = waiters[i])) {
+         // Read next first, the waiter lives on a stack which may be gone
+         // once its thread runs again
+         waiters[i] = waiter->next;
+         __wut_green_wake(waiter->thread);
+      }
+   }
+}
@@ -0,0 +1,387 @@
+#include "wut_green_sched.h"
+#include <wut_thread.h>
+
+#include <coreinit/condition.h>
+#include <coreinit/mutex.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define __WUT_GREEN_MAX_IO_THREADS (8)
+
+//! Number of helper threads running blocking calls for green threads.
+uint32_t __attribute__((weak)) __wut_green_io_threads = 2;
+
+typedef struct __wut_green_io_request __wut_green_io_request;
+
+struct __wut_green_io_request
+{
+   __wut_green_io_request *next;
+   void (*function)(void *arg);
+   void *arg;
+   WUTGreenThread *thread;
+};
+
+static OSThread *sIoThreads[__WUT_GREEN_MAX_IO_THREADS];
+static uint32_t sIoThreadCount = 0;
+
+static OSMutex sIoMutex;
+static OSCondition sIoCondition;
+static __wut_green_io_request *sIoHead = NULL;
+static __wut_green_io_request *sIoTail = NULL;
+static BOOL sIoStopping = FALSE;
+
+static void *
+__wut_green_io_main(void *arg)
+{
+   __wut_green_io_request *request;
+
+   while (TRUE) {
+      OSLockMutex(&sIoMutex);
+      while (!sIoHead && !sIoStopping) {
+         OSWaitCond(&sIoCondition, &sIoMutex);
+      }
+
+      request = sIoHead;
+      if (request) {
+         sIoHead = request->next;
+         if (!sIoHead) {
+            sIoTail = NULL;
+         }
+      }
+      OSUnlockMutex(&sIoMutex);
+
+      if (!request) {
+         break;
+      }
+
+      // The request lives on the green thread's stack, do not touch it
+      // once the thread has been woken
+      request->function(request->arg);
+      __wut_green_wake(request->thread);
+   }
+
+   return NULL;
+}
+
+BOOL
+__wut_green_io_init(void)
+{
+   uint32_t count = __wut_green_io_threads;
+
+   if (count > __WUT_GREEN_MAX_IO_THREADS) {
+      count = __WUT_GREEN_MAX_IO_THREADS;
+   }
+
+   OSInitMutex(&sIoMutex);
+   OSInitCond(&sIoCondition);
+   sIoStopping = FALSE;
+
+   for (sIoThreadCount = 0; sIoThreadCount < count; ++sIoThreadCount) {
+      WUTThreadAttr attr;
+      WUTInitThreadAttr(&attr);
+      attr.name = "wut green thread io";
+
+      if (WUTCreateThread(&sIoThreads[sIoThreadCount], &attr, __wut_green_io_main, NULL) != 0) {
+         break;
+      }
+   }
+
+   return sIoThreadCount > 0;
+}
+
+void
+__wut_green_io_shutdown(void)
+{
+   uint32_t i;
+
+   OSLockMutex(&sIoMutex);
+   sIoStopping = TRUE;
+   OSSignalCond(&sIoCondition);
+   OSUnlockMutex(&sIoMutex);
+
+   for (i = 0; i < sIoThreadCount; ++i) {
+      OSJoinThread(sIoThreads[i], NULL);
+   }
+
+   sIoThreadCount = 0;
+}
+
+void
+WUTGreenBlockingCall(void (*function)(void *arg),
+                     void *arg)
+{
+   WUTGreenThread *self = WUTGetCurrentGreenThread();
+   __wut_green_io_request request;
+
+   if (!self) {
+      function(arg);
+      return;
+   }
+
+   request.next     = NULL;
+   request.function = function;
+   request.arg      = arg;
+   request.thread   = self;
+
+   // Blocked before queueing so the wake from a helper cannot be lost
+   self->state = __WUT_GREEN_BLOCKED;
+
+   OSLockMutex(&sIoMutex);
+   if (sIoTail) {
+      sIoTail->next = &request;
+   } else {
+      sIoHead = &request;
+   }
+   sIoTail = &request;
+   OSSignalCond(&sIoCondition);
+   OSUnlockMutex(&sIoMutex);
+
+   __wut_green_park(self);
+}
+
+/*
+ * Wait for readiness before each attempt and never let the call itself
+ * block the scheduler, retrying if another thread consumed the data first.
+ */
+#define __WUT_GREEN_SOCKET_CALL(fd, events, call)                          \
+   do {                                                                    \
+      WUTGreenThread *self = WUTGetCurrentGreenThread();                   \
+      if (!self) {                                                         \
+         return call;                                                      \
+      }                                                                    \
+      while (TRUE) {                                                       \
+         __typeof__(call) result;                                          \
+         if (!(WUTGreenWaitSocket(fd, events) & (events | POLLERR | POLLHUP | POLLNVAL))) { \
+            continue;                                                      \
+         }                                                                 \
+         result = call;                                                    \
+         if (result >= 0 || (errno != EWOULDBLOCK && errno != EAGAIN)) {   \
+            return result;                                                 \
+         }                                                                 \
+      }                                                                    \
+   } while (0)
+
+/*
+ * accept has no MSG_DONTWAIT, so make the listening socket non-blocking for
+ * the call. Another thread may take the pending connection between the poll
+ * and the accept, which must not block the scheduler.
+ */
+static int
+__wut_green_accept(int fd,
+                   struct sockaddr *address,
+                   socklen_t *addressLength)
+{
+   int flags = fcntl(fd, F_GETFL);
+   int result, error;
+
+   if (flags < 0) {
+      return -1;
+   }
+
+   if (flags & O_NONBLOCK) {
+      return accept(fd, address, addressLength);
+   }
+
+   if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+      return -1;
+   }
+
+   result = accept(fd, address, addressLength);
+   error  = errno;
+
+   // Hand back a blocking socket, as a plain accept on this socket would
+   if (result >= 0) {
+      fcntl(result, F_SETFL, flags);
+   }
+
+   fcntl(fd, F_SETFL, flags);
+   errno = error;
+   return result;
+}
+
+int
+WUTGreenAccept(int fd,
+               struct sockaddr *address,
+               socklen_t *addressLength)
+{
+   // Outside a green thread accept blocks as usual
+   if (!WUTGetCurrentGreenThread()) {
+      return accept(fd, address, addressLength);
+   }
+
+   __WUT_GREEN_SOCKET_CALL(fd, POLLIN, __wut_green_accept(fd, address, addressLength));
+}
+
+typedef struct
+{
+   int fd;
+   const struct sockaddr *address;
+   socklen_t addressLength;
+   int result;
+   int error;
+} __wut_green_connect_args;
+
+static void
+__wut_green_connect(void *arg)
+{
+   __wut_green_connect_args *args = (__wut_green_connect_args *)arg;
+   args->result = connect(args->fd, args->address, args->addressLength);
+   args->error  = errno;
+}
+
+int
+WUTGreenConnect(int fd,
+                const struct sockaddr *address,
+                socklen_t addressLength)
+{
+   __wut_green_connect_args args = { fd, address, addressLength, 0, 0 };
+
+   WUTGreenBlockingCall(__wut_green_connect, &args);
+   if (args.result < 0) {
+      errno = args.error;
+   }
+   return args.result;
+}
+
+ssize_t
+WUTGreenRecv(int fd,
+             void *buffer,
+             size_t length,
+             int flags)
+{
+   __WUT_GREEN_SOCKET_CALL(fd, POLLIN, recv(fd, buffer, length, flags | MSG_DONTWAIT));
+}
+
+ssize_t
+WUTGreenSend(int fd,
+             const void *buffer,
+             size_t length,
+             int flags)
+{
+   __WUT_GREEN_SOCKET_CALL(fd, POLLOUT, send(fd, buffer, length, flags | MSG_DONTWAIT));
+}
+
+ssize_t
+WUTGreenRecvFrom(int fd,
+                 void *buffer,
+                 size_t length,
+                 int flags,
+                 struct sockaddr *address,
+                 socklen_t *addressLength)
+{
+   __WUT_GREEN_SOCKET_CALL(fd, POLLIN, recvfrom(fd, buffer, length, flags | MSG_DONTWAIT, address, addressLength));
+}
+
+ssize_t
+WUTGreenSendTo(int fd,
+               const void *buffer,
+               size_t length,
+               int flags,
+               const struct sockaddr *address,
+               socklen_t addressLength)
+{
+   __WUT_GREEN_SOCKET_CALL(fd, POLLOUT, sendto(fd, buffer, length, flags | MSG_DONTWAIT, address, addressLength));
+}
+
+typedef struct
+{
+   int fd;
+   const char *path;
+   int flags;
+   int mode;
+   void *buffer;
+   size_t length;
+   ssize_t result;
+   int error;
+} __wut_green_file_args;
+
+static void
+__wut_green_open(void *arg)
+{
+   __wut_green_file_args *args = (__wut_green_file_args *)arg;
+   args->result = open(args->path, args->flags, args->mode);
+   args->error  = errno;
+}
+
+static void
+__wut_green_close(void *arg)
+{
+   __wut_green_file_args *args = (__wut_green_file_args *)arg;
+   args->result = close(args->fd);
+   args->error  = errno;
+}
+
+static void
+__wut_green_read(void *arg)
+{
+   __wut_green_file_args *args = (__wut_green_file_args *)arg;
+   args->result = read(args->fd, args->buffer, args->length);
+   args->error  = errno;
+}
+
+static void
+__wut_green_write(void *arg)
+{
+   __wut_green_file_args *args = (__wut_green_file_args *)arg;
+   args->result = write(args->fd, args->buffer, args->length);
+   args->error  = errno;
+}
+
+static ssize_t
+__wut_green_file_call(void (*function)(void *arg),
+                      __wut_green_file_args *args)
+{
+   WUTGreenBlockingCall(function, args);
+   if (args->result < 0) {
+      errno = args->error;
+   }
+   return args->result;
+}
+
+int
+WUTGreenOpen(const char *path,
+             int flags,
+             int mode)
+{
+   __wut_green_file_args args = { 0 };
+   args.path  = path;
+   args.flags = flags;
+   args.mode  = mode;
+   return (int)__wut_green_file_call(__wut_green_open, &args);
+}
+
+int
+WUTGreenClose(int fd)
+{
+   __wut_green_file_args args = { 0 };
+   args.fd = fd;
+   return (int)__wut_green_file_call(__wut_green_close, &args);
+}
+
+ssize_t
+WUTGreenRead(int fd,
+             void *buffer,
+             size_t length)
+{
+   __wut_green_file_args args = { 0 };
+   args.fd     = fd;
+   args.buffer = buffer;
+   args.length = length;
+   return __wut_green_file_call(__wut_green_read, &args);
+}
+
+ssize_t
+WUTGreenWrite(int fd,
+              const void *buffer,
+              size_t length)
+{
+   __wut_green_file_args args = { 0 };
+   args.fd     = fd;
+   args.buffer = (void *)buffer;
+   args.length = length;
+   return __wut_green_file_call(__wut_green_write, &args);
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <wut_green.h>
+
+#include <coreinit/coroutine.h>
+#include <coreinit/event.h>
+#include <coreinit/spinlock.h>
+#include <coreinit/thread.h>
+#include <poll.h>
+
+#define __WUT_GREEN_MAX_SCHEDULERS (3)
+
+#define __WUT_GREEN_READY    (0)
+#define __WUT_GREEN_RUNNING  (1)
+#define __WUT_GREEN_BLOCKED  (2)
+#define __WUT_GREEN_FINISHED (3)
+
+typedef struct __wut_green_sched __wut_green_sched;
+
+struct WUTGreenThread
+{
+   //! Saved registers while not running.
+   OSCoroutine context;
+
+   WUTGreenThreadFn function;
+   void *arg;
+
+   __wut_green_sched *sched;
+   volatile uint32_t state;
+
+   //! Next thread in the run queue, or sleep / socket wait list.
+   WUTGreenThread *next;
+
+   //! Wake time while sleeping.
+   OSTime wakeTime;
+
+   //! Socket wait, only used by the owning scheduler.
+   int waitFd;
+   int waitEvents;
+   int waitRevents;
+
+   //! Join bookkeeping, protected by the join lock.
+   BOOL detached;
+   BOOL finished;
+   WUTGreenThread *joiner;
+   OSEvent finishedEvent;
+
+   //! Size of the stack which follows this structure.
+   uint32_t stackSize;
+};
+
+struct __wut_green_sched
+{
+   OSSpinLock lock;
+
+   //! Threads ready to run, pushed from any core under lock.
+   WUTGreenThread *runHead;
+   WUTGreenThread *runTail;
+
+   //! Context of the scheduler loop itself.
+   OSCoroutine context;
+   WUTGreenThread *current;
+
+   OSThread *thread;
+   uint32_t affinity;
+   OSEvent wakeEvent;
+   volatile uint32_t idle;
+
+   //! Number of unfinished threads created on this scheduler.
+   volatile int32_t liveCount;
+
+   //! Sleeping threads sorted by wake time, scheduler thread only.
+   WUTGreenThread *sleepers;
+
+   //! Threads waiting on sockets, scheduler thread only.
+   WUTGreenThread *socketWaiters;
+   uint32_t socketWaiterCount;
+   struct pollfd *pollFds;
+   uint32_t pollCapacity;
+
+   //! Milliseconds to sleep between socket polls while idle.
+   uint32_t pollBackoff;
+};
+
+__wut_green_sched *
+__wut_green_current_sched(void);
+
+/*
+ * Switch from the calling green thread back to its scheduler. The caller
+ * sets its state first, a blocked thread runs again once another thread
+ * passes it to __wut_green_wake.
+ */
+void
+__wut_green_park(WUTGreenThread *self);
+
+/*
+ * Make a blocked thread runnable, may be called from any thread.
+ */
+void
+__wut_green_wake(WUTGreenThread *thread);
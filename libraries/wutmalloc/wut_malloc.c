@@ -1,13 +1,303 @@
+#include <coreinit/atomic.h>
+#include <coreinit/core.h>
+#include <coreinit/interrupts.h>
 #include <coreinit/memdefaultheap.h>
 #include <coreinit/memexpheap.h>
 #include <coreinit/memorymap.h>
 #include <errno.h>
 #include <malloc.h>
+#include <stdio.h>
 #include <string.h>
 
+#define __WUT_MALLOC_ALIGN            (0x40)
+#define __WUT_MALLOC_MIN_ALIGN        (0x8)
+#define __WUT_MALLOC_SMALL_ALIGN      (0x10)
+#define __WUT_MALLOC_CACHE_ALIGN_SIZE (0x400)
+#define __WUT_MALLOC_LARGE_THRESHOLD  (512 * 1024)
+#define __WUT_MALLOC_MAX_CORES        (3)
+
+/*
+ * Allocations of at least this many bytes are taken from the tail of the
+ * default heap instead of the head, so long-lived large buffers do not leave
+ * holes between the small objects. Can be overridden by the application or
+ * changed at runtime with mallopt(M_MMAP_THRESHOLD, size).
+ */
+uint32_t __attribute__((weak)) __wut_malloc_large_threshold = __WUT_MALLOC_LARGE_THRESHOLD;
+
+/*
+ * Blocks of at least this many bytes, or whose size is a multiple of a cache
+ * line, are aligned to a cache line so they can be flushed or handed to
+ * hardware without touching their neighbours. Smaller blocks only get the
+ * natural alignment for their size, which keeps the padding in front of the
+ * 0x14 byte expanded heap block header down for small objects.
+ */
+uint32_t __attribute__((weak)) __wut_malloc_cache_align_size = __WUT_MALLOC_CACHE_ALIGN_SIZE;
+
+/*
+ * When non-zero, __init_wut_malloc creates one expanded heap of this size per
+ * core. Small allocations are served from the heap of the calling core with
+ * interrupts disabled instead of going through the shared default heap lock,
+ * blocks freed by another core are queued on the owner's remote free list and
+ * released by the owner on its next malloc or free. Allocations fall back to
+ * the default heap once a core heap is exhausted.
+ */
+uint32_t __attribute__((weak)) __wut_malloc_per_core_heap_size = 0;
+
+typedef struct __attribute__((aligned(0x40)))
+{
+   MEMHeapHandle heap;
+   uint8_t *start;
+   uint8_t *end;
+
+   //! Blocks freed by other cores, linked through their first word
+   volatile uint32_t remoteFree;
+
+   //! Only modified by the owning core with interrupts disabled
+   uint32_t allocCount;
+   uint32_t allocBytes;
+} __wut_malloc_core_heap;
+
+static __wut_malloc_core_heap sCoreHeaps[__WUT_MALLOC_MAX_CORES];
+static uint32_t sCoreHeapCount = 0;
+
+static volatile int32_t sSmallAllocCount = 0;
+static volatile int32_t sSmallAllocBytes = 0;
+static volatile int32_t sLargeAllocCount = 0;
+static volatile int32_t sLargeAllocBytes = 0;
+static volatile uint32_t sPeakAllocBytes = 0;
+
+static inline int
+__wut_malloc_is_large(uint32_t size)
+{
+   return __wut_malloc_large_threshold && size >= __wut_malloc_large_threshold;
+}
+
+static inline uint32_t
+__wut_malloc_default_align(uint32_t size)
+{
+   if (size >= __wut_malloc_cache_align_size || (size && !(size & (__WUT_MALLOC_ALIGN - 1)))) {
+      return __WUT_MALLOC_ALIGN;
+   }
+
+   return (size > __WUT_MALLOC_MIN_ALIGN) ? __WUT_MALLOC_SMALL_ALIGN : __WUT_MALLOC_MIN_ALIGN;
+}
+
+static void
+__wut_malloc_update_peak(void)
+{
+   uint32_t peak = sPeakAllocBytes;
+   uint32_t used = (uint32_t)(sSmallAllocBytes + sLargeAllocBytes);
+   uint32_t i;
+
+   // Per core counters may be slightly stale from other cores, which is fine
+   // for a high water mark
+   for (i = 0; i < sCoreHeapCount; ++i) {
+      used += sCoreHeaps[i].allocBytes;
+   }
+
+   while (used > peak) {
+      if (OSCompareAndSwapAtomicEx(&sPeakAllocBytes, peak, used, &peak)) {
+         break;
+      }
+   }
+}
+
+static void
+__wut_malloc_core_release(__wut_malloc_core_heap *core,
+                          void *ptr)
+{
+   core->allocCount--;
+   core->allocBytes -= MEMGetSizeForMBlockExpHeap(ptr);
+   MEMFreeToExpHeap(core->heap, ptr);
+}
+
+static void
+__wut_malloc_core_drain(__wut_malloc_core_heap *core)
+{
+   uint32_t block;
+
+   if (!core->remoteFree) {
+      return;
+   }
+
+   block = OSSwapAtomic(&core->remoteFree, 0);
+   while (block) {
+      uint32_t next = *(uint32_t *)block;
+      __wut_malloc_core_release(core, (void *)block);
+      block = next;
+   }
+}
+
+static void *
+__wut_malloc_core_alloc(uint32_t size,
+                        uint32_t align)
+{
+   __wut_malloc_core_heap *core;
+   uint32_t coreId;
+   void *ptr = NULL;
+   BOOL enabled;
+
+   // Disabling interrupts pins us to this core and serialises with every
+   // other thread that can touch its heap.
+   enabled = OSDisableInterrupts();
+   coreId  = OSGetCoreId();
+
+   if (coreId < sCoreHeapCount) {
+      core = &sCoreHeaps[coreId];
+      __wut_malloc_core_drain(core);
+
+      ptr = MEMAllocFromExpHeapEx(core->heap, size, align);
+      if (ptr) {
+         core->allocCount++;
+         core->allocBytes += MEMGetSizeForMBlockExpHeap(ptr);
+      }
+   }
+
+   OSRestoreInterrupts(enabled);
+   return ptr;
+}
+
+static int
+__wut_malloc_core_free(void *ptr)
+{
+   __wut_malloc_core_heap *core = NULL;
+   uint32_t i, head;
+   BOOL enabled;
+
+   for (i = 0; i < sCoreHeapCount; ++i) {
+      if ((uint8_t *)ptr >= sCoreHeaps[i].start && (uint8_t *)ptr < sCoreHeaps[i].end) {
+         core = &sCoreHeaps[i];
+         break;
+      }
+   }
+
+   if (!core) {
+      return 0;
+   }
+
+   enabled = OSDisableInterrupts();
+
+   if (OSGetCoreId() == i) {
+      __wut_malloc_core_drain(core);
+      __wut_malloc_core_release(core, ptr);
+   } else {
+      head = core->remoteFree;
+      do {
+         *(uint32_t *)ptr = head;
+      } while (!OSCompareAndSwapAtomicEx(&core->remoteFree, head, (uint32_t)ptr, &head));
+   }
+
+   OSRestoreInterrupts(enabled);
+   return 1;
+}
+
+static void
+__wut_malloc_init_core_heaps(uint32_t size)
+{
+   uint32_t i, count = OSGetCoreCount();
+   if (count > __WUT_MALLOC_MAX_CORES) {
+      count = __WUT_MALLOC_MAX_CORES;
+   }
+
+   for (i = 0; i < count; ++i) {
+      __wut_malloc_core_heap *core = &sCoreHeaps[i];
+      void *base                   = MEMAllocFromDefaultHeapEx(size, __WUT_MALLOC_ALIGN);
+      if (!base) {
+         break;
+      }
+
+      // No heap lock needed, access is serialised by disabling interrupts
+      core->heap = MEMCreateExpHeapEx(base, size, 0);
+      if (!core->heap) {
+         MEMFreeToDefaultHeap(base);
+         break;
+      }
+
+      core->start      = (uint8_t *)base;
+      core->end        = (uint8_t *)base + size;
+      core->remoteFree = 0;
+      core->allocCount = 0;
+      core->allocBytes = 0;
+   }
+
+   sCoreHeapCount = i;
+}
+
+static void *
+__wut_malloc_alloc(struct _reent *r,
+                   uint32_t size,
+                   uint32_t align)
+{
+   void *ptr;
+   int32_t blockSize;
+
+   if (sCoreHeapCount && !__wut_malloc_is_large(size)) {
+      ptr = __wut_malloc_core_alloc(size, align);
+      if (ptr) {
+         __wut_malloc_update_peak();
+         return ptr;
+      }
+   }
+
+   if (__wut_malloc_is_large(size)) {
+      // Negative alignment allocates from the tail of the expanded heap
+      ptr = MEMAllocFromDefaultHeapEx(size, -(int32_t)align);
+      if (!ptr) {
+         // Fall back to the head rather than failing outright
+         ptr = MEMAllocFromDefaultHeapEx(size, align);
+      }
+   } else {
+      ptr = MEMAllocFromDefaultHeapEx(size, align);
+   }
+
+   if (!ptr) {
+      r->_errno = ENOMEM;
+      return NULL;
+   }
+
+   // Classify by size rather than heap end, so large blocks which fell back
+   // to the head still count as large. Using the block size keeps alloc and
+   // free in agreement.
+   blockSize = (int32_t)MEMGetSizeForMBlockExpHeap(ptr);
+   if (__wut_malloc_is_large((uint32_t)blockSize)) {
+      OSAddAtomic(&sLargeAllocCount, 1);
+      OSAddAtomic(&sLargeAllocBytes, blockSize);
+   } else {
+      OSAddAtomic(&sSmallAllocCount, 1);
+      OSAddAtomic(&sSmallAllocBytes, blockSize);
+   }
+
+   __wut_malloc_update_peak();
+   return ptr;
+}
+
+static void
+__wut_malloc_free(void *ptr)
+{
+   int32_t blockSize;
+
+   if (sCoreHeapCount && __wut_malloc_core_free(ptr)) {
+      return;
+   }
+
+   blockSize = (int32_t)MEMGetSizeForMBlockExpHeap(ptr);
+   if (__wut_malloc_is_large((uint32_t)blockSize)) {
+      OSAddAtomic(&sLargeAllocCount, -1);
+      OSAddAtomic(&sLargeAllocBytes, -blockSize);
+   } else {
+      OSAddAtomic(&sSmallAllocCount, -1);
+      OSAddAtomic(&sSmallAllocBytes, -blockSize);
+   }
+
+   MEMFreeToDefaultHeap(ptr);
+}
+
 void
 __init_wut_malloc(void)
 {
+   if (__wut_malloc_per_core_heap_size && !sCoreHeapCount) {
+      __wut_malloc_init_core_heaps(__wut_malloc_per_core_heap_size);
+   }
 }
 
 void
@@ -18,34 +308,29 @@ __fini_wut_malloc(void)
 void *
 _malloc_r(struct _reent *r, size_t size)
 {
-   void *ptr = MEMAllocFromDefaultHeapEx(size, 0x40);
-   if (!ptr) {
-      r->_errno = ENOMEM;
-   }
-   return ptr;
+   return __wut_malloc_alloc(r, size, __wut_malloc_default_align(size));
 }
 
 void
 _free_r(struct _reent *r, void *ptr)
 {
    if (ptr) {
-      MEMFreeToDefaultHeap(ptr);
+      __wut_malloc_free(ptr);
    }
 }
 
 void *
 _realloc_r(struct _reent *r, void *ptr, size_t size)
 {
-   void *new_ptr = MEMAllocFromDefaultHeapEx(size, 0x40);
+   void *new_ptr = __wut_malloc_alloc(r, size, __wut_malloc_default_align(size));
    if (!new_ptr) {
-      r->_errno = ENOMEM;
       return new_ptr;
    }
 
    if (ptr) {
       size_t old_size = MEMGetSizeForMBlockExpHeap(ptr);
       memcpy(new_ptr, ptr, old_size <= size ? old_size : size);
-      MEMFreeToDefaultHeap(ptr);
+      __wut_malloc_free(ptr);
    }
    return new_ptr;
 }
@@ -53,11 +338,9 @@ _realloc_r(struct _reent *r, void *ptr, size_t size)
 void *
 _calloc_r(struct _reent *r, size_t num, size_t size)
 {
-   void *ptr = MEMAllocFromDefaultHeapEx(num * size, 0x40);
+   void *ptr = __wut_malloc_alloc(r, num * size, __wut_malloc_default_align(num * size));
    if (ptr) {
       memset(ptr, 0, num * size);
-   } else {
-      r->_errno = ENOMEM;
    }
 
    return ptr;
@@ -66,55 +349,93 @@ _calloc_r(struct _reent *r, size_t num, size_t size)
 void *
 _memalign_r(struct _reent *r, size_t align, size_t size)
 {
-   void *ptr = MEMAllocFromDefaultHeapEx((size + align - 1) & ~(align - 1), align);
-   if (!ptr) {
-      r->_errno = ENOMEM;
+   // The expanded heap aligns the block itself, there is no need to round
+   // the size up to the alignment as well.
+   if (align < __WUT_MALLOC_MIN_ALIGN) {
+      align = __WUT_MALLOC_MIN_ALIGN;
    }
-   return ptr;
+
+   return __wut_malloc_alloc(r, size, align);
 }
 
 struct mallinfo
 _mallinfo_r(struct _reent *r)
 {
    struct mallinfo info = {0};
+   uint32_t i;
+
+   info.arena    = (size_t)sSmallAllocBytes;
+   info.ordblks  = (size_t)sSmallAllocCount;
+   info.hblks    = (size_t)sLargeAllocCount;
+   info.hblkhd   = (size_t)sLargeAllocBytes;
+   info.usmblks  = sPeakAllocBytes;
+
+   for (i = 0; i < sCoreHeapCount; ++i) {
+      info.arena    += sCoreHeaps[i].allocBytes;
+      info.ordblks  += sCoreHeaps[i].allocCount;
+      info.fordblks += MEMGetTotalFreeSizeForExpHeap(sCoreHeaps[i].heap);
+   }
+
+   info.uordblks = info.arena + info.hblkhd;
    return info;
 }
 
 void
 _malloc_stats_r(struct _reent *r)
 {
+   struct mallinfo info = _mallinfo_r(r);
+
+   fiprintf(stderr, "max system bytes = %10u\n", (unsigned int)info.usmblks);
+   fiprintf(stderr, "in use bytes     = %10u\n", (unsigned int)info.uordblks);
+   fiprintf(stderr, "small blocks     = %10u (%u bytes)\n", (unsigned int)info.ordblks, (unsigned int)info.arena);
+   fiprintf(stderr, "large blocks     = %10u (%u bytes)\n", (unsigned int)info.hblks, (unsigned int)info.hblkhd);
+   fiprintf(stderr, "large threshold  = %10u\n", (unsigned int)__wut_malloc_large_threshold);
+
+   for (uint32_t i = 0; i < sCoreHeapCount; ++i) {
+      fiprintf(stderr, "core %u heap      = %10u (%u bytes, %u free)\n", (unsigned int)i,
+               (unsigned int)sCoreHeaps[i].allocCount,
+               (unsigned int)sCoreHeaps[i].allocBytes,
+               (unsigned int)MEMGetTotalFreeSizeForExpHeap(sCoreHeaps[i].heap));
+   }
 }
 
 int
 _mallopt_r(struct _reent *r, int param, int value)
 {
+   if (param == M_MMAP_THRESHOLD) {
+      if (value < 0) {
+         return 0;
+      }
+
+      __wut_malloc_large_threshold = (uint32_t)value;
+      return 1;
+   }
+
    return 0;
 }
 
 size_t
 _malloc_usable_size_r(struct _reent *r, void *ptr)
 {
+   // Front alignment padding is not part of the block, so this is exactly
+   // the number of bytes the caller may use.
+   if (!ptr) {
+      return 0;
+   }
+
    return MEMGetSizeForMBlockExpHeap(ptr);
 }
 
 void *
 _valloc_r(struct _reent *r, size_t size)
 {
-   void *ptr = MEMAllocFromDefaultHeapEx(size, OS_PAGE_SIZE);
-   if (!ptr) {
-      r->_errno = ENOMEM;
-   }
-   return ptr;
+   return __wut_malloc_alloc(r, size, OS_PAGE_SIZE);
 }
 
 void *
 _pvalloc_r(struct _reent *r, size_t size)
 {
-   void *ptr = MEMAllocFromDefaultHeapEx((size + (OS_PAGE_SIZE - 1)) & ~(OS_PAGE_SIZE - 1), OS_PAGE_SIZE);
-   if (!ptr) {
-      r->_errno = ENOMEM;
-   }
-   return ptr;
+   return __wut_malloc_alloc(r, (size + (OS_PAGE_SIZE - 1)) & ~(OS_PAGE_SIZE - 1), OS_PAGE_SIZE);
 }
 
 int
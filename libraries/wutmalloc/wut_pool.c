@@ -0,0 +1,238 @@
+#include <wut_pool.h>
+
+#include <coreinit/core.h>
+#include <coreinit/interrupts.h>
+#include <coreinit/memdefaultheap.h>
+#include <coreinit/memunitheap.h>
+#include <string.h>
+
+#define __WUT_POOL_CHUNK_ALIGN (0x40)
+
+struct WUTPoolChunk
+{
+   WUTPoolChunk *next;
+   MEMHeapHandle heap;
+};
+
+/*
+ * Every chunk is aligned to its power of two size, so the chunk holding an
+ * object is found by masking the object's address.
+ */
+static inline WUTPoolChunk *
+__wut_pool_find_chunk(WUTPool *pool,
+                      void *object)
+{
+   return (WUTPoolChunk *)((uint32_t)object & ~(pool->chunkSize - 1));
+}
+
+/*
+ * Move objects from the unit heaps into an empty magazine. Called with
+ * interrupts disabled, returns the number of objects moved.
+ */
+static uint32_t
+__wut_pool_refill(WUTPool *pool,
+                  WUTPoolMagazine *magazine)
+{
+   WUTPoolChunk *chunk;
+
+   OSUninterruptibleSpinLock_Acquire(&pool->lock);
+
+   for (chunk = pool->chunks; chunk && magazine->count < WUT_POOL_MAGAZINE_SIZE / 2; chunk = chunk->next) {
+      while (magazine->count < WUT_POOL_MAGAZINE_SIZE / 2) {
+         void *object = MEMAllocFromUnitHeap(chunk->heap);
+         if (!object) {
+            break;
+         }
+
+         magazine->objects[magazine->count++] = object;
+      }
+   }
+
+   OSUninterruptibleSpinLock_Release(&pool->lock);
+   return magazine->count;
+}
+
+/*
+ * Return the older half of a full magazine to the unit heaps. Called with
+ * interrupts disabled.
+ */
+static void
+__wut_pool_flush(WUTPool *pool,
+                 WUTPoolMagazine *magazine)
+{
+   uint32_t i, count = WUT_POOL_MAGAZINE_SIZE / 2;
+
+   OSUninterruptibleSpinLock_Acquire(&pool->lock);
+
+   for (i = 0; i < count; ++i) {
+      WUTPoolChunk *chunk = __wut_pool_find_chunk(pool, magazine->objects[i]);
+      MEMFreeToUnitHeap(chunk->heap, magazine->objects[i]);
+   }
+
+   OSUninterruptibleSpinLock_Release(&pool->lock);
+
+   memmove(&magazine->objects[0], &magazine->objects[count],
+           (magazine->count - count) * sizeof(void *));
+   magazine->count -= count;
+}
+
+static BOOL
+__wut_pool_grow(WUTPool *pool)
+{
+   uint32_t heapSize, size;
+   WUTPoolChunk *chunk;
+   MEMHeapHandle heap;
+   uint8_t *base;
+
+   if (pool->maxChunks && pool->chunkCount >= pool->maxChunks) {
+      return FALSE;
+   }
+
+   heapSize = MEMCalcHeapSizeForUnitHeap(pool->objectSize, pool->objectsPerChunk, pool->alignment);
+   size     = __WUT_POOL_CHUNK_ALIGN + heapSize;
+   base     = (uint8_t *)MEMAllocFromDefaultHeapEx(size, (int32_t)pool->chunkSize);
+   if (!base) {
+      return FALSE;
+   }
+
+   // The pool lock serialises access, the unit heap does not need its own
+   heap = MEMCreateUnitHeapEx(base + __WUT_POOL_CHUNK_ALIGN, heapSize,
+                              pool->objectSize, pool->alignment, 0);
+   if (!heap) {
+      MEMFreeToDefaultHeap(base);
+      return FALSE;
+   }
+
+   chunk       = (WUTPoolChunk *)base;
+   chunk->heap = heap;
+
+   OSUninterruptibleSpinLock_Acquire(&pool->lock);
+   if (pool->maxChunks && pool->chunkCount >= pool->maxChunks) {
+      // Another thread grew the pool in the meantime
+      OSUninterruptibleSpinLock_Release(&pool->lock);
+      MEMDestroyUnitHeap(heap);
+      MEMFreeToDefaultHeap(base);
+      return TRUE;
+   }
+
+   chunk->next  = pool->chunks;
+   pool->chunks = chunk;
+   pool->chunkCount++;
+   OSUninterruptibleSpinLock_Release(&pool->lock);
+   return TRUE;
+}
+
+BOOL
+WUTInitPool(WUTPool *pool,
+            uint32_t objectSize,
+            uint32_t alignment,
+            uint32_t objectsPerChunk,
+            uint32_t maxChunks)
+{
+   uint32_t size;
+
+   if (!pool || !objectSize || !objectsPerChunk) {
+      return FALSE;
+   }
+
+   if (alignment < 4) {
+      alignment = 4;
+   }
+
+   if (alignment & (alignment - 1)) {
+      return FALSE;
+   }
+
+   memset(pool, 0, sizeof(WUTPool));
+   OSInitSpinLock(&pool->lock);
+   pool->maxChunks       = maxChunks;
+   pool->objectSize      = (objectSize + alignment - 1) & ~(alignment - 1);
+   pool->objectsPerChunk = objectsPerChunk;
+   pool->alignment       = (int32_t)alignment;
+
+   size = __WUT_POOL_CHUNK_ALIGN +
+          MEMCalcHeapSizeForUnitHeap(pool->objectSize, objectsPerChunk, pool->alignment);
+   if (size > 0x80000000) {
+      return FALSE;
+   }
+
+   pool->chunkSize = __WUT_POOL_CHUNK_ALIGN;
+   while (pool->chunkSize < size) {
+      pool->chunkSize <<= 1;
+   }
+
+   return TRUE;
+}
+
+void
+WUTDestroyPool(WUTPool *pool)
+{
+   WUTPoolChunk *chunk = pool->chunks;
+
+   while (chunk) {
+      WUTPoolChunk *next = chunk->next;
+      MEMDestroyUnitHeap(chunk->heap);
+      MEMFreeToDefaultHeap(chunk);
+      chunk = next;
+   }
+
+   memset(pool->magazines, 0, sizeof(pool->magazines));
+   pool->chunks     = NULL;
+   pool->chunkCount = 0;
+}
+
+void *
+WUTAllocFromPool(WUTPool *pool)
+{
+   WUTPoolMagazine *magazine;
+   void *object;
+   BOOL enabled;
+
+   while (TRUE) {
+      // Disabling interrupts keeps us on this core and owning its magazine
+      enabled  = OSDisableInterrupts();
+      magazine = &pool->magazines[OSGetCoreId() % WUT_POOL_MAX_CORES];
+
+      if (magazine->count || __wut_pool_refill(pool, magazine)) {
+         object = magazine->objects[--magazine->count];
+         OSRestoreInterrupts(enabled);
+         return object;
+      }
+
+      OSRestoreInterrupts(enabled);
+
+      if (!__wut_pool_grow(pool)) {
+         return NULL;
+      }
+   }
+}
+
+void
+WUTFreeToPool(WUTPool *pool,
+              void *object)
+{
+   WUTPoolMagazine *magazine;
+   BOOL enabled;
+
+   if (!object) {
+      return;
+   }
+
+   // Objects are interchangeable, so a free from another core simply lands
+   // in that core's magazine without touching the allocating core.
+   enabled  = OSDisableInterrupts();
+   magazine = &pool->magazines[OSGetCoreId() % WUT_POOL_MAX_CORES];
+
+   if (magazine->count == WUT_POOL_MAGAZINE_SIZE) {
+      __wut_pool_flush(pool, magazine);
+   }
+
+   magazine->objects[magazine->count++] = object;
+   OSRestoreInterrupts(enabled);
+}
+
+uint32_t
+WUTGetPoolCapacity(WUTPool *pool)
+{
+   return pool->chunkCount * pool->objectsPerChunk;
+}
@@ -0,0 +1,122 @@
+#include "wut_newlib.h"
+#include <wut_heap.h>
+
+#include <coreinit/memexpheap.h>
+#include <coreinit/memheap.h>
+#include <coreinit/memunitheap.h>
+
+#define __WUT_HEAP_PERCENT_FLAG (0x80000000u)
+#define __WUT_HEAP_ALIGN        (0x40)
+
+const WUTHeapLayout __attribute__((weak)) __wut_heap_layout = {0};
+
+static MEMHeapHandle sParentHeap = NULL;
+static MEMHeapHandle sGPUHeap    = NULL;
+static void *sGPUHeapBase        = NULL;
+static MEMHeapHandle sUnitHeap   = NULL;
+static void *sUnitHeapBase       = NULL;
+
+static uint32_t
+__wut_heap_layout_resolve(uint32_t value,
+                          uint32_t total)
+{
+   if (value & __WUT_HEAP_PERCENT_FLAG) {
+      uint32_t percent = value & ~__WUT_HEAP_PERCENT_FLAG;
+      if (percent > 100) {
+         percent = 100;
+      }
+
+      value = (uint32_t)(((uint64_t)total * percent) / 100);
+   }
+
+   return value & ~(__WUT_HEAP_ALIGN - 1);
+}
+
+static void *
+__wut_heap_layout_alloc_tail(uint32_t size)
+{
+   // Take pools from the tail so the malloc heap can grow from the head
+   return MEMAllocFromExpHeapEx(sParentHeap, size, -__WUT_HEAP_ALIGN);
+}
+
+void
+__init_wut_heap_layout(MEMHeapHandle heapHandle)
+{
+   const WUTHeapLayout *layout = &__wut_heap_layout;
+   uint32_t total, size, reserve, mallocSize, mallocInitialSize;
+
+   sParentHeap = heapHandle;
+   total       = MEMGetAllocatableSizeForExpHeapEx(heapHandle, 4);
+
+   size        = __wut_heap_layout_resolve(layout->gpuHeapSize, total);
+   if (size) {
+      sGPUHeapBase = __wut_heap_layout_alloc_tail(size);
+      if (sGPUHeapBase) {
+         sGPUHeap = MEMCreateExpHeapEx(sGPUHeapBase, size, MEM_HEAP_FLAG_USE_LOCK);
+         if (!sGPUHeap) {
+            MEMFreeToExpHeap(heapHandle, sGPUHeapBase);
+            sGPUHeapBase = NULL;
+         }
+      }
+   }
+
+   size = __wut_heap_layout_resolve(layout->unitHeapSize, total);
+   if (size && layout->unitHeapBlockSize) {
+      sUnitHeapBase = __wut_heap_layout_alloc_tail(size);
+      if (sUnitHeapBase) {
+         sUnitHeap = MEMCreateUnitHeapEx(sUnitHeapBase, size, layout->unitHeapBlockSize,
+                                         4, MEM_HEAP_FLAG_USE_LOCK);
+         if (!sUnitHeap) {
+            MEMFreeToExpHeap(heapHandle, sUnitHeapBase);
+            sUnitHeapBase = NULL;
+         }
+      }
+   }
+
+   // Whatever is left, minus the reserve, is available to malloc
+   reserve = __wut_heap_layout_resolve(layout->reserveSize, total);
+   size    = MEMGetAllocatableSizeForExpHeapEx(heapHandle, 4);
+   size    = (size > reserve) ? (size - reserve) : 0;
+
+   mallocSize = __wut_heap_layout_resolve(layout->mallocSize, total);
+   if (!mallocSize || mallocSize > size) {
+      mallocSize = size;
+   }
+
+   mallocInitialSize = __wut_heap_layout_resolve(layout->mallocInitialSize, total);
+   if (!mallocInitialSize || mallocInitialSize > mallocSize) {
+      mallocInitialSize = mallocSize;
+   }
+
+   __init_wut_sbrk_heap_ex(heapHandle, mallocInitialSize, mallocSize);
+}
+
+void
+__fini_wut_heap_layout()
+{
+   if (sUnitHeap) {
+      MEMDestroyUnitHeap(sUnitHeap);
+      MEMFreeToExpHeap(sParentHeap, sUnitHeapBase);
+      sUnitHeap     = NULL;
+      sUnitHeapBase = NULL;
+   }
+
+   if (sGPUHeap) {
+      MEMDestroyExpHeap(sGPUHeap);
+      MEMFreeToExpHeap(sParentHeap, sGPUHeapBase);
+      sGPUHeap     = NULL;
+      sGPUHeapBase = NULL;
+   }
+}
+
+MEMHeapHandle
+WUTGetGPUHeap(void)
+{
+   return sGPUHeap;
+}
+
+MEMHeapHandle
+WUTGetUnitHeap(void)
+{
+   return sUnitHeap;
+}
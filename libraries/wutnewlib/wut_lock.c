@@ -1,57 +1,152 @@
 #include "wut_newlib.h"
+#include <wut_lock.h>
 
 #include <coreinit/atomic.h>
-#include <coreinit/mutex.h>
+#include <coreinit/fastmutex.h>
+#include <coreinit/memdefaultheap.h>
+#include <coreinit/thread.h>
+#include <string.h>
 
-#define MAX_LOCKS 16
+#define LOCKS_PER_BLOCK 32
+#define MAX_LOCK_BLOCKS 128
+#define MAX_LOCKS       (LOCKS_PER_BLOCK * MAX_LOCK_BLOCKS)
+#define LOCK_SPIN_COUNT 100
 
-static OSMutex sLibcLocks[MAX_LOCKS];
-static volatile uint32_t sLibcLockUsedMask = 0;
+typedef struct
+{
+   OSFastMutex mutex;
+   OSThread *owner;
+   uint32_t count;
+   uint32_t recursive;
+} __wut_lock;
 
-static inline bool
-__wut_is_lock_valid(int *lock)
+typedef struct
 {
-   return lock && *lock >= 0 && *lock < MAX_LOCKS;
-}
+   volatile uint32_t usedMask;
+   __wut_lock locks[LOCKS_PER_BLOCK];
+} __wut_lock_block;
 
-int
-__wut_lock_init(int *lock,
-                int recursive)
+/*
+ * The first block is static so locks created before the heap is usable, or
+ * torn down after it, never depend on it. Further blocks are allocated from
+ * the default heap on demand and kept for the lifetime of the process.
+ */
+static __wut_lock_block sLibcLockBlock0;
+static __wut_lock_block *volatile sLibcLockBlocks[MAX_LOCK_BLOCKS] = { &sLibcLockBlock0 };
+static volatile uint32_t sLibcLockBlockCount = 1;
+
+static volatile int32_t sLibcLocksInUse    = 0;
+static volatile int32_t sLibcLockContended = 0;
+static volatile int32_t sLibcLockBlocked   = 0;
+
+static inline __wut_lock *
+__wut_get_lock(int *lock)
 {
-   if (!lock) {
-      return -1;
+   __wut_lock_block *block;
+
+   if (!lock || *lock < 0 || *lock >= MAX_LOCKS) {
+      return NULL;
+   }
+
+   block = sLibcLockBlocks[*lock / LOCKS_PER_BLOCK];
+   if (!block) {
+      return NULL;
    }
 
+   return &block->locks[*lock % LOCKS_PER_BLOCK];
+}
+
+static int
+__wut_lock_alloc_slot(__wut_lock_block *block)
+{
    int slot;
    uint32_t new_mask;
-   uint32_t cur_mask = sLibcLockUsedMask;
+   uint32_t cur_mask = block->usedMask;
    do {
       slot = __builtin_ffs(~cur_mask) - 1;
-      if (slot < 0 || slot >= MAX_LOCKS) break;
+      if (slot < 0 || slot >= LOCKS_PER_BLOCK) {
+         return -1;
+      }
       new_mask = cur_mask | (1U << slot);
-   } while (!OSCompareAndSwapAtomicEx(&sLibcLockUsedMask, cur_mask, new_mask, &cur_mask));
+   } while (!OSCompareAndSwapAtomicEx(&block->usedMask, cur_mask, new_mask, &cur_mask));
 
-   if (slot < 0 || slot >= MAX_LOCKS) {
+   return slot;
+}
+
+static uint32_t
+__wut_lock_add_block(uint32_t index)
+{
+   __wut_lock_block *block;
+
+   block = (__wut_lock_block *)MEMAllocFromDefaultHeapEx(sizeof(__wut_lock_block), 4);
+   if (!block) {
+      return 0;
+   }
+
+   memset(block, 0, sizeof(__wut_lock_block));
+   if (!OSCompareAndSwapAtomic((volatile uint32_t *)&sLibcLockBlocks[index], 0, (uint32_t)block)) {
+      // Another thread added this block first
+      MEMFreeToDefaultHeap(block);
+   }
+
+   OSCompareAndSwapAtomic(&sLibcLockBlockCount, index, index + 1);
+   return 1;
+}
+
+int
+__wut_lock_init(int *lock,
+                int recursive)
+{
+   uint32_t i;
+   int slot;
+
+   if (!lock) {
       return -1;
    }
 
-   *lock = slot;
-   OSInitMutex(&sLibcLocks[*lock]);
-   return 0;
+   for (i = 0; i < MAX_LOCK_BLOCKS; ++i) {
+      if (i >= sLibcLockBlockCount && !__wut_lock_add_block(i)) {
+         return -1;
+      }
+
+      slot = __wut_lock_alloc_slot(sLibcLockBlocks[i]);
+      if (slot >= 0) {
+         __wut_lock *l = &sLibcLockBlocks[i]->locks[slot];
+         OSFastMutex_Init(&l->mutex, NULL);
+         l->owner     = NULL;
+         l->count     = 0;
+         l->recursive = recursive ? 1 : 0;
+
+         OSAddAtomic(&sLibcLocksInUse, 1);
+         *lock = (int)(i * LOCKS_PER_BLOCK + slot);
+         return 0;
+      }
+   }
+
+   return -1;
 }
 
 int
 __wut_lock_close(int *lock)
 {
-   if (!__wut_is_lock_valid(lock)) {
+   __wut_lock_block *block;
+   uint32_t bit, new_mask, cur_mask;
+
+   if (!__wut_get_lock(lock)) {
       return -1;
    }
 
-   uint32_t new_mask;
-   uint32_t cur_mask = sLibcLockUsedMask;
+   block = sLibcLockBlocks[*lock / LOCKS_PER_BLOCK];
+   bit   = 1U << (*lock % LOCKS_PER_BLOCK);
+
+   cur_mask = block->usedMask;
    do {
-      new_mask = cur_mask & ~(1U << *lock);
-   } while (!OSCompareAndSwapAtomicEx(&sLibcLockUsedMask, cur_mask, new_mask, &cur_mask));
+      new_mask = cur_mask & ~bit;
+   } while (!OSCompareAndSwapAtomicEx(&block->usedMask, cur_mask, new_mask, &cur_mask));
+
+   if (cur_mask & bit) {
+      OSAddAtomic(&sLibcLocksInUse, -1);
+   }
 
    *lock = -1;
    return 0;
@@ -60,21 +155,70 @@ __wut_lock_close(int *lock)
 int
 __wut_lock_acquire(int *lock)
 {
-   if (!__wut_is_lock_valid(lock)) {
+   __wut_lock *l = __wut_get_lock(lock);
+   OSThread *self;
+   uint32_t spin;
+
+   if (!l) {
       return -1;
    }
 
-   OSLockMutex(&sLibcLocks[*lock]);
+   self = OSGetCurrentThread();
+   if (l->recursive && l->owner == self) {
+      l->count++;
+      return 0;
+   }
+
+   if (!OSFastMutex_TryLock(&l->mutex)) {
+      OSAddAtomic(&sLibcLockContended, 1);
+
+      // Short critical sections are usually released by another core
+      // before it is worth going to sleep on the mutex queue.
+      for (spin = 0; spin < LOCK_SPIN_COUNT; ++spin) {
+         if (OSFastMutex_TryLock(&l->mutex)) {
+            break;
+         }
+      }
+
+      if (spin == LOCK_SPIN_COUNT) {
+         OSAddAtomic(&sLibcLockBlocked, 1);
+         OSFastMutex_Lock(&l->mutex);
+      }
+   }
+
+   l->owner = self;
+   l->count = 1;
    return 0;
 }
 
 int
 __wut_lock_release(int *lock)
 {
-   if (!__wut_is_lock_valid(lock)) {
+   __wut_lock *l = __wut_get_lock(lock);
+
+   if (!l) {
       return -1;
    }
 
-   OSUnlockMutex(&sLibcLocks[*lock]);
+   if (l->recursive && --l->count) {
+      return 0;
+   }
+
+   l->owner = NULL;
+   l->count = 0;
+   OSFastMutex_Unlock(&l->mutex);
    return 0;
 }
+
+void
+WUTGetLibcLockStats(WUTLibcLockStats *stats)
+{
+   if (!stats) {
+      return;
+   }
+
+   stats->locksInUse     = (uint32_t)sLibcLocksInUse;
+   stats->locksAllocated = sLibcLockBlockCount * LOCKS_PER_BLOCK;
+   stats->contended      = (uint32_t)sLibcLockContended;
+   stats->blocked        = (uint32_t)sLibcLockBlocked;
+}
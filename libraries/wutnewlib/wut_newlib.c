@@ -195,4 +195,5 @@ void
 __fini_wut_newlib()
 {
    __fini_wut_sbrk_heap();
+   __fini_wut_heap_layout();
 }
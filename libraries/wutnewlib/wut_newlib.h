@@ -6,6 +6,8 @@
 #include <sys/reent.h>
 #include <sys/time.h>
 
+#include <coreinit/memheap.h>
+
 void *
 __wut_sbrk_r(struct _reent *r, ptrdiff_t incr);
 int
@@ -32,8 +34,14 @@ int
 __wut_nanosleep(const struct timespec *req, struct timespec *rem);
 struct _reent *
 __wut_getreent(void);
+void *
+__wut_get_staging_buffer(size_t size);
 
+void
+__init_wut_sbrk_heap_ex(MEMHeapHandle heapHandle, uint32_t initialSize, uint32_t maxSize);
 void
 __fini_wut_sbrk_heap();
+void
+__fini_wut_heap_layout();
 
 #endif // ifndef __WUT_NEWLIB_H
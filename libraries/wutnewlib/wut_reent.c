@@ -1,15 +1,19 @@
 #include "wut_newlib.h"
 #include "wut_thread_specific.h"
+#include <malloc.h>
 #include <stdlib.h>
 
 #include <coreinit/thread.h>
 
 #define __WUT_CONTEXT_THREAD_SPECIFIC_ID WUT_THREAD_SPECIFIC_1
+#define __WUT_STAGING_ALIGN              (0x40)
 
 struct __wut_thread_context
 {
    struct _reent reent;
    OSThreadCleanupCallbackFn savedCleanup;
+   void *stagingBuffer;
+   size_t stagingSize;
 };
 
 static void
@@ -28,6 +32,7 @@ __wut_thread_cleanup(OSThread *thread,
    }
 
    _reclaim_reent(&context->reent);
+   free(context->stagingBuffer);
 
    // Use global reent during free since the current reent is getting freed
    wut_set_thread_specific(__WUT_CONTEXT_THREAD_SPECIFIC_ID, _GLOBAL_REENT);
@@ -54,6 +59,8 @@ __wut_getreent(void)
       }
 
       _REENT_INIT_PTR(&context->reent);
+      context->stagingBuffer = NULL;
+      context->stagingSize   = 0;
       context->savedCleanup = OSSetThreadCleanupCallback(OSGetCurrentThread(), &__wut_thread_cleanup);
 
       wut_set_thread_specific(__WUT_CONTEXT_THREAD_SPECIFIC_ID, context);
@@ -61,3 +68,32 @@ __wut_getreent(void)
 
    return &context->reent;
 }
+
+void *
+__wut_get_staging_buffer(size_t size)
+{
+   struct __wut_thread_context *context;
+
+   if (!__wut_getreent()) {
+      return NULL;
+   }
+
+   context = (struct __wut_thread_context *)wut_get_thread_specific(__WUT_CONTEXT_THREAD_SPECIFIC_ID);
+   if (&context->reent == _GLOBAL_REENT) {
+      return NULL;
+   }
+
+   if (context->stagingSize < size) {
+      // Round up so slowly growing messages do not reallocate every call
+      size = (size + 0xFFF) & ~0xFFF;
+      free(context->stagingBuffer);
+      context->stagingSize   = 0;
+      context->stagingBuffer = memalign(__WUT_STAGING_ALIGN, size);
+      if (!context->stagingBuffer) {
+         return NULL;
+      }
+      context->stagingSize = size;
+   }
+
+   return context->stagingBuffer;
+}
@@ -1,14 +1,46 @@
 #include "wut_newlib.h"
+#include <wut_heap.h>
 
 #include <coreinit/atomic.h>
 #include <coreinit/memdefaultheap.h>
 #include <coreinit/memexpheap.h>
 #include <coreinit/memheap.h>
+#include <coreinit/spinlock.h>
 
-static MEMHeapHandle sHeapHandle   = NULL;
-static void *sHeapBase             = NULL;
-static uint32_t sHeapMaxSize       = 0;
-static volatile uint32_t sHeapSize = 0;
+#define __WUT_SBRK_GROW_ALIGN (64 * 1024)
+
+static MEMHeapHandle sHeapHandle        = NULL;
+static void *sHeapBase                  = NULL;
+static uint32_t sHeapMaxSize            = 0;
+static volatile uint32_t sHeapSize      = 0;
+static volatile uint32_t sHeapBlockSize = 0;
+static OSSpinLock sHeapGrowLock;
+
+static int
+__wut_sbrk_grow(uint32_t size)
+{
+   uint32_t blockSize;
+
+   OSUninterruptibleSpinLock_Acquire(&sHeapGrowLock);
+   blockSize = sHeapBlockSize;
+
+   if (size > blockSize) {
+      // Try to extend the block in place, the memory following it in the
+      // parent heap must still be free for this to succeed.
+      uint32_t newSize = (size + __WUT_SBRK_GROW_ALIGN - 1) & ~(__WUT_SBRK_GROW_ALIGN - 1);
+      if (newSize > sHeapMaxSize) {
+         newSize = sHeapMaxSize;
+      }
+
+      blockSize = MEMResizeForMBlockExpHeap(sHeapHandle, sHeapBase, newSize);
+      if (blockSize >= size) {
+         sHeapBlockSize = blockSize;
+      }
+   }
+
+   OSUninterruptibleSpinLock_Release(&sHeapGrowLock);
+   return blockSize >= size;
+}
 
 void *
 __wut_sbrk_r(struct _reent *r,
@@ -20,7 +52,8 @@ __wut_sbrk_r(struct _reent *r,
    do {
       newSize = oldSize + incr;
 
-      if (newSize > sHeapMaxSize) {
+      if (newSize > sHeapMaxSize ||
+          (newSize > sHeapBlockSize && !__wut_sbrk_grow(newSize))) {
          r->_errno = ENOMEM;
          return (void *)-1;
       }
@@ -30,20 +63,41 @@ __wut_sbrk_r(struct _reent *r,
 }
 
 void
-__init_wut_sbrk_heap(MEMHeapHandle heapHandle)
+__init_wut_sbrk_heap_ex(MEMHeapHandle heapHandle,
+                        uint32_t initialSize,
+                        uint32_t maxSize)
 {
    if (sHeapBase) {
       // Already initialised
       return;
    }
 
-   sHeapHandle  = heapHandle;
+   sHeapHandle = heapHandle;
+   OSInitSpinLock(&sHeapGrowLock);
 
-   // Use all of the available memory for the custom heap
-   sHeapMaxSize = MEMGetAllocatableSizeForExpHeapEx(sHeapHandle, 4);
-   sHeapBase    = MEMAllocFromExpHeapEx(sHeapHandle, sHeapMaxSize, 4);
+   if (!maxSize || maxSize > MEMGetAllocatableSizeForExpHeapEx(sHeapHandle, 4)) {
+      maxSize = MEMGetAllocatableSizeForExpHeapEx(sHeapHandle, 4);
+   }
+
+   if (!initialSize || initialSize > maxSize) {
+      initialSize = maxSize;
+   }
+
+   sHeapBase = MEMAllocFromExpHeapEx(sHeapHandle, initialSize, 4);
+   if (!sHeapBase) {
+      return;
+   }
 
-   sHeapSize    = 0;
+   sHeapBlockSize = initialSize;
+   sHeapMaxSize   = maxSize;
+   sHeapSize      = 0;
+}
+
+void
+__init_wut_sbrk_heap(MEMHeapHandle heapHandle)
+{
+   // Use all of the available memory for the custom heap
+   __init_wut_sbrk_heap_ex(heapHandle, 0, 0);
 }
 
 void
@@ -58,7 +112,20 @@ __fini_wut_sbrk_heap()
       MEMFreeToExpHeap(sHeapHandle, sHeapBase);
    }
 
-   sHeapBase    = NULL;
-   sHeapSize    = 0;
-   sHeapMaxSize = 0;
+   sHeapBase      = NULL;
+   sHeapSize      = 0;
+   sHeapBlockSize = 0;
+   sHeapMaxSize   = 0;
+}
+
+uint32_t
+WUTGetMallocHeapSize(void)
+{
+   return sHeapBlockSize;
+}
+
+uint32_t
+WUTGetMallocHeapMaxSize(void)
+{
+   return sHeapMaxSize;
 }
@@ -0,0 +1,664 @@
+#include <wut_sched.h>
+#include <wut_pool.h>
+#include <wut_thread.h>
+
+#include <coreinit/atomic.h>
+#include <coreinit/condition.h>
+#include <coreinit/mutex.h>
+#include <coreinit/spinlock.h>
+#include <coreinit/thread.h>
+#include <string.h>
+
+#define __WUT_SCHED_MAX_WORKERS     (3)
+#define __WUT_SCHED_DEQUE_SIZE      (1024)
+#define __WUT_SCHED_TASKS_PER_CHUNK (128)
+#define __WUT_SCHED_SPLITS_PER_CORE (8)
+
+#define __WUT_SCHED_STOPPED  (0)
+#define __WUT_SCHED_STARTING (1)
+#define __WUT_SCHED_RUNNING  (2)
+
+// Marks the successor list of a task which has finished running
+#define __WUT_TASK_DONE ((WUTTaskLink *)1)
+
+typedef struct WUTTaskLink WUTTaskLink;
+typedef struct __wut_parallel_for __wut_parallel_for;
+
+struct WUTTaskLink
+{
+   WUTTaskLink *next;
+   WUTTask *task;
+};
+
+struct WUTTask
+{
+   WUTTaskFn function;
+   void *arg;
+
+   //! Next task in the shared queue.
+   WUTTask *next;
+
+   //! Unfinished dependencies, plus one until the task is submitted.
+   volatile int32_t pending;
+
+   //! One for the caller, one for the scheduler while submitted.
+   volatile int32_t refs;
+
+   //! Number of threads inside WUTWaitTask.
+   volatile int32_t waiters;
+
+   //! Tasks depending on this one, __WUT_TASK_DONE once finished.
+   WUTTaskLink *volatile successors;
+
+   //! Range for tasks created by WUTParallelFor.
+   __wut_parallel_for *parallelFor;
+   uint32_t begin;
+   uint32_t end;
+};
+
+struct __wut_parallel_for
+{
+   WUTParallelForFn function;
+   void *arg;
+   uint32_t grain;
+
+   //! Ranges not yet processed.
+   volatile int32_t pending;
+};
+
+/*
+ * Chase-Lev deque. Only the owning worker pushes and pops at the bottom,
+ * any thread may steal from the top.
+ */
+typedef struct
+{
+   volatile uint32_t top;
+   volatile uint32_t bottom;
+   WUTTask *volatile tasks[__WUT_SCHED_DEQUE_SIZE];
+} __wut_sched_deque;
+
+typedef struct __attribute__((aligned(0x40)))
+{
+   __wut_sched_deque deque;
+   OSThread *thread;
+} __wut_sched_worker;
+
+static __wut_sched_worker sWorkers[__WUT_SCHED_MAX_WORKERS];
+static uint32_t sWorkerCount       = 0;
+static volatile uint32_t sState    = __WUT_SCHED_STOPPED;
+static volatile uint32_t sStopping = 0;
+
+static WUTPool sTaskPool;
+static WUTPool sLinkPool;
+
+// Tasks submitted by threads which are not workers
+static OSSpinLock sSharedLock;
+static WUTTask *sSharedHead = NULL;
+static WUTTask *sSharedTail = NULL;
+
+// Idle threads sleep on sIdleCond until sWorkVersion changes
+static OSMutex sIdleMutex;
+static OSCondition sIdleCond;
+static volatile int32_t sIdleCount    = 0;
+static volatile uint32_t sWorkVersion = 0;
+
+static const OSThreadAttributes sWorkerAffinity[__WUT_SCHED_MAX_WORKERS] = {
+   OS_THREAD_ATTRIB_AFFINITY_CPU0,
+   OS_THREAD_ATTRIB_AFFINITY_CPU1,
+   OS_THREAD_ATTRIB_AFFINITY_CPU2,
+};
+
+static const char *sWorkerNames[__WUT_SCHED_MAX_WORKERS] = {
+   "wut scheduler worker 0",
+   "wut scheduler worker 1",
+   "wut scheduler worker 2",
+};
+
+static BOOL
+__wut_deque_push(__wut_sched_deque *deque,
+                 WUTTask *task)
+{
+   uint32_t bottom = deque->bottom;
+   uint32_t top    = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+
+   if (bottom - top >= __WUT_SCHED_DEQUE_SIZE) {
+      return FALSE;
+   }
+
+   deque->tasks[bottom % __WUT_SCHED_DEQUE_SIZE] = task;
+   __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+   return TRUE;
+}
+
+static WUTTask *
+__wut_deque_pop(__wut_sched_deque *deque)
+{
+   uint32_t bottom = deque->bottom - 1;
+   uint32_t top;
+   WUTTask *task;
+
+   __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   top = deque->top;
+
+   if ((int32_t)(bottom - top) < 0) {
+      // Empty
+      deque->bottom = top;
+      return NULL;
+   }
+
+   task = deque->tasks[bottom % __WUT_SCHED_DEQUE_SIZE];
+   if (bottom == top) {
+      // Last task, race against thieves for it
+      if (!OSCompareAndSwapAtomic(&deque->top, top, top + 1)) {
+         task = NULL;
+      }
+      deque->bottom = top + 1;
+   }
+
+   return task;
+}
+
+static WUTTask *
+__wut_deque_steal(__wut_sched_deque *deque)
+{
+   uint32_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+   uint32_t bottom;
+   WUTTask *task;
+
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+   if ((int32_t)(bottom - top) <= 0) {
+      return NULL;
+   }
+
+   task = deque->tasks[top % __WUT_SCHED_DEQUE_SIZE];
+   if (!OSCompareAndSwapAtomic(&deque->top, top, top + 1)) {
+      return NULL;
+   }
+
+   return task;
+}
+
+static __wut_sched_worker *
+__wut_sched_current_worker(void)
+{
+   OSThread *self = OSGetCurrentThread();
+   uint32_t i;
+
+   for (i = 0; i < sWorkerCount; ++i) {
+      if (sWorkers[i].thread == self) {
+         return &sWorkers[i];
+      }
+   }
+
+   return NULL;
+}
+
+/*
+ * Wake sleeping threads, either because there is new work or because
+ * something they are waiting for has finished.
+ */
+static void
+__wut_sched_wake(void)
+{
+   OSAddAtomic((volatile int32_t *)&sWorkVersion, 1);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+   if (sIdleCount > 0) {
+      OSLockMutex(&sIdleMutex);
+      OSSignalCond(&sIdleCond);
+      OSUnlockMutex(&sIdleMutex);
+   }
+}
+
+/*
+ * Sleep until __wut_sched_wake is called, unless it already was since
+ * version was read or counter has reached zero.
+ */
+static void
+__wut_sched_sleep(uint32_t version,
+                  volatile int32_t *counter)
+{
+   OSLockMutex(&sIdleMutex);
+   OSAddAtomic(&sIdleCount, 1);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+   if (sWorkVersion == version && !sStopping && (!counter || *counter > 0)) {
+      OSWaitCond(&sIdleCond, &sIdleMutex);
+   }
+
+   OSAddAtomic(&sIdleCount, -1);
+   OSUnlockMutex(&sIdleMutex);
+}
+
+static void
+__wut_sched_push(WUTTask *task)
+{
+   __wut_sched_worker *worker = __wut_sched_current_worker();
+
+   if (!worker || !__wut_deque_push(&worker->deque, task)) {
+      task->next = NULL;
+
+      OSUninterruptibleSpinLock_Acquire(&sSharedLock);
+      if (sSharedTail) {
+         sSharedTail->next = task;
+      } else {
+         sSharedHead = task;
+      }
+      sSharedTail = task;
+      OSUninterruptibleSpinLock_Release(&sSharedLock);
+   }
+
+   __wut_sched_wake();
+}
+
+static WUTTask *
+__wut_sched_pop_shared(void)
+{
+   WUTTask *task;
+
+   if (!sSharedHead) {
+      return NULL;
+   }
+
+   OSUninterruptibleSpinLock_Acquire(&sSharedLock);
+   task = sSharedHead;
+   if (task) {
+      sSharedHead = task->next;
+      if (!sSharedHead) {
+         sSharedTail = NULL;
+      }
+   }
+   OSUninterruptibleSpinLock_Release(&sSharedLock);
+   return task;
+}
+
+/*
+ * Find a ready task: our own deque first, then the shared queue, then steal
+ * from the other workers.
+ */
+static WUTTask *
+__wut_sched_find_task(__wut_sched_worker *worker)
+{
+   uint32_t i, start = 0;
+   WUTTask *task;
+
+   if (worker) {
+      task = __wut_deque_pop(&worker->deque);
+      if (task) {
+         return task;
+      }
+
+      start = (uint32_t)(worker - sWorkers) + 1;
+   }
+
+   task = __wut_sched_pop_shared();
+   if (task) {
+      return task;
+   }
+
+   for (i = 0; i < sWorkerCount; ++i) {
+      __wut_sched_worker *victim = &sWorkers[(start + i) % sWorkerCount];
+      if (victim == worker) {
+         continue;
+      }
+
+      task = __wut_deque_steal(&victim->deque);
+      if (task) {
+         return task;
+      }
+   }
+
+   return NULL;
+}
+
+static void
+__wut_task_free(WUTTask *task)
+{
+   WUTTaskLink *link = task->successors;
+
+   // Links of a task that never ran
+   while (link && link != __WUT_TASK_DONE) {
+      WUTTaskLink *next = link->next;
+      WUTFreeToPool(&sLinkPool, link);
+      link = next;
+   }
+
+   WUTFreeToPool(&sTaskPool, task);
+}
+
+static void
+__wut_task_release(WUTTask *task)
+{
+   if (OSAddAtomic(&task->refs, -1) == 1) {
+      __wut_task_free(task);
+   }
+}
+
+static void
+__wut_task_run(WUTTask *task)
+{
+   WUTTaskLink *link;
+
+   task->function(task->arg);
+
+   // Close the successor list, dependencies added from now on see the task
+   // as finished.
+   link = (WUTTaskLink *)OSSwapAtomic((volatile uint32_t *)&task->successors,
+                                      (uint32_t)__WUT_TASK_DONE);
+
+   // Pairs with the fence in WUTWaitTask, either the waiter sees the task
+   // as done or we see the waiter and wake it.
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+   while (link) {
+      WUTTaskLink *next = link->next;
+      if (OSAddAtomic(&link->task->pending, -1) == 1) {
+         __wut_sched_push(link->task);
+      }
+
+      WUTFreeToPool(&sLinkPool, link);
+      link = next;
+   }
+
+   if (task->waiters) {
+      __wut_sched_wake();
+   }
+
+   __wut_task_release(task);
+}
+
+static void *
+__wut_sched_worker_main(void *arg)
+{
+   __wut_sched_worker *worker = (__wut_sched_worker *)arg;
+
+   while (!sStopping) {
+      uint32_t version = sWorkVersion;
+      WUTTask *task    = __wut_sched_find_task(worker);
+
+      if (task) {
+         __wut_task_run(task);
+      } else {
+         __wut_sched_sleep(version, NULL);
+      }
+   }
+
+   return NULL;
+}
+
+/*
+ * Run ready tasks until counter reaches zero, sleeping while there is
+ * nothing to run.
+ */
+static void
+__wut_sched_help_until_zero(volatile int32_t *counter)
+{
+   __wut_sched_worker *worker = __wut_sched_current_worker();
+
+   while (*counter > 0) {
+      uint32_t version = sWorkVersion;
+      WUTTask *task    = __wut_sched_find_task(worker);
+
+      if (task) {
+         __wut_task_run(task);
+      } else {
+         __wut_sched_sleep(version, counter);
+      }
+   }
+}
+
+BOOL
+WUTInitScheduler(void)
+{
+   uint32_t i;
+
+   // Only one thread starts the workers, others wait for it to finish
+   while (sState != __WUT_SCHED_RUNNING) {
+      if (OSCompareAndSwapAtomic(&sState, __WUT_SCHED_STOPPED, __WUT_SCHED_STARTING)) {
+         break;
+      }
+
+      OSYieldThread();
+   }
+
+   if (sState == __WUT_SCHED_RUNNING) {
+      return TRUE;
+   }
+
+   if (!sTaskPool.objectSize) {
+      WUTInitPool(&sTaskPool, sizeof(WUTTask), 4, __WUT_SCHED_TASKS_PER_CHUNK, 0);
+      WUTInitPool(&sLinkPool, sizeof(WUTTaskLink), 4, __WUT_SCHED_TASKS_PER_CHUNK, 0);
+      OSInitMutexEx(&sIdleMutex, "wut scheduler");
+      OSInitCondEx(&sIdleCond, "wut scheduler");
+   }
+
+   sStopping = 0;
+   memset(sWorkers, 0, sizeof(sWorkers));
+
+   for (i = 0; i < __WUT_SCHED_MAX_WORKERS; ++i) {
+      WUTThreadAttr attr;
+      WUTInitThreadAttr(&attr);
+      attr.affinity = sWorkerAffinity[i];
+      attr.name     = sWorkerNames[i];
+
+      if (WUTCreateThread(&sWorkers[i].thread, &attr, __wut_sched_worker_main, &sWorkers[i]) != 0) {
+         break;
+      }
+   }
+
+   sWorkerCount = i;
+   if (!sWorkerCount) {
+      sState = __WUT_SCHED_STOPPED;
+      return FALSE;
+   }
+
+   sState = __WUT_SCHED_RUNNING;
+   return TRUE;
+}
+
+void
+WUTShutdownScheduler(void)
+{
+   uint32_t i;
+
+   if (!OSCompareAndSwapAtomic(&sState, __WUT_SCHED_RUNNING, __WUT_SCHED_STARTING)) {
+      return;
+   }
+
+   sStopping = 1;
+   __wut_sched_wake();
+
+   for (i = 0; i < sWorkerCount; ++i) {
+      OSJoinThread(sWorkers[i].thread, NULL);
+   }
+
+   sWorkerCount = 0;
+   sState       = __WUT_SCHED_STOPPED;
+}
+
+int32_t
+WUTGetCurrentWorker(void)
+{
+   __wut_sched_worker *worker = __wut_sched_current_worker();
+   return worker ? (int32_t)(worker - sWorkers) : -1;
+}
+
+WUTTask *
+WUTCreateTask(WUTTaskFn function,
+              void *arg)
+{
+   WUTTask *task;
+
+   if (!WUTInitScheduler()) {
+      return NULL;
+   }
+
+   task = (WUTTask *)WUTAllocFromPool(&sTaskPool);
+   if (!task) {
+      return NULL;
+   }
+
+   memset(task, 0, sizeof(WUTTask));
+   task->function = function;
+   task->arg      = arg;
+   task->pending  = 1;
+   task->refs     = 1;
+   return task;
+}
+
+BOOL
+WUTAddTaskDependency(WUTTask *task,
+                     WUTTask *dependency)
+{
+   WUTTaskLink *link = (WUTTaskLink *)WUTAllocFromPool(&sLinkPool);
+   WUTTaskLink *head;
+
+   if (!link) {
+      return FALSE;
+   }
+
+   link->task = task;
+   OSAddAtomic(&task->pending, 1);
+
+   head = dependency->successors;
+   while (head != __WUT_TASK_DONE) {
+      link->next = head;
+      if (OSCompareAndSwapAtomicEx((volatile uint32_t *)&dependency->successors,
+                                   (uint32_t)head, (uint32_t)link, (uint32_t *)&head)) {
+         return TRUE;
+      }
+   }
+
+   // Dependency has already finished
+   OSAddAtomic(&task->pending, -1);
+   WUTFreeToPool(&sLinkPool, link);
+   return TRUE;
+}
+
+void
+WUTSubmitTask(WUTTask *task)
+{
+   OSAddAtomic(&task->refs, 1);
+
+   if (OSAddAtomic(&task->pending, -1) == 1) {
+      __wut_sched_push(task);
+   }
+}
+
+BOOL
+WUTIsTaskDone(WUTTask *task)
+{
+   return task->successors == __WUT_TASK_DONE;
+}
+
+void
+WUTWaitTask(WUTTask *task)
+{
+   OSAddAtomic(&task->waiters, 1);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+   while (task->successors != __WUT_TASK_DONE) {
+      // Read the version before checking the task again, so a wake after
+      // the check is never missed by the sleep
+      uint32_t version = __atomic_load_n(&sWorkVersion, __ATOMIC_ACQUIRE);
+      WUTTask *next    = __wut_sched_find_task(__wut_sched_current_worker());
+
+      if (next) {
+         __wut_task_run(next);
+      } else if (task->successors != __WUT_TASK_DONE) {
+         __wut_sched_sleep(version, NULL);
+      }
+   }
+
+   OSAddAtomic(&task->waiters, -1);
+}
+
+void
+WUTReleaseTask(WUTTask *task)
+{
+   if (task) {
+      __wut_task_release(task);
+   }
+}
+
+static void __wut_parallel_for_task(void *arg);
+
+/*
+ * Process [begin, end), handing the upper halves to other workers until the
+ * range is no bigger than the grain.
+ */
+static void
+__wut_parallel_for_range(__wut_parallel_for *ctx,
+                         uint32_t begin,
+                         uint32_t end)
+{
+   while (end - begin > ctx->grain) {
+      uint32_t mid  = begin + (end - begin) / 2;
+      WUTTask *task = (WUTTask *)WUTAllocFromPool(&sTaskPool);
+      if (!task) {
+         break;
+      }
+
+      memset(task, 0, sizeof(WUTTask));
+      task->function    = __wut_parallel_for_task;
+      task->arg         = task;
+      task->refs        = 1;
+      task->parallelFor = ctx;
+      task->begin       = mid;
+      task->end         = end;
+
+      OSAddAtomic(&ctx->pending, 1);
+      __wut_sched_push(task);
+      end = mid;
+   }
+
+   ctx->function(begin, end, ctx->arg);
+
+   if (OSAddAtomic(&ctx->pending, -1) == 1) {
+      __wut_sched_wake();
+   }
+}
+
+static void
+__wut_parallel_for_task(void *arg)
+{
+   WUTTask *task = (WUTTask *)arg;
+   __wut_parallel_for_range(task->parallelFor, task->begin, task->end);
+}
+
+void
+WUTParallelFor(uint32_t begin,
+               uint32_t end,
+               uint32_t grain,
+               WUTParallelForFn function,
+               void *arg)
+{
+   __wut_parallel_for ctx;
+
+   if (end <= begin) {
+      return;
+   }
+
+   if (!grain) {
+      grain = (end - begin) / (__WUT_SCHED_MAX_WORKERS * __WUT_SCHED_SPLITS_PER_CORE);
+      if (!grain) {
+         grain = 1;
+      }
+   }
+
+   if (end - begin <= grain || !WUTInitScheduler()) {
+      function(begin, end, arg);
+      return;
+   }
+
+   ctx.function = function;
+   ctx.arg      = arg;
+   ctx.grain    = grain;
+   ctx.pending  = 1;
+
+   __wut_parallel_for_range(&ctx, begin, end);
+   __wut_sched_help_until_zero(&ctx.pending);
+}
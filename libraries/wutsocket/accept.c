@@ -5,6 +5,7 @@ accept(int sockfd,
        struct sockaddr *address,
        socklen_t *addrlen)
 {
+   OSTime start;
    int rc, fd, dev;
 
    fd = __wut_get_nsysnet_fd(sockfd);
@@ -20,12 +21,18 @@ accept(int sockfd,
       return -1;
    }
 
-   rc = RPLWRAP(accept)(sockfd, address, addrlen);
+   start = __wut_socket_stats_start();
+   rc    = RPLWRAP(accept)(sockfd, address, addrlen);
    if (rc == -1) {
       __release_handle(fd);
-      return __wut_get_nsysnet_result(NULL, rc);
+      rc = __wut_get_nsysnet_result(NULL, rc);
+      __wut_set_nsysnet_blocked(sockfd, rc, errno, FALSE);
+      __wut_socket_stats_record(WUT_SOCKET_CALL_ACCEPT, sockfd, start, rc, errno);
+      return rc;
    }
 
-   *(int *)__get_handle(fd)->fileStruct = rc;
+   __wut_socket_stats_record(WUT_SOCKET_CALL_ACCEPT, sockfd, start, rc, 0);
+
+   __wut_register_nsysnet_fd(fd, rc);
    return fd;
 }
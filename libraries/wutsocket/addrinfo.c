@@ -1,6 +1,7 @@
 #include "wut_socket.h"
 #include <netdb.h>
 #include <nsysnet/_netdb.h>
+#include <stdlib.h>
 
 int
 getaddrinfo(const char *node,
@@ -19,7 +20,7 @@ getaddrinfo(const char *node,
       return EAI_SYSTEM;
    }
 
-   rc = RPLWRAP(getaddrinfo)(node, service, hints, res);
+   rc = __wut_dns_getaddrinfo(node, service, hints, res);
 
    return rc;
 }
@@ -27,7 +28,8 @@ getaddrinfo(const char *node,
 void
 freeaddrinfo(struct addrinfo *res)
 {
-   RPLWRAP(freeaddrinfo)(res);
+   // Results are copied into a single allocation by the resolver cache
+   free(res);
 }
 
 int
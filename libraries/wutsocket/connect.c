@@ -5,11 +5,15 @@ connect(int sockfd,
         const struct sockaddr *addr,
         socklen_t addrlen)
 {
+   OSTime start;
    int rc;
    sockfd = __wut_get_nsysnet_fd(sockfd);
    if (sockfd == -1) {
       return -1;
    }
-   rc = RPLWRAP(connect)(sockfd, addr, addrlen);
-   return __wut_get_nsysnet_result(NULL, rc);
+   start = __wut_socket_stats_start();
+   rc    = RPLWRAP(connect)(sockfd, addr, addrlen);
+   rc    = __wut_get_nsysnet_result(NULL, rc);
+   __wut_socket_stats_record(WUT_SOCKET_CALL_CONNECT, sockfd, start, rc, errno);
+   return rc;
 }
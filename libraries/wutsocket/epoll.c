@@ -0,0 +1,401 @@
+#include "wut_socket.h"
+#include <coreinit/mutex.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+
+#define EPOLL_SELECT_EVENTS (EPOLLIN | EPOLLOUT | EPOLLPRI)
+
+typedef struct
+{
+   //! Newlib fd the socket was registered with.
+   int fd;
+   uint32_t events;
+   epoll_data_t data;
+
+   //! Socket generation when registered, a mismatch means it was closed.
+   uint32_t generation;
+
+   //! Edge triggered events reported and not yet re-armed.
+   uint32_t latched;
+   uint32_t readBlocked;
+   uint32_t writeBlocked;
+} __wut_epoll_item;
+
+/*
+ * The interest set is kept as the three select masks, so a wait only copies
+ * them instead of rebuilding them from a list of descriptors. Ready sockets
+ * which did not fit in the caller's buffer stay in the pending masks and are
+ * reported by the next wait without calling select.
+ */
+typedef struct
+{
+   OSMutex mutex;
+   uint32_t registered;
+   nsysnet_fd_set readSet;
+   nsysnet_fd_set writeSet;
+   nsysnet_fd_set exceptSet;
+   nsysnet_fd_set readPending;
+   nsysnet_fd_set writePending;
+   nsysnet_fd_set exceptPending;
+   __wut_epoll_item items[NSYSNET_FD_SETSIZE];
+} __wut_epoll;
+
+static int
+__wut_epoll_close(struct _reent *r,
+                  void *fd)
+{
+   free(*(__wut_epoll **)fd);
+   return 0;
+}
+
+static devoptab_t __wut_epoll_devoptab = {
+   .name       = "epoll",
+   .structSize = sizeof(__wut_epoll *),
+   .open_r     = __wut_socket_open,
+   .close_r    = __wut_epoll_close,
+};
+
+void
+__wut_epoll_init_devoptab()
+{
+   AddDevice(&__wut_epoll_devoptab);
+}
+
+void
+__wut_epoll_fini_devoptab()
+{
+   RemoveDevice("epoll:");
+}
+
+static __wut_epoll *
+__wut_get_epoll(int epfd)
+{
+   __handle *handle = __get_handle(epfd);
+   if (handle == NULL) {
+      errno = EBADF;
+      return NULL;
+   }
+   if (devoptab_list[handle->device] != &__wut_epoll_devoptab) {
+      errno = EINVAL;
+      return NULL;
+   }
+   return *(__wut_epoll **)handle->fileStruct;
+}
+
+/*
+ * Update the select masks of a socket from its item, called with the mutex
+ * held whenever the item changes.
+ */
+static void
+__wut_epoll_arm(__wut_epoll *ep,
+                int sockfd)
+{
+   __wut_epoll_item *item = &ep->items[sockfd];
+   uint32_t events        = 0;
+
+   NSYSNET_FD_CLR(sockfd, &ep->readSet);
+   NSYSNET_FD_CLR(sockfd, &ep->writeSet);
+   NSYSNET_FD_CLR(sockfd, &ep->exceptSet);
+   NSYSNET_FD_CLR(sockfd, &ep->readPending);
+   NSYSNET_FD_CLR(sockfd, &ep->writePending);
+   NSYSNET_FD_CLR(sockfd, &ep->exceptPending);
+
+   if (ep->registered & (1u << sockfd)) {
+      events = item->events & ~item->latched;
+   }
+
+   if (events & EPOLLIN) {
+      NSYSNET_FD_SET(sockfd, &ep->readSet);
+   }
+   if (events & EPOLLOUT) {
+      NSYSNET_FD_SET(sockfd, &ep->writeSet);
+   }
+   if (events & EPOLLPRI) {
+      NSYSNET_FD_SET(sockfd, &ep->exceptSet);
+   }
+}
+
+/*
+ * Drop sockets closed without EPOLL_CTL_DEL, and re-arm edge triggered
+ * events once the socket has returned EWOULDBLOCK since they were reported.
+ */
+static void
+__wut_epoll_refresh(__wut_epoll *ep)
+{
+   uint32_t remaining = ep->registered;
+
+   while (remaining) {
+      int sockfd                    = __builtin_ctz(remaining);
+      __wut_epoll_item *item        = &ep->items[sockfd];
+      __wut_nsysnet_fd_state *state = &__wut_nsysnet_fd_states[sockfd];
+      uint32_t latched              = item->latched;
+
+      remaining &= ~(1u << sockfd);
+
+      if (item->generation != state->generation) {
+         ep->registered &= ~(1u << sockfd);
+         __wut_epoll_arm(ep, sockfd);
+         continue;
+      }
+
+      if (item->events & EPOLLONESHOT) {
+         continue;
+      }
+
+      if ((latched & EPOLLIN) && item->readBlocked != state->readBlocked) {
+         latched &= ~(EPOLLIN | EPOLLPRI);
+      }
+      if ((latched & EPOLLOUT) && item->writeBlocked != state->writeBlocked) {
+         latched &= ~EPOLLOUT;
+      }
+
+      if (latched != item->latched) {
+         item->latched = latched;
+         __wut_epoll_arm(ep, sockfd);
+      }
+   }
+}
+
+/*
+ * Move ready sockets from the pending masks to the caller's buffer.
+ */
+static int
+__wut_epoll_deliver(__wut_epoll *ep,
+                    struct epoll_event *events,
+                    int maxevents)
+{
+   uint32_t ready = ep->readPending.fds_bits | ep->writePending.fds_bits | ep->exceptPending.fds_bits;
+   int count      = 0;
+
+   while (ready && count < maxevents) {
+      int sockfd             = __builtin_ctz(ready);
+      __wut_epoll_item *item = &ep->items[sockfd];
+      uint32_t revents       = 0;
+
+      ready &= ~(1u << sockfd);
+
+      if (NSYSNET_FD_ISSET(sockfd, &ep->readPending)) {
+         revents |= EPOLLIN;
+      }
+      if (NSYSNET_FD_ISSET(sockfd, &ep->writePending)) {
+         revents |= EPOLLOUT;
+      }
+      if (NSYSNET_FD_ISSET(sockfd, &ep->exceptPending)) {
+         revents |= EPOLLPRI;
+      }
+
+      NSYSNET_FD_CLR(sockfd, &ep->readPending);
+      NSYSNET_FD_CLR(sockfd, &ep->writePending);
+      NSYSNET_FD_CLR(sockfd, &ep->exceptPending);
+
+      revents &= item->events & ~item->latched;
+      if (!revents) {
+         continue;
+      }
+
+      events[count].events = revents;
+      events[count].data   = item->data;
+      count++;
+
+      if (item->events & EPOLLONESHOT) {
+         item->latched |= EPOLL_SELECT_EVENTS;
+         __wut_epoll_arm(ep, sockfd);
+      } else if (item->events & EPOLLET) {
+         if (revents & (EPOLLIN | EPOLLPRI)) {
+            item->readBlocked = __wut_nsysnet_fd_states[sockfd].readBlocked;
+         }
+         if (revents & EPOLLOUT) {
+            item->writeBlocked = __wut_nsysnet_fd_states[sockfd].writeBlocked;
+         }
+         item->latched |= revents;
+         __wut_epoll_arm(ep, sockfd);
+      }
+   }
+
+   return count;
+}
+
+int
+epoll_create(int size)
+{
+   if (size <= 0) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   return epoll_create1(0);
+}
+
+int
+epoll_create1(int flags)
+{
+   __wut_epoll *ep;
+   int fd, dev;
+
+   if (flags & ~EPOLL_CLOEXEC) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   dev = FindDevice("epoll:");
+   if (dev == -1) {
+      errno = ENOSYS;
+      return -1;
+   }
+
+   ep = (__wut_epoll *)calloc(1, sizeof(__wut_epoll));
+   if (!ep) {
+      errno = ENOMEM;
+      return -1;
+   }
+
+   fd = __alloc_handle(dev);
+   if (fd == -1) {
+      free(ep);
+      return -1;
+   }
+
+   OSInitMutex(&ep->mutex);
+   *(__wut_epoll **)__get_handle(fd)->fileStruct = ep;
+   return fd;
+}
+
+int
+epoll_ctl(int epfd,
+          int op,
+          int fd,
+          struct epoll_event *event)
+{
+   __wut_epoll *ep = __wut_get_epoll(epfd);
+   __wut_epoll_item *item;
+   int sockfd, registered;
+
+   if (!ep) {
+      return -1;
+   }
+
+   if (op != EPOLL_CTL_DEL && !event) {
+      errno = EFAULT;
+      return -1;
+   }
+
+   sockfd = __wut_get_nsysnet_fd(fd);
+   if (sockfd == -1) {
+      return -1;
+   }
+
+   if (sockfd >= NSYSNET_FD_SETSIZE) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   OSLockMutex(&ep->mutex);
+   __wut_epoll_refresh(ep);
+
+   item       = &ep->items[sockfd];
+   registered = (ep->registered & (1u << sockfd)) && item->fd == fd;
+
+   switch (op) {
+   case EPOLL_CTL_ADD:
+      if (registered) {
+         OSUnlockMutex(&ep->mutex);
+         errno = EEXIST;
+         return -1;
+      }
+
+      item->fd         = fd;
+      item->generation = __wut_nsysnet_fd_states[sockfd].generation;
+      ep->registered  |= 1u << sockfd;
+      registered       = TRUE;
+      // fallthrough
+   case EPOLL_CTL_MOD:
+      if (!registered) {
+         OSUnlockMutex(&ep->mutex);
+         errno = ENOENT;
+         return -1;
+      }
+
+      item->events  = event->events;
+      item->data    = event->data;
+      item->latched = 0;
+      break;
+   case EPOLL_CTL_DEL:
+      if (!registered) {
+         OSUnlockMutex(&ep->mutex);
+         errno = ENOENT;
+         return -1;
+      }
+
+      ep->registered &= ~(1u << sockfd);
+      break;
+   default:
+      OSUnlockMutex(&ep->mutex);
+      errno = EINVAL;
+      return -1;
+   }
+
+   __wut_epoll_arm(ep, sockfd);
+   OSUnlockMutex(&ep->mutex);
+   return 0;
+}
+
+int
+epoll_wait(int epfd,
+           struct epoll_event *events,
+           int maxevents,
+           int timeout)
+{
+   __wut_epoll *ep = __wut_get_epoll(epfd);
+   nsysnet_fd_set cnv_rd, cnv_wr, cnv_ex;
+   struct nsysnet_timeval cnv_timeout;
+   int cnv_nfds, rc;
+   OSTime start;
+
+   if (!ep) {
+      return -1;
+   }
+
+   if (!events || maxevents <= 0) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   OSLockMutex(&ep->mutex);
+   __wut_epoll_refresh(ep);
+
+   rc = __wut_epoll_deliver(ep, events, maxevents);
+   if (rc) {
+      OSUnlockMutex(&ep->mutex);
+      return rc;
+   }
+
+   cnv_rd   = ep->readSet;
+   cnv_wr   = ep->writeSet;
+   cnv_ex   = ep->exceptSet;
+   cnv_nfds = ep->registered ? 32 - __builtin_clz(ep->registered) : 0;
+   OSUnlockMutex(&ep->mutex);
+
+   if (timeout >= 0) {
+      cnv_timeout.tv_sec  = timeout / 1000;
+      cnv_timeout.tv_usec = (timeout % 1000) * 1000;
+   }
+
+   start = __wut_socket_stats_start();
+   rc    = RPLWRAP(select)(cnv_nfds, &cnv_rd, &cnv_wr, &cnv_ex,
+                           (timeout >= 0) ? &cnv_timeout : NULL);
+
+   rc = __wut_get_nsysnet_result(NULL, rc);
+   __wut_socket_stats_record(WUT_SOCKET_CALL_EPOLL_WAIT, -1, start, rc, errno);
+   if (rc <= 0) {
+      return rc;
+   }
+
+   // The interest set may have changed while waiting
+   OSLockMutex(&ep->mutex);
+   ep->readPending.fds_bits   = cnv_rd.fds_bits & ep->readSet.fds_bits;
+   ep->writePending.fds_bits  = cnv_wr.fds_bits & ep->writeSet.fds_bits;
+   ep->exceptPending.fds_bits = cnv_ex.fds_bits & ep->exceptSet.fds_bits;
+   rc = __wut_epoll_deliver(ep, events, maxevents);
+   OSUnlockMutex(&ep->mutex);
+   return rc;
+}
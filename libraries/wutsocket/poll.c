@@ -8,6 +8,7 @@ poll(struct pollfd *fds,
    int cnv_nfds = 0, rc, i;
    nsysnet_fd_set cnv_rd, cnv_wr, cnv_ex;
    struct nsysnet_timeval cnv_timeout;
+   OSTime start;
 
    if (!fds) {
       errno = EINVAL;
@@ -54,10 +55,12 @@ poll(struct pollfd *fds,
       cnv_timeout.tv_usec = (timeout % 1000) * 1000;
    }
 
-   rc = RPLWRAP(select)(cnv_nfds, &cnv_rd, &cnv_wr, &cnv_ex,
+   start = __wut_socket_stats_start();
+   rc    = RPLWRAP(select)(cnv_nfds, &cnv_rd, &cnv_wr, &cnv_ex,
                         (timeout >= 0) ? &cnv_timeout : NULL);
 
    rc = __wut_get_nsysnet_result(NULL, rc);
+   __wut_socket_stats_record(WUT_SOCKET_CALL_POLL, -1, start, rc, errno);
    if (rc == -1) {
       return rc;
    }
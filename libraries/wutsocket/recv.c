@@ -6,11 +6,16 @@ recv(int sockfd,
      size_t len,
      int flags)
 {
+   OSTime start;
    int rc;
    sockfd = __wut_get_nsysnet_fd(sockfd);
    if (sockfd == -1) {
       return -1;
    }
-   rc = RPLWRAP(recv)(sockfd, buf, len, flags);
-   return (ssize_t)__wut_get_nsysnet_result(NULL, rc);
+   start = __wut_socket_stats_start();
+   rc    = RPLWRAP(recv)(sockfd, buf, len, flags);
+   rc = __wut_get_nsysnet_result(NULL, rc);
+   __wut_set_nsysnet_blocked(sockfd, rc, errno, FALSE);
+   __wut_socket_stats_record(WUT_SOCKET_CALL_RECV, sockfd, start, rc, errno);
+   return (ssize_t)rc;
 }
@@ -8,11 +8,16 @@ recvfrom(int sockfd,
          struct sockaddr *src_addr,
          socklen_t *addrlen)
 {
+   OSTime start;
    int rc;
    sockfd = __wut_get_nsysnet_fd(sockfd);
    if (sockfd == -1) {
       return -1;
    }
-   rc = RPLWRAP(recvfrom)(sockfd, buf, len, flags, src_addr, addrlen);
-   return (ssize_t)__wut_get_nsysnet_result(NULL, rc);
+   start = __wut_socket_stats_start();
+   rc    = RPLWRAP(recvfrom)(sockfd, buf, len, flags, src_addr, addrlen);
+   rc = __wut_get_nsysnet_result(NULL, rc);
+   __wut_set_nsysnet_blocked(sockfd, rc, errno, FALSE);
+   __wut_socket_stats_record(WUT_SOCKET_CALL_RECVFROM, sockfd, start, rc, errno);
+   return (ssize_t)rc;
 }
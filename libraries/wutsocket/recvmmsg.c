@@ -0,0 +1,75 @@
+#include "wut_socket.h"
+#include <coreinit/time.h>
+
+int
+recvmmsg(int sockfd,
+         struct mmsghdr *msgvec,
+         unsigned int vlen,
+         int flags,
+         struct timespec *timeout)
+{
+   OSTime deadline = 0;
+   unsigned int i;
+   ssize_t rc;
+
+   if ((!msgvec && vlen) ||
+       (timeout && (timeout->tv_sec < 0 || timeout->tv_nsec < 0 ||
+                    timeout->tv_nsec >= 1000000000))) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   sockfd = __wut_get_nsysnet_fd(sockfd);
+   if (sockfd == -1) {
+      return -1;
+   }
+
+   if (vlen > IOV_MAX) {
+      vlen = IOV_MAX;
+   }
+
+   if (timeout) {
+      deadline = OSGetSystemTime() + OSSecondsToTicks(timeout->tv_sec) +
+                 OSNanosecondsToTicks(timeout->tv_nsec);
+   }
+
+   for (i = 0; i < vlen; ++i) {
+      struct msghdr *msg = &msgvec[i].msg_hdr;
+
+      rc = __wut_socket_recvv(sockfd, msg->msg_iov, msg->msg_iovlen,
+                              flags & ~MSG_WAITFORONE,
+                              (struct sockaddr *)msg->msg_name,
+                              msg->msg_name ? &msg->msg_namelen : NULL);
+      if (rc < 0) {
+         // Stop at the first datagram which is not ready yet, the error
+         // shows up again on the next call
+         return i ? (int)i : -1;
+      }
+
+      msg->msg_controllen = 0;
+      msg->msg_flags      = 0;
+      msgvec[i].msg_len   = (unsigned int)rc;
+
+      if (flags & MSG_WAITFORONE) {
+         flags |= MSG_DONTWAIT;
+      }
+
+      // Like Linux, the timeout is only checked after each datagram
+      if (timeout && OSGetSystemTime() >= deadline) {
+         ++i;
+         break;
+      }
+   }
+
+   if (timeout) {
+      OSTime remaining = deadline - OSGetSystemTime();
+      if (remaining < 0) {
+         remaining = 0;
+      }
+
+      timeout->tv_sec  = (time_t)OSTicksToSeconds(remaining);
+      timeout->tv_nsec = (long)OSTicksToNanoseconds(remaining % OSSecondsToTicks(1));
+   }
+
+   return (int)i;
+}
@@ -0,0 +1,28 @@
+#include "wut_socket.h"
+
+ssize_t
+recvmsg(int sockfd,
+        struct msghdr *msg,
+        int flags)
+{
+   ssize_t rc;
+
+   if (!msg) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   sockfd = __wut_get_nsysnet_fd(sockfd);
+   if (sockfd == -1) {
+      return -1;
+   }
+
+   rc = __wut_socket_recvv(sockfd, msg->msg_iov, msg->msg_iovlen, flags,
+                           (struct sockaddr *)msg->msg_name,
+                           msg->msg_name ? &msg->msg_namelen : NULL);
+
+   // Ancillary data is not supported by nsysnet
+   msg->msg_controllen = 0;
+   msg->msg_flags      = 0;
+   return rc;
+}
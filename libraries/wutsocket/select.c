@@ -10,6 +10,7 @@ select(int nfds,
    int cnv_nfds = 0, rc, i;
    nsysnet_fd_set cnv_rd, cnv_wr, cnv_ex;
    struct nsysnet_timeval cnv_timeout;
+   OSTime start;
 
    NSYSNET_FD_ZERO(&cnv_rd);
    NSYSNET_FD_ZERO(&cnv_wr);
@@ -55,13 +56,15 @@ select(int nfds,
       cnv_timeout.tv_usec = timeout->tv_usec;
    }
 
-   rc = RPLWRAP(select)(cnv_nfds,
+   start = __wut_socket_stats_start();
+   rc    = RPLWRAP(select)(cnv_nfds,
                         readfds ? &cnv_rd : NULL,
                         writefds ? &cnv_wr : NULL,
                         exceptfds ? &cnv_ex : NULL,
                         timeout ? &cnv_timeout : NULL);
 
    rc = __wut_get_nsysnet_result(NULL, rc);
+   __wut_socket_stats_record(WUT_SOCKET_CALL_SELECT, -1, start, rc, errno);
    if (rc == -1) {
       return rc;
    }
@@ -0,0 +1,42 @@
+#include "wut_socket.h"
+
+int
+sendmmsg(int sockfd,
+         struct mmsghdr *msgvec,
+         unsigned int vlen,
+         int flags)
+{
+   unsigned int i;
+   ssize_t rc;
+
+   if (!msgvec && vlen) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   sockfd = __wut_get_nsysnet_fd(sockfd);
+   if (sockfd == -1) {
+      return -1;
+   }
+
+   if (vlen > IOV_MAX) {
+      vlen = IOV_MAX;
+   }
+
+   for (i = 0; i < vlen; ++i) {
+      struct msghdr *msg = &msgvec[i].msg_hdr;
+
+      rc = __wut_socket_sendv(sockfd, msg->msg_iov, msg->msg_iovlen, flags,
+                              (const struct sockaddr *)msg->msg_name,
+                              msg->msg_name ? msg->msg_namelen : 0);
+      if (rc < 0) {
+         // Report the datagrams already sent, the error shows up again on
+         // the next call
+         return i ? (int)i : -1;
+      }
+
+      msgvec[i].msg_len = (unsigned int)rc;
+   }
+
+   return (int)i;
+}
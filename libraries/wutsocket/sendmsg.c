@@ -0,0 +1,21 @@
+#include "wut_socket.h"
+
+ssize_t
+sendmsg(int sockfd,
+        const struct msghdr *msg,
+        int flags)
+{
+   if (!msg) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   sockfd = __wut_get_nsysnet_fd(sockfd);
+   if (sockfd == -1) {
+      return -1;
+   }
+
+   return __wut_socket_sendv(sockfd, msg->msg_iov, msg->msg_iovlen, flags,
+                             (const struct sockaddr *)msg->msg_name,
+                             msg->msg_name ? msg->msg_namelen : 0);
+}
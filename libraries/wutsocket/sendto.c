@@ -8,11 +8,16 @@ sendto(int sockfd,
        const struct sockaddr *dest_addr,
        socklen_t addrlen)
 {
+   OSTime start;
    int rc;
    sockfd = __wut_get_nsysnet_fd(sockfd);
    if (sockfd == -1) {
       return -1;
    }
-   rc = RPLWRAP(sendto)(sockfd, buf, len, flags, dest_addr, addrlen);
-   return (ssize_t)__wut_get_nsysnet_result(NULL, rc);
+   start = __wut_socket_stats_start();
+   rc    = RPLWRAP(sendto)(sockfd, buf, len, flags, dest_addr, addrlen);
+   rc = __wut_get_nsysnet_result(NULL, rc);
+   __wut_set_nsysnet_blocked(sockfd, rc, errno, TRUE);
+   __wut_socket_stats_record(WUT_SOCKET_CALL_SENDTO, sockfd, start, rc, errno);
+   return (ssize_t)rc;
 }
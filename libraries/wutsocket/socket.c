@@ -5,6 +5,7 @@ socket(int domain,
        int type,
        int protocol)
 {
+   OSTime start;
    int rc, fd, dev;
 
    dev = FindDevice("soc:");
@@ -17,12 +18,18 @@ socket(int domain,
       return -1;
    }
 
-   rc = RPLWRAP(socket)(domain, type, protocol);
+   start = __wut_socket_stats_start();
+   rc    = RPLWRAP(socket)(domain, type, protocol);
    if (rc == -1) {
       __release_handle(fd);
-      return __wut_get_nsysnet_result(NULL, rc);
+      rc = __wut_get_nsysnet_result(NULL, rc);
+      __wut_socket_stats_record(WUT_SOCKET_CALL_SOCKET, -1, start, rc, errno);
+      return rc;
    }
 
-   *(int *)__get_handle(fd)->fileStruct = rc;
+   __wut_socket_stats_record(WUT_SOCKET_CALL_SOCKET, rc, start, rc, 0);
+
+   __wut_socket_apply_default_buffers(rc, type);
+   __wut_register_nsysnet_fd(fd, rc);
    return fd;
 }
@@ -0,0 +1,41 @@
+#include "wut_socket.h"
+#include <unistd.h>
+
+ssize_t
+writev(int fd,
+       const struct iovec *iov,
+       int iovcnt)
+{
+   ssize_t total = 0, rc;
+   int sockfd, i, error = errno;
+
+   sockfd = __wut_get_nsysnet_fd(fd);
+   if (sockfd != -1) {
+      return __wut_socket_sendv(sockfd, iov, iovcnt, 0, NULL, 0);
+   }
+
+   if (errno != ENOTSOCK) {
+      return -1;
+   }
+
+   // Not a socket, write each buffer through its devoptab
+   errno = error;
+   if (iovcnt < 0 || iovcnt > IOV_MAX || (iovcnt && !iov)) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   for (i = 0; i < iovcnt; ++i) {
+      rc = write(fd, iov[i].iov_base, iov[i].iov_len);
+      if (rc < 0) {
+         return total ? total : rc;
+      }
+
+      total += rc;
+      if ((size_t)rc < iov[i].iov_len) {
+         break;
+      }
+   }
+
+   return total;
+}
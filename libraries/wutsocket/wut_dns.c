@@ -0,0 +1,560 @@
+#include "wut_socket.h"
+#include <wut_dns.h>
+#include <wut_thread.h>
+
+#include <arpa/inet.h>
+#include <coreinit/atomic.h>
+#include <coreinit/condition.h>
+#include <coreinit/mutex.h>
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+#include <nsysnet/_netdb.h>
+#include <stdlib.h>
+
+#define DNS_MAX_THREADS (8)
+
+#define DNS_INIT_NONE    (0)
+#define DNS_INIT_RUNNING (1)
+#define DNS_INIT_DONE    (2)
+
+uint32_t __attribute__((weak)) __wut_dns_cache_size   = 32;
+uint32_t __attribute__((weak)) __wut_dns_cache_ttl    = 60;
+uint32_t __attribute__((weak)) __wut_dns_negative_ttl = 5;
+uint32_t __attribute__((weak)) __wut_dns_threads      = 2;
+
+typedef struct
+{
+   char *node;
+   char *service;
+   int flags;
+   int family;
+   int socktype;
+   int protocol;
+
+   //! Result of the last lookup, owned by the cache.
+   int status;
+   struct addrinfo *result;
+   OSTime expires;
+   OSTime lastUsed;
+
+   //! Set while one thread runs the lookup, others wait on sCondition.
+   BOOL resolving;
+   uint32_t waiters;
+} __wut_dns_entry;
+
+typedef struct __wut_dns_request __wut_dns_request;
+
+struct __wut_dns_request
+{
+   __wut_dns_request *next;
+   char *node;
+   char *service;
+   struct addrinfo hints;
+   BOOL hasHints;
+   WUTAddrInfoCallback callback;
+   void *context;
+};
+
+static OSMutex sMutex;
+static OSCondition sCondition;
+static __wut_dns_entry *sEntries = NULL;
+static uint32_t sEntryCount      = 0;
+
+static OSCondition sRequestCondition;
+static __wut_dns_request *sRequestHead = NULL;
+static __wut_dns_request *sRequestTail = NULL;
+static OSThread *sThreads[DNS_MAX_THREADS];
+static uint32_t sThreadCount = 0;
+static BOOL sStopping        = FALSE;
+
+static volatile uint32_t sInitState = DNS_INIT_NONE;
+
+/*
+ * Initialise the locks on first use rather than from __init_wut_socket,
+ * which an application may replace.
+ */
+static void
+__wut_dns_lazy_init()
+{
+   if (sInitState == DNS_INIT_DONE) {
+      return;
+   }
+
+   if (OSCompareAndSwapAtomic(&sInitState, DNS_INIT_NONE, DNS_INIT_RUNNING)) {
+      OSInitMutex(&sMutex);
+      OSInitCond(&sCondition);
+      OSInitCond(&sRequestCondition);
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      sInitState = DNS_INIT_DONE;
+      return;
+   }
+
+   while (sInitState != DNS_INIT_DONE) {
+      OSYieldThread();
+   }
+}
+
+void
+__wut_dns_init()
+{
+   __wut_dns_lazy_init();
+
+   OSLockMutex(&sMutex);
+   sStopping = FALSE;
+   OSUnlockMutex(&sMutex);
+}
+
+/*
+ * Literal addresses resolve without a query, caching them would only evict
+ * real names.
+ */
+static BOOL
+__wut_dns_is_numeric(const char *node)
+{
+   struct in_addr addr;
+   return inet_pton(AF_INET, node, &addr) == 1;
+}
+
+/*
+ * Copy a result list into a single allocation so it can be cached and
+ * handed out independently of nsysnet, freeaddrinfo then only has to free
+ * the head.
+ */
+static struct addrinfo *
+__wut_dns_copy(const struct addrinfo *list)
+{
+   const struct addrinfo *ai;
+   struct addrinfo *copy, *node;
+   uint8_t *ptr;
+   size_t size = 0;
+
+   for (ai = list; ai; ai = ai->ai_next) {
+      size += sizeof(struct addrinfo) + ((ai->ai_addrlen + 3) & ~3);
+      if (ai->ai_canonname) {
+         size += (strlen(ai->ai_canonname) + 4) & ~3;
+      }
+   }
+
+   if (!size) {
+      return NULL;
+   }
+
+   copy = (struct addrinfo *)malloc(size);
+   if (!copy) {
+      return NULL;
+   }
+
+   ptr = (uint8_t *)copy;
+   for (ai = list; ai; ai = ai->ai_next) {
+      node = (struct addrinfo *)ptr;
+      ptr += sizeof(struct addrinfo);
+
+      *node         = *ai;
+      node->ai_next = NULL;
+
+      if (ai->ai_addr) {
+         node->ai_addr = (struct sockaddr *)ptr;
+         memcpy(ptr, ai->ai_addr, ai->ai_addrlen);
+         ptr += (ai->ai_addrlen + 3) & ~3;
+      }
+
+      if (ai->ai_canonname) {
+         size_t length      = strlen(ai->ai_canonname) + 1;
+         node->ai_canonname = (char *)ptr;
+         memcpy(ptr, ai->ai_canonname, length);
+         ptr += (length + 3) & ~3;
+      }
+
+      if (ai->ai_next) {
+         node->ai_next = (struct addrinfo *)ptr;
+      }
+   }
+
+   return copy;
+}
+
+static int
+__wut_dns_lookup(const char *node,
+                 const char *service,
+                 const struct addrinfo *hints,
+                 struct addrinfo **res)
+{
+   struct addrinfo *result = NULL;
+   int rc;
+
+   rc = RPLWRAP(getaddrinfo)(node, service, hints, &result);
+   if (rc != 0) {
+      *res = NULL;
+      return rc;
+   }
+
+   *res = __wut_dns_copy(result);
+   RPLWRAP(freeaddrinfo)(result);
+   return *res ? 0 : EAI_MEMORY;
+}
+
+static BOOL
+__wut_dns_string_equal(const char *a,
+                       const char *b)
+{
+   if (!a || !b) {
+      return a == b;
+   }
+
+   return strcmp(a, b) == 0;
+}
+
+static char *
+__wut_dns_string_dup(const char *str)
+{
+   return str ? strdup(str) : NULL;
+}
+
+static void
+__wut_dns_clear_entry(__wut_dns_entry *entry)
+{
+   free(entry->node);
+   free(entry->service);
+   free(entry->result);
+   memset(entry, 0, sizeof(__wut_dns_entry));
+}
+
+static __wut_dns_entry *
+__wut_dns_find(const char *node,
+               const char *service,
+               const struct addrinfo *hints)
+{
+   uint32_t i;
+
+   for (i = 0; i < sEntryCount; ++i) {
+      __wut_dns_entry *entry = &sEntries[i];
+      if (!entry->node) {
+         continue;
+      }
+
+      if (entry->flags == (hints ? hints->ai_flags : 0)
+       && entry->family == (hints ? hints->ai_family : AF_UNSPEC)
+       && entry->socktype == (hints ? hints->ai_socktype : 0)
+       && entry->protocol == (hints ? hints->ai_protocol : 0)
+       && strcmp(entry->node, node) == 0
+       && __wut_dns_string_equal(entry->service, service)) {
+         return entry;
+      }
+   }
+
+   return NULL;
+}
+
+/*
+ * Pick a slot for a new name: a free one, else the least recently used
+ * entry nobody is waiting on.
+ */
+static __wut_dns_entry *
+__wut_dns_evict(void)
+{
+   __wut_dns_entry *victim = NULL;
+   uint32_t i;
+
+   if (!sEntries) {
+      sEntries = (__wut_dns_entry *)calloc(__wut_dns_cache_size, sizeof(__wut_dns_entry));
+      if (!sEntries) {
+         return NULL;
+      }
+      sEntryCount = __wut_dns_cache_size;
+   }
+
+   for (i = 0; i < sEntryCount; ++i) {
+      __wut_dns_entry *entry = &sEntries[i];
+      if (!entry->node) {
+         return entry;
+      }
+
+      if (entry->resolving || entry->waiters) {
+         continue;
+      }
+
+      if (!victim || entry->lastUsed < victim->lastUsed) {
+         victim = entry;
+      }
+   }
+
+   if (victim) {
+      __wut_dns_clear_entry(victim);
+   }
+
+   return victim;
+}
+
+static int
+__wut_dns_cached_result(__wut_dns_entry *entry,
+                        struct addrinfo **res)
+{
+   if (entry->status != 0) {
+      *res = NULL;
+      return entry->status;
+   }
+
+   *res = __wut_dns_copy(entry->result);
+   return *res ? 0 : EAI_MEMORY;
+}
+
+int
+__wut_dns_getaddrinfo(const char *node,
+                      const char *service,
+                      const struct addrinfo *hints,
+                      struct addrinfo **res)
+{
+   __wut_dns_entry *entry;
+   struct addrinfo *result;
+   OSTime now;
+   int rc;
+
+   *res = NULL;
+
+   if (!node || !__wut_dns_cache_size || (hints && (hints->ai_flags & AI_NUMERICHOST)) ||
+       __wut_dns_is_numeric(node)) {
+      return __wut_dns_lookup(node, service, hints, res);
+   }
+
+   __wut_dns_lazy_init();
+   OSLockMutex(&sMutex);
+
+   now   = OSGetSystemTime();
+   entry = __wut_dns_find(node, service, hints);
+
+   if (entry && entry->resolving) {
+      // Share the query already in flight
+      entry->waiters++;
+      while (entry->resolving) {
+         OSWaitCond(&sCondition, &sMutex);
+      }
+      entry->waiters--;
+
+      rc = __wut_dns_cached_result(entry, res);
+      OSUnlockMutex(&sMutex);
+      return rc;
+   }
+
+   if (entry && now < entry->expires) {
+      entry->lastUsed = now;
+      rc              = __wut_dns_cached_result(entry, res);
+      OSUnlockMutex(&sMutex);
+      return rc;
+   }
+
+   if (entry) {
+      // Expired, refresh it in place
+      free(entry->result);
+      entry->result = NULL;
+   } else {
+      entry = __wut_dns_evict();
+      if (!entry) {
+         OSUnlockMutex(&sMutex);
+         return __wut_dns_lookup(node, service, hints, res);
+      }
+
+      entry->node     = __wut_dns_string_dup(node);
+      entry->service  = __wut_dns_string_dup(service);
+      entry->flags    = hints ? hints->ai_flags : 0;
+      entry->family   = hints ? hints->ai_family : AF_UNSPEC;
+      entry->socktype = hints ? hints->ai_socktype : 0;
+      entry->protocol = hints ? hints->ai_protocol : 0;
+
+      if (!entry->node || (service && !entry->service)) {
+         __wut_dns_clear_entry(entry);
+         OSUnlockMutex(&sMutex);
+         return EAI_MEMORY;
+      }
+   }
+
+   entry->resolving = TRUE;
+   OSUnlockMutex(&sMutex);
+
+   rc = __wut_dns_lookup(node, service, hints, &result);
+
+   OSLockMutex(&sMutex);
+   now              = OSGetSystemTime();
+   entry->status    = rc;
+   entry->result    = result;
+   entry->lastUsed  = now;
+   entry->resolving = FALSE;
+
+   // Only remember answers, not transient failures
+   if (rc == 0) {
+      entry->expires = now + OSSecondsToTicks(__wut_dns_cache_ttl);
+   } else if (rc == EAI_NONAME || rc == EAI_NODATA) {
+      entry->expires = now + OSSecondsToTicks(__wut_dns_negative_ttl);
+   } else {
+      entry->expires = now;
+   }
+
+   OSSignalCond(&sCondition);
+
+   rc = __wut_dns_cached_result(entry, res);
+   OSUnlockMutex(&sMutex);
+   return rc;
+}
+
+static void
+__wut_dns_free_request(__wut_dns_request *request)
+{
+   free(request->node);
+   free(request->service);
+   free(request);
+}
+
+static void *
+__wut_dns_thread_main(void *arg)
+{
+   __wut_dns_request *request;
+   struct addrinfo *res;
+   int rc;
+
+   while (TRUE) {
+      OSLockMutex(&sMutex);
+      while (!sRequestHead && !sStopping) {
+         OSWaitCond(&sRequestCondition, &sMutex);
+      }
+
+      request = sRequestHead;
+      if (request) {
+         sRequestHead = request->next;
+         if (!sRequestHead) {
+            sRequestTail = NULL;
+         }
+      }
+      OSUnlockMutex(&sMutex);
+
+      if (!request) {
+         break;
+      }
+
+      res = NULL;
+      rc  = getaddrinfo(request->node, request->service,
+                       request->hasHints ? &request->hints : NULL, &res);
+      request->callback(rc, res, request->context);
+      __wut_dns_free_request(request);
+   }
+
+   return NULL;
+}
+
+int
+WUTGetAddrInfoAsync(const char *node,
+                    const char *service,
+                    const struct addrinfo *hints,
+                    WUTAddrInfoCallback callback,
+                    void *context)
+{
+   __wut_dns_request *request;
+
+   if (!callback || (!node && !service)) {
+      return EAI_NONAME;
+   }
+
+   request = (__wut_dns_request *)calloc(1, sizeof(__wut_dns_request));
+   if (!request) {
+      return EAI_MEMORY;
+   }
+
+   request->node     = __wut_dns_string_dup(node);
+   request->service  = __wut_dns_string_dup(service);
+   request->callback = callback;
+   request->context  = context;
+
+   if (hints) {
+      request->hints    = *hints;
+      request->hasHints = TRUE;
+   }
+
+   if ((node && !request->node) || (service && !request->service)) {
+      __wut_dns_free_request(request);
+      return EAI_MEMORY;
+   }
+
+   __wut_dns_lazy_init();
+   OSLockMutex(&sMutex);
+
+   // Start the resolver threads on first use
+   while (sThreadCount < __wut_dns_threads && sThreadCount < DNS_MAX_THREADS) {
+      WUTThreadAttr attr;
+      WUTInitThreadAttr(&attr);
+      attr.stackSize = 0x4000;
+      attr.name      = "wut dns resolver";
+
+      if (WUTCreateThread(&sThreads[sThreadCount], &attr, __wut_dns_thread_main, NULL) != 0) {
+         break;
+      }
+      sThreadCount++;
+   }
+
+   if (!sThreadCount) {
+      OSUnlockMutex(&sMutex);
+      __wut_dns_free_request(request);
+      return EAI_SYSTEM;
+   }
+
+   if (sRequestTail) {
+      sRequestTail->next = request;
+   } else {
+      sRequestHead = request;
+   }
+   sRequestTail = request;
+
+   OSSignalCond(&sRequestCondition);
+   OSUnlockMutex(&sMutex);
+   return 0;
+}
+
+void
+WUTFlushAddrInfoCache(void)
+{
+   uint32_t i;
+
+   __wut_dns_lazy_init();
+   OSLockMutex(&sMutex);
+   for (i = 0; i < sEntryCount; ++i) {
+      __wut_dns_entry *entry = &sEntries[i];
+      if (entry->node && !entry->resolving && !entry->waiters) {
+         __wut_dns_clear_entry(entry);
+      }
+   }
+   OSUnlockMutex(&sMutex);
+
+   RPLWRAP(clear_resolver_cache)();
+}
+
+void
+__wut_dns_fini()
+{
+   uint32_t i;
+
+   if (sInitState != DNS_INIT_DONE) {
+      return;
+   }
+
+   OSLockMutex(&sMutex);
+   sStopping = TRUE;
+   OSSignalCond(&sRequestCondition);
+   OSUnlockMutex(&sMutex);
+
+   for (i = 0; i < sThreadCount; ++i) {
+      OSJoinThread(sThreads[i], NULL);
+   }
+   sThreadCount = 0;
+
+   while (sRequestHead) {
+      __wut_dns_request *request = sRequestHead;
+      sRequestHead               = request->next;
+      __wut_dns_free_request(request);
+   }
+   sRequestTail = NULL;
+
+   for (i = 0; i < sEntryCount; ++i) {
+      __wut_dns_clear_entry(&sEntries[i]);
+   }
+
+   free(sEntries);
+   sEntries    = NULL;
+   sEntryCount = 0;
+}
@@ -0,0 +1,359 @@
+#include "wut_socket.h"
+#include <wut_nssl_pool.h>
+
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const WUTNSSLPoolConfig sDefaultConfig = {
+   .maxIdlePerHost = 4,
+   .maxIdle        = 16,
+   .idleTimeoutMs  = 30000,
+   .maxLifetimeMs  = 0,
+   .options        = 0,
+};
+
+static void
+__wut_nssl_pool_close(WUTNSSLPoolConnection *connection)
+{
+   NSSLDestroyConnection(connection->connection);
+   close(connection->socket);
+   free(connection);
+}
+
+static void
+__wut_nssl_pool_close_list(WUTNSSLPoolConnection *list)
+{
+   while (list) {
+      WUTNSSLPoolConnection *next = list->next;
+      __wut_nssl_pool_close(list);
+      list = next;
+   }
+}
+
+static BOOL
+__wut_nssl_pool_expired(WUTNSSLPool *pool,
+                        WUTNSSLPoolConnection *connection,
+                        OSTime now)
+{
+   if (now - connection->idleSince >= (OSTime)OSMillisecondsToTicks(pool->config.idleTimeoutMs)) {
+      return TRUE;
+   }
+
+   return pool->config.maxLifetimeMs &&
+          now - connection->created >= (OSTime)OSMillisecondsToTicks(pool->config.maxLifetimeMs);
+}
+
+static BOOL
+__wut_nssl_pool_matches(WUTNSSLPoolConnection *connection,
+                        const char *host,
+                        uint16_t port)
+{
+   return connection->port == port && strcasecmp(connection->host, host) == 0;
+}
+
+/*
+ * An idle TLS connection has nothing to read, so anything readable is the
+ * peer closing it, either with close_notify or a FIN.
+ */
+static BOOL
+__wut_nssl_pool_is_alive(WUTNSSLPoolConnection *connection)
+{
+   struct pollfd pfd = { connection->socket, POLLIN, 0 };
+   socklen_t length  = sizeof(int);
+   int error         = 0;
+
+   if (getsockopt(connection->socket, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error) {
+      return FALSE;
+   }
+
+   return poll(&pfd, 1, 0) == 0;
+}
+
+/*
+ * Remove the most recently used idle connection for a host, moving any
+ * expired connections onto expiredList.
+ */
+static WUTNSSLPoolConnection *
+__wut_nssl_pool_take_idle(WUTNSSLPool *pool,
+                          const char *host,
+                          uint16_t port,
+                          WUTNSSLPoolConnection **expiredList)
+{
+   WUTNSSLPoolConnection **link = &pool->idle;
+   WUTNSSLPoolConnection *found = NULL;
+   OSTime now                   = OSGetSystemTime();
+
+   while (*link) {
+      WUTNSSLPoolConnection *connection = *link;
+
+      if (__wut_nssl_pool_expired(pool, connection, now)) {
+         *link            = connection->next;
+         connection->next = *expiredList;
+         *expiredList     = connection;
+         pool->stats.expired++;
+         pool->stats.idle--;
+         continue;
+      }
+
+      if (!found && __wut_nssl_pool_matches(connection, host, port)) {
+         *link = connection->next;
+         found = connection;
+         pool->stats.idle--;
+         continue;
+      }
+
+      link = &connection->next;
+   }
+
+   return found;
+}
+
+static int
+__wut_nssl_pool_connect(const char *host,
+                        uint16_t port)
+{
+   struct addrinfo hints = { 0 };
+   struct addrinfo *res, *ai;
+   char service[6];
+   int fd = -1, error = EHOSTUNREACH;
+
+   hints.ai_family   = AF_INET;
+   hints.ai_socktype = SOCK_STREAM;
+   snprintf(service, sizeof(service), "%u", port);
+
+   if (getaddrinfo(host, service, &hints, &res) != 0) {
+      errno = EHOSTUNREACH;
+      return -1;
+   }
+
+   for (ai = res; ai; ai = ai->ai_next) {
+      fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if (fd < 0) {
+         error = errno;
+         continue;
+      }
+
+      if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+         break;
+      }
+
+      error = errno;
+      close(fd);
+      fd = -1;
+   }
+
+   freeaddrinfo(res);
+
+   if (fd < 0) {
+      errno = error;
+   }
+
+   return fd;
+}
+
+static int
+__wut_nssl_pool_open(WUTNSSLPool *pool,
+                     const char *host,
+                     uint16_t port,
+                     WUTNSSLPoolConnection **outConnection)
+{
+   size_t hostLength = strlen(host);
+   WUTNSSLPoolConnection *connection;
+   NSSLConnectionHandle handle;
+
+   connection = (WUTNSSLPoolConnection *)malloc(sizeof(WUTNSSLPoolConnection) + hostLength + 1);
+   if (!connection) {
+      errno = ENOMEM;
+      return -1;
+   }
+
+   connection->socket = __wut_nssl_pool_connect(host, port);
+   if (connection->socket < 0) {
+      free(connection);
+      return -1;
+   }
+
+   handle = NSSLCreateConnection(pool->context, host, (int32_t)hostLength,
+                                 pool->config.options, connection->socket, TRUE);
+   if (handle < 0) {
+      close(connection->socket);
+      free(connection);
+      return handle;
+   }
+
+   memcpy(connection + 1, host, hostLength + 1);
+   connection->connection = handle;
+   connection->reused     = FALSE;
+   connection->host       = (const char *)(connection + 1);
+   connection->port       = port;
+   connection->created    = OSGetSystemTime();
+   connection->idleSince  = connection->created;
+   connection->next       = NULL;
+
+   *outConnection = connection;
+   return 0;
+}
+
+void
+WUTInitNSSLPool(WUTNSSLPool *pool,
+                NSSLContextHandle context,
+                const WUTNSSLPoolConfig *config)
+{
+   memset(pool, 0, sizeof(WUTNSSLPool));
+   OSInitMutexEx(&pool->mutex, "wut_nssl_pool");
+   pool->context = context;
+   pool->config  = config ? *config : sDefaultConfig;
+}
+
+void
+WUTDestroyNSSLPool(WUTNSSLPool *pool)
+{
+   WUTFlushNSSLPool(pool);
+}
+
+int
+WUTNSSLPoolCheckout(WUTNSSLPool *pool,
+                    const char *host,
+                    uint16_t port,
+                    WUTNSSLPoolConnection **outConnection)
+{
+   WUTNSSLPoolConnection *connection;
+   int rc;
+
+   if (!host || !outConnection) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   while (TRUE) {
+      WUTNSSLPoolConnection *expiredList = NULL;
+
+      OSLockMutex(&pool->mutex);
+      connection = __wut_nssl_pool_take_idle(pool, host, port, &expiredList);
+      OSUnlockMutex(&pool->mutex);
+
+      __wut_nssl_pool_close_list(expiredList);
+
+      if (!connection) {
+         break;
+      }
+
+      if (__wut_nssl_pool_is_alive(connection)) {
+         connection->reused = TRUE;
+
+         OSLockMutex(&pool->mutex);
+         pool->stats.checkouts++;
+         pool->stats.reused++;
+         OSUnlockMutex(&pool->mutex);
+
+         *outConnection = connection;
+         return 0;
+      }
+
+      OSLockMutex(&pool->mutex);
+      pool->stats.stale++;
+      OSUnlockMutex(&pool->mutex);
+
+      __wut_nssl_pool_close(connection);
+   }
+
+   // No idle connection, pay for a full handshake
+   rc = __wut_nssl_pool_open(pool, host, port, &connection);
+
+   OSLockMutex(&pool->mutex);
+   if (rc == 0) {
+      pool->stats.checkouts++;
+      pool->stats.created++;
+   } else {
+      pool->stats.failed++;
+   }
+   OSUnlockMutex(&pool->mutex);
+
+   if (rc == 0) {
+      *outConnection = connection;
+   }
+
+   return rc;
+}
+
+void
+WUTNSSLPoolCheckin(WUTNSSLPool *pool,
+                   WUTNSSLPoolConnection *connection,
+                   BOOL reusable)
+{
+   WUTNSSLPoolConnection **link, **oldestForHost = NULL, **oldest = NULL;
+   WUTNSSLPoolConnection *evicted = NULL;
+   uint32_t hostCount = 0;
+
+   if (!connection) {
+      return;
+   }
+
+   connection->idleSince = OSGetSystemTime();
+
+   if (!reusable || !pool->config.maxIdle || !pool->config.maxIdlePerHost ||
+       __wut_nssl_pool_expired(pool, connection, connection->idleSince)) {
+      __wut_nssl_pool_close(connection);
+      return;
+   }
+
+   OSLockMutex(&pool->mutex);
+   connection->next = pool->idle;
+   pool->idle       = connection;
+   pool->stats.idle++;
+
+   // The list is most recently used first, so the last match is the oldest
+   for (link = &pool->idle; *link; link = &(*link)->next) {
+      if (__wut_nssl_pool_matches(*link, connection->host, connection->port)) {
+         hostCount++;
+         oldestForHost = link;
+      }
+      oldest = link;
+   }
+
+   link = NULL;
+   if (hostCount > pool->config.maxIdlePerHost) {
+      link = oldestForHost;
+   } else if (pool->stats.idle > pool->config.maxIdle) {
+      link = oldest;
+   }
+
+   if (link) {
+      evicted = *link;
+      *link   = evicted->next;
+      pool->stats.evicted++;
+      pool->stats.idle--;
+   }
+   OSUnlockMutex(&pool->mutex);
+
+   if (evicted) {
+      __wut_nssl_pool_close(evicted);
+   }
+}
+
+void
+WUTFlushNSSLPool(WUTNSSLPool *pool)
+{
+   WUTNSSLPoolConnection *list;
+
+   OSLockMutex(&pool->mutex);
+   list             = pool->idle;
+   pool->idle       = NULL;
+   pool->stats.idle = 0;
+   OSUnlockMutex(&pool->mutex);
+
+   __wut_nssl_pool_close_list(list);
+}
+
+void
+WUTGetNSSLPoolStats(WUTNSSLPool *pool,
+                    WUTNSSLPoolStats *outStats)
+{
+   OSLockMutex(&pool->mutex);
+   *outStats = pool->stats;
+   OSUnlockMutex(&pool->mutex);
+}
@@ -7,9 +7,111 @@
 #include <string.h>
 #include <sys/iosupport.h>
 #include <sys/select.h>
+#include <wut_socket_stats.h>
+#include <coreinit/time.h>
 #define __LINUX_ERRNO_EXTENSIONS__
 #include <errno.h>
 
+/*
+ * The devoptab file struct of a socket, fd is the newlib descriptor it was
+ * created with.
+ */
+typedef struct
+{
+   int sockfd;
+   int fd;
+} __wut_socket_file;
+
+/*
+ * Per nsysnet socket counters read by epoll. The generation changes when the
+ * socket is closed, the blocked counters whenever a read or write on it
+ * fails with EWOULDBLOCK, which re-arms edge triggered events.
+ */
+typedef struct
+{
+   uint32_t generation;
+   uint32_t readBlocked;
+   uint32_t writeBlocked;
+} __wut_nsysnet_fd_state;
+
+extern __wut_nsysnet_fd_state __wut_nsysnet_fd_states[NSYSNET_FD_SETSIZE];
+
+static inline void
+__wut_set_nsysnet_blocked(int sockfd,
+                          int rc,
+                          int error,
+                          int write)
+{
+   if (rc == -1 && error == EWOULDBLOCK && sockfd >= 0 && sockfd < NSYSNET_FD_SETSIZE) {
+      if (write) {
+         __wut_nsysnet_fd_states[sockfd].writeBlocked++;
+      } else {
+         __wut_nsysnet_fd_states[sockfd].readBlocked++;
+      }
+   }
+}
+
+/*
+ * Statistics hooks, a wrapper takes the time before calling nsysnet and
+ * records the result after __wut_get_nsysnet_result. Without
+ * WUT_SOCKET_STATS both compile to nothing.
+ */
+#ifdef WUT_SOCKET_STATS
+static inline OSTime
+__wut_socket_stats_start()
+{
+   return OSGetSystemTime();
+}
+
+void
+__wut_socket_stats_record(WUTSocketCall call, int sockfd, OSTime start, int rc, int error);
+#else
+static inline OSTime
+__wut_socket_stats_start()
+{
+   return 0;
+}
+
+static inline void
+__wut_socket_stats_record(WUTSocketCall call,
+                          int sockfd,
+                          OSTime start,
+                          int rc,
+                          int error)
+{
+}
+#endif
+
+void
+__wut_epoll_init_devoptab();
+void
+__wut_epoll_fini_devoptab();
+
+void
+__wut_socket_memory_init();
+void
+__wut_socket_memory_fini();
+void
+__wut_socket_apply_default_buffers(int sockfd, int type);
+
+ssize_t
+__wut_socket_sendv(int sockfd, const struct iovec *iov, int iovcnt, int flags, const struct sockaddr *addr, socklen_t addrlen);
+ssize_t
+__wut_socket_recvv(int sockfd, const struct iovec *iov, int iovcnt, int flags, struct sockaddr *addr, socklen_t *addrlen);
+
+struct addrinfo;
+
+void
+__wut_dns_init();
+void
+__wut_dns_fini();
+int
+__wut_dns_getaddrinfo(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res);
+
+void
+__wut_register_nsysnet_fd(int fd, int sockfd);
+void
+__wut_unregister_nsysnet_fd(__wut_socket_file *file);
 int
 __wut_get_nsysnet_fd(int fd);
 int
@@ -4,7 +4,17 @@ int
 __wut_socket_close(struct _reent *r,
                    void *fd)
 {
-   int sockfd = *(int *)fd;
-   int rc     = RPLWRAP(socketclose)(sockfd);
-   return __wut_get_nsysnet_result(r, rc);
+   __wut_socket_file *file = (__wut_socket_file *)fd;
+   OSTime start;
+   int rc;
+
+   __wut_unregister_nsysnet_fd(file);
+   if (file->sockfd >= 0 && file->sockfd < NSYSNET_FD_SETSIZE) {
+      __wut_nsysnet_fd_states[file->sockfd].generation++;
+   }
+   start = __wut_socket_stats_start();
+   rc    = RPLWRAP(socketclose)(file->sockfd);
+   rc    = __wut_get_nsysnet_result(r, rc);
+   __wut_socket_stats_record(WUT_SOCKET_CALL_CLOSE, file->sockfd, start, rc, r->_errno);
+   return rc;
 }
@@ -2,12 +2,28 @@
 #include <nsysnet/misc.h>
 
 #define NSYSNET_UNKNOWN_ERROR_OFFSET 10000
+#define NSYSNET_FD_MAP_SIZE          1024
 
 int h_errno;
 
+typedef struct
+{
+   __handle *handle;
+   int sockfd;
+} __wut_nsysnet_fd_entry;
+
+/*
+ * Newlib fd to nsysnet socket translation for sockets created with socket
+ * and accept. The handle is compared on lookup so a slot whose fd was closed
+ * while a dup of it kept the socket open is not mistaken for a socket.
+ */
+static __wut_nsysnet_fd_entry __wut_nsysnet_fd_map[NSYSNET_FD_MAP_SIZE];
+
+__wut_nsysnet_fd_state __wut_nsysnet_fd_states[NSYSNET_FD_SETSIZE];
+
 static devoptab_t __wut_socket_devoptab = {
    .name       = "soc",
-   .structSize = sizeof(int),
+   .structSize = sizeof(__wut_socket_file),
    .open_r     = __wut_socket_open,
    .close_r    = __wut_socket_close,
    .write_r    = __wut_socket_write,
@@ -73,11 +89,13 @@ void
 __wut_socket_init_devoptab()
 {
    AddDevice(&__wut_socket_devoptab);
+   __wut_epoll_init_devoptab();
 }
 
 void
 __wut_socket_fini_devoptab()
 {
+   __wut_epoll_fini_devoptab();
    RemoveDevice("soc:");
 }
 
@@ -85,6 +103,8 @@ void __attribute__((weak))
 __init_wut_socket()
 {
    socket_lib_init();
+   __wut_socket_memory_init();
+   __wut_dns_init();
    set_multicast_state(TRUE);
    __wut_socket_init_devoptab();
    ACInitialize();
@@ -94,16 +114,57 @@ __init_wut_socket()
 void __attribute__((weak))
 __fini_wut_socket()
 {
+   __wut_dns_fini();
    ACClose();
    ACFinalize();
    __wut_socket_fini_devoptab();
    socket_lib_finish();
+   __wut_socket_memory_fini();
+}
+
+void
+__wut_register_nsysnet_fd(int fd,
+                          int sockfd)
+{
+   __handle *handle = __get_handle(fd);
+   __wut_socket_file *file = (__wut_socket_file *)handle->fileStruct;
+
+   file->sockfd = sockfd;
+   file->fd     = fd;
+
+   if (fd >= 0 && fd < NSYSNET_FD_MAP_SIZE) {
+      __wut_nsysnet_fd_map[fd].sockfd = sockfd;
+      __wut_nsysnet_fd_map[fd].handle = handle;
+   }
+}
+
+void
+__wut_unregister_nsysnet_fd(__wut_socket_file *file)
+{
+   __wut_nsysnet_fd_entry *entry;
+
+   if (file->fd < 0 || file->fd >= NSYSNET_FD_MAP_SIZE) {
+      return;
+   }
+
+   // The slot may belong to another socket by now if this one was dup'd
+   entry = &__wut_nsysnet_fd_map[file->fd];
+   if (entry->handle && entry->handle->fileStruct == file) {
+      entry->handle = NULL;
+   }
 }
 
 int
 __wut_get_nsysnet_fd(int fd)
 {
    __handle *handle = __get_handle(fd);
+
+   if (fd >= 0 && fd < NSYSNET_FD_MAP_SIZE
+    && handle && __wut_nsysnet_fd_map[fd].handle == handle) {
+      return __wut_nsysnet_fd_map[fd].sockfd;
+   }
+
+   // Descriptors made by dup, or past the end of the map
    if (handle == NULL) {
       errno = EBADF;
       return -1;
@@ -112,7 +173,7 @@ __wut_get_nsysnet_fd(int fd)
       errno = ENOTSOCK;
       return -1;
    }
-   return *(int *)handle->fileStruct;
+   return ((__wut_socket_file *)handle->fileStruct)->sockfd;
 }
 
 int
@@ -0,0 +1,171 @@
+#include "wut_socket.h"
+#include <limits.h>
+#include <stdlib.h>
+
+// Messages larger than this use a temporary buffer rather than growing the
+// per-thread staging buffer
+#define NSYSNET_STAGING_MAX (64 * 1024)
+
+extern void *
+__wut_get_staging_buffer(size_t size);
+
+static ssize_t
+__wut_socket_iov_length(const struct iovec *iov,
+                        int iovcnt)
+{
+   size_t total = 0;
+   int i;
+
+   if (iovcnt < 0 || iovcnt > IOV_MAX || (iovcnt && !iov)) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   for (i = 0; i < iovcnt; ++i) {
+      if (iov[i].iov_len > SSIZE_MAX - total) {
+         errno = EINVAL;
+         return -1;
+      }
+      total += iov[i].iov_len;
+   }
+
+   return (ssize_t)total;
+}
+
+static uint8_t *
+__wut_socket_staging_alloc(size_t size,
+                           BOOL *temporary)
+{
+   void *buffer;
+
+   if (size <= NSYSNET_STAGING_MAX) {
+      buffer = __wut_get_staging_buffer(size);
+      if (buffer) {
+         *temporary = FALSE;
+         return (uint8_t *)buffer;
+      }
+   }
+
+   buffer = malloc(size);
+   if (!buffer) {
+      errno = ENOMEM;
+   }
+
+   *temporary = TRUE;
+   return (uint8_t *)buffer;
+}
+
+ssize_t
+__wut_socket_sendv(int sockfd,
+                   const struct iovec *iov,
+                   int iovcnt,
+                   int flags,
+                   const struct sockaddr *addr,
+                   socklen_t addrlen)
+{
+   ssize_t total = __wut_socket_iov_length(iov, iovcnt);
+   const void *data;
+   uint8_t *staging = NULL;
+   BOOL temporary   = FALSE;
+   OSTime start;
+   int rc, i;
+
+   if (total < 0) {
+      return -1;
+   }
+
+   if (iovcnt <= 1 || !total) {
+      // Nothing to gather, pass the caller's buffer straight through
+      data = iovcnt ? iov[0].iov_base : NULL;
+   } else {
+      uint8_t *ptr;
+
+      staging = __wut_socket_staging_alloc(total, &temporary);
+      if (!staging) {
+         return -1;
+      }
+
+      for (ptr = staging, i = 0; i < iovcnt; ++i) {
+         memcpy(ptr, iov[i].iov_base, iov[i].iov_len);
+         ptr += iov[i].iov_len;
+      }
+
+      data = staging;
+   }
+
+   start = __wut_socket_stats_start();
+   if (addr) {
+      rc = RPLWRAP(sendto)(sockfd, data, total, flags, addr, addrlen);
+   } else {
+      rc = RPLWRAP(send)(sockfd, data, total, flags);
+   }
+
+   if (temporary) {
+      free(staging);
+   }
+
+   rc = __wut_get_nsysnet_result(NULL, rc);
+   __wut_set_nsysnet_blocked(sockfd, rc, errno, TRUE);
+   __wut_socket_stats_record(WUT_SOCKET_CALL_SENDMSG, sockfd, start, rc, errno);
+   return (ssize_t)rc;
+}
+
+ssize_t
+__wut_socket_recvv(int sockfd,
+                   const struct iovec *iov,
+                   int iovcnt,
+                   int flags,
+                   struct sockaddr *addr,
+                   socklen_t *addrlen)
+{
+   ssize_t total = __wut_socket_iov_length(iov, iovcnt);
+   uint8_t *staging = NULL;
+   BOOL temporary   = FALSE;
+   OSTime start;
+   void *data;
+   int rc, i;
+
+   if (total < 0) {
+      return -1;
+   }
+
+   if (iovcnt <= 1 || !total) {
+      data = iovcnt ? iov[0].iov_base : NULL;
+   } else {
+      staging = __wut_socket_staging_alloc(total, &temporary);
+      if (!staging) {
+         return -1;
+      }
+
+      data = staging;
+   }
+
+   start = __wut_socket_stats_start();
+   if (addr) {
+      rc = RPLWRAP(recvfrom)(sockfd, data, total, flags, addr, addrlen);
+   } else {
+      rc = RPLWRAP(recv)(sockfd, data, total, flags);
+   }
+
+   if (staging) {
+      // Scatter only what was received
+      const uint8_t *ptr = staging;
+      size_t remaining   = rc > 0 ? (size_t)rc : 0;
+
+      for (i = 0; i < iovcnt && remaining; ++i) {
+         size_t length = iov[i].iov_len < remaining ? iov[i].iov_len : remaining;
+         memcpy(iov[i].iov_base, ptr, length);
+         ptr       += length;
+         remaining -= length;
+      }
+
+      if (temporary) {
+         free(staging);
+      }
+   }
+
+   rc = __wut_get_nsysnet_result(NULL, rc);
+   __wut_set_nsysnet_blocked(sockfd, rc, errno, FALSE);
+   __wut_socket_stats_record(WUT_SOCKET_CALL_RECVMSG, sockfd, start, rc, errno);
+   return (ssize_t)rc;
+}
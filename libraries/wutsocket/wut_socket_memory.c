@@ -0,0 +1,198 @@
+#include "wut_socket.h"
+#include <wut_net.h>
+#include <wut_thread.h>
+
+#include <coreinit/thread.h>
+#include <malloc.h>
+#include <nn/nets2.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+#define SOMEMOPT_BUFFER_ALIGN (0x40)
+
+const WUTSocketMemoryConfig __attribute__((weak)) __wut_socket_memory = {0};
+
+static OSThread *sMemOptThread = NULL;
+static void *sMemOptBuffer     = NULL;
+
+//! Set once the network stack has taken the buffer.
+static BOOL sMemOptActive = FALSE;
+
+//! Set by the somemopt thread if INIT failed, and by the initialising
+//! thread once its WAIT_FOR_INIT returned.
+static volatile BOOL sMemOptFailed   = FALSE;
+static volatile BOOL sMemOptWaitDone = FALSE;
+
+static void *
+__wut_socket_memopt_main(void *arg)
+{
+   const WUTSocketMemoryConfig *config = &__wut_socket_memory;
+
+   // Only returns once the network stack shuts down
+   if (RPLWRAP(somemopt)(SOMEMOPT_REQUEST_INIT, sMemOptBuffer,
+                         config->bufferSize, (SOMemOptFlags)config->flags) < 0) {
+      sMemOptFailed = TRUE;
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+      // Release the initialising thread, a cancel sent before it started
+      // waiting is lost so keep sending until it is done.
+      while (!sMemOptWaitDone) {
+         RPLWRAP(somemopt)(SOMEMOPT_REQUEST_CANCEL_WAIT, NULL, 0, SOMEMOPT_FLAGS_NONE);
+         OSSleepTicks(OSMillisecondsToTicks(1));
+      }
+   }
+
+   return NULL;
+}
+
+void
+__wut_socket_memory_init()
+{
+   const WUTSocketMemoryConfig *config = &__wut_socket_memory;
+   WUTThreadAttr attr;
+
+   if (config->bufferSize < WUT_SOCKET_MEMORY_MIN ||
+       config->bufferSize > WUT_SOCKET_MEMORY_MAX) {
+      return;
+   }
+
+   sMemOptBuffer = memalign(SOMEMOPT_BUFFER_ALIGN, config->bufferSize);
+   if (!sMemOptBuffer) {
+      return;
+   }
+
+   WUTInitThreadAttr(&attr);
+   attr.stackSize = 0x2000;
+   attr.name      = "wut somemopt";
+
+   if (WUTCreateThread(&sMemOptThread, &attr, __wut_socket_memopt_main, NULL) != 0) {
+      free(sMemOptBuffer);
+      sMemOptBuffer = NULL;
+      return;
+   }
+
+   if (!sMemOptFailed) {
+      RPLWRAP(somemopt)(SOMEMOPT_REQUEST_WAIT_FOR_INIT, NULL, 0, SOMEMOPT_FLAGS_NONE);
+   }
+
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   sMemOptWaitDone = TRUE;
+   sMemOptActive   = !sMemOptFailed;
+}
+
+void
+__wut_socket_memory_fini()
+{
+   if (!sMemOptThread) {
+      return;
+   }
+
+   // Must follow socket_lib_finish, which ends the somemopt request
+   OSJoinThread(sMemOptThread, NULL);
+   sMemOptThread   = NULL;
+   sMemOptActive   = FALSE;
+   sMemOptFailed   = FALSE;
+   sMemOptWaitDone = FALSE;
+
+   free(sMemOptBuffer);
+   sMemOptBuffer = NULL;
+}
+
+void
+__wut_socket_apply_default_buffers(int sockfd,
+                                   int type)
+{
+   const WUTSocketMemoryConfig *config = &__wut_socket_memory;
+   int size;
+
+   if (type != SOCK_STREAM) {
+      return;
+   }
+
+   if (sMemOptActive) {
+      // nsysnet only receives into the somemopt buffer with this set
+      int enable = 1;
+      RPLWRAP(setsockopt)(sockfd, SOL_SOCKET, SO_RUSRBUF, &enable, sizeof(enable));
+   }
+
+   if (config->recvBufferSize) {
+      size = (int)config->recvBufferSize;
+      RPLWRAP(setsockopt)(sockfd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+   }
+
+   if (config->sendBufferSize) {
+      size = (int)config->sendBufferSize;
+      RPLWRAP(setsockopt)(sockfd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+   }
+}
+
+int
+WUTGetSocketMemoryUsed(void)
+{
+   if (!sMemOptActive) {
+      return -1;
+   }
+
+   return somemopt(SOMEMOPT_REQUEST_GET_BYTES_USED, NULL, 0, SOMEMOPT_FLAGS_NONE);
+}
+
+static int
+__wut_socket_set_buffer(int fd,
+                        int option,
+                        uint32_t size)
+{
+   while (TRUE) {
+      int value = (int)size;
+      if (setsockopt(fd, SOL_SOCKET, option, &value, sizeof(value)) == 0) {
+         return 0;
+      }
+
+      if (errno == EBADF || errno == ENOTSOCK || size <= WUT_SOCKET_BUFFER_MIN) {
+         return -1;
+      }
+
+      size /= 2;
+      if (size < WUT_SOCKET_BUFFER_MIN) {
+         size = WUT_SOCKET_BUFFER_MIN;
+      }
+   }
+}
+
+int
+WUTSetSocketBufferSizes(int fd,
+                        uint32_t recvSize,
+                        uint32_t sendSize)
+{
+   if (recvSize && __wut_socket_set_buffer(fd, SO_RCVBUF, recvSize) != 0) {
+      return -1;
+   }
+
+   if (sendSize && __wut_socket_set_buffer(fd, SO_SNDBUF, sendSize) != 0) {
+      return -1;
+   }
+
+   return 0;
+}
+
+int
+WUTTuneSocketBuffers(int fd,
+                     uint32_t bytesPerSecond,
+                     uint32_t rttMilliseconds)
+{
+   uint64_t size = ((uint64_t)bytesPerSecond * rttMilliseconds * 2) / 1000;
+   uint64_t limit = WUT_SOCKET_BUFFER_MAX;
+
+   if (sMemOptActive && __wut_socket_memory.bufferSize / 4 < limit) {
+      limit = __wut_socket_memory.bufferSize / 4;
+   }
+
+   if (size > limit) {
+      size = limit;
+   }
+
+   if (size < WUT_SOCKET_BUFFER_MIN) {
+      size = WUT_SOCKET_BUFFER_MIN;
+   }
+
+   return WUTSetSocketBufferSizes(fd, (uint32_t)size, (uint32_t)size);
+}
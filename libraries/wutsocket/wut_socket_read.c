@@ -6,7 +6,11 @@ __wut_socket_read(struct _reent *r,
                   char *ptr,
                   size_t len)
 {
-   int sockfd = *(int *)fd;
-   int rc     = RPLWRAP(recv)(sockfd, ptr, len, 0);
-   return (ssize_t)__wut_get_nsysnet_result(r, rc);
+   int sockfd   = ((__wut_socket_file *)fd)->sockfd;
+   OSTime start = __wut_socket_stats_start();
+   int rc       = RPLWRAP(recv)(sockfd, ptr, len, 0);
+   rc = __wut_get_nsysnet_result(r, rc);
+   __wut_set_nsysnet_blocked(sockfd, rc, r->_errno, FALSE);
+   __wut_socket_stats_record(WUT_SOCKET_CALL_READ, sockfd, start, rc, r->_errno);
+   return (ssize_t)rc;
 }
@@ -0,0 +1,331 @@
+#include "wut_socket.h"
+#include <wut_socket_stats.h>
+
+#include <coreinit/spinlock.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef WUT_SOCKET_STATS
+
+typedef enum
+{
+   SOCKET_STATS_NONE,
+   SOCKET_STATS_RECEIVE,
+   SOCKET_STATS_SEND,
+} __wut_socket_stats_direction;
+
+static const struct
+{
+   const char *name;
+   __wut_socket_stats_direction direction;
+} sCallInfo[WUT_SOCKET_CALL_COUNT] = {
+   [WUT_SOCKET_CALL_SOCKET]     = { "socket",     SOCKET_STATS_NONE },
+   [WUT_SOCKET_CALL_ACCEPT]     = { "accept",     SOCKET_STATS_NONE },
+   [WUT_SOCKET_CALL_CONNECT]    = { "connect",    SOCKET_STATS_NONE },
+   [WUT_SOCKET_CALL_CLOSE]      = { "close",      SOCKET_STATS_NONE },
+   [WUT_SOCKET_CALL_RECV]       = { "recv",       SOCKET_STATS_RECEIVE },
+   [WUT_SOCKET_CALL_RECVFROM]   = { "recvfrom",   SOCKET_STATS_RECEIVE },
+   [WUT_SOCKET_CALL_RECVMSG]    = { "recvmsg",    SOCKET_STATS_RECEIVE },
+   [WUT_SOCKET_CALL_READ]       = { "read",       SOCKET_STATS_RECEIVE },
+   [WUT_SOCKET_CALL_SEND]       = { "send",       SOCKET_STATS_SEND },
+   [WUT_SOCKET_CALL_SENDTO]     = { "sendto",     SOCKET_STATS_SEND },
+   [WUT_SOCKET_CALL_SENDMSG]    = { "sendmsg",    SOCKET_STATS_SEND },
+   [WUT_SOCKET_CALL_WRITE]      = { "write",      SOCKET_STATS_SEND },
+   [WUT_SOCKET_CALL_SELECT]     = { "select",     SOCKET_STATS_NONE },
+   [WUT_SOCKET_CALL_POLL]       = { "poll",       SOCKET_STATS_NONE },
+   [WUT_SOCKET_CALL_EPOLL_WAIT] = { "epoll_wait", SOCKET_STATS_NONE },
+};
+
+typedef struct
+{
+   WUTSocketStats stats;
+   WUTSocketFdStats fds[WUT_SOCKET_STATS_SOCKETS];
+} __wut_socket_stats_snapshot;
+
+// A zeroed spinlock is unlocked, so this works before __init_wut_socket
+static OSSpinLock sLock;
+static WUTSocketStats sStats;
+static WUTSocketFdStats sFdStats[WUT_SOCKET_STATS_SOCKETS];
+
+void
+__wut_socket_stats_record(WUTSocketCall call,
+                          int sockfd,
+                          OSTime start,
+                          int rc,
+                          int error)
+{
+   uint64_t us = OSTicksToMicroseconds(OSGetSystemTime() - start);
+   __wut_socket_stats_direction direction = sCallInfo[call].direction;
+   WUTSocketCallStats *stats = &sStats.calls[call];
+   WUTSocketFdStats *fdStats = NULL;
+   uint32_t bucket = 0;
+
+   if (us) {
+      bucket = 31 - __builtin_clz(us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+      if (bucket >= WUT_SOCKET_STATS_BUCKETS) {
+         bucket = WUT_SOCKET_STATS_BUCKETS - 1;
+      }
+   }
+
+   OSUninterruptibleSpinLock_Acquire(&sLock);
+
+   if (sockfd >= 0 && sockfd < WUT_SOCKET_STATS_SOCKETS) {
+      fdStats = &sFdStats[sockfd];
+      if (call == WUT_SOCKET_CALL_SOCKET) {
+         memset(fdStats, 0, sizeof(WUTSocketFdStats));
+         fdStats->open = TRUE;
+      }
+   }
+
+   if (call == WUT_SOCKET_CALL_ACCEPT && rc >= 0 && rc < WUT_SOCKET_STATS_SOCKETS) {
+      memset(&sFdStats[rc], 0, sizeof(WUTSocketFdStats));
+      sFdStats[rc].open = TRUE;
+   }
+
+   stats->calls++;
+   stats->totalUs += us;
+   if (us > stats->maxUs) {
+      stats->maxUs = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+   }
+   stats->latency[bucket]++;
+
+   if (rc < 0 && error == EWOULDBLOCK) {
+      stats->wouldBlock++;
+   } else if (rc < 0) {
+      stats->errors++;
+      sStats.errors[error > 0 && error < WUT_SOCKET_STATS_ERRNO_MAX ? error : 0]++;
+   } else if (direction != SOCKET_STATS_NONE) {
+      stats->bytes += rc;
+   }
+
+   if (fdStats) {
+      fdStats->calls++;
+      fdStats->totalUs += us;
+
+      if (rc < 0 && error == EWOULDBLOCK) {
+         fdStats->wouldBlock++;
+      } else if (rc < 0) {
+         fdStats->errors++;
+      } else if (direction == SOCKET_STATS_RECEIVE) {
+         fdStats->bytesReceived += rc;
+      } else if (direction == SOCKET_STATS_SEND) {
+         fdStats->bytesSent += rc;
+      }
+
+      if (call == WUT_SOCKET_CALL_CLOSE) {
+         fdStats->open = FALSE;
+      }
+   }
+
+   OSUninterruptibleSpinLock_Release(&sLock);
+}
+
+int
+WUTGetSocketStats(WUTSocketStats *outStats)
+{
+   if (!outStats) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   OSUninterruptibleSpinLock_Acquire(&sLock);
+   *outStats = sStats;
+   OSUninterruptibleSpinLock_Release(&sLock);
+   return 0;
+}
+
+int
+WUTGetSocketFdStats(int fd,
+                    WUTSocketFdStats *outStats)
+{
+   int sockfd;
+
+   if (!outStats) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   sockfd = __wut_get_nsysnet_fd(fd);
+   if (sockfd == -1) {
+      return -1;
+   }
+
+   if (sockfd < 0 || sockfd >= WUT_SOCKET_STATS_SOCKETS) {
+      errno = EBADF;
+      return -1;
+   }
+
+   OSUninterruptibleSpinLock_Acquire(&sLock);
+   *outStats = sFdStats[sockfd];
+   OSUninterruptibleSpinLock_Release(&sLock);
+   return 0;
+}
+
+void
+WUTResetSocketStats(void)
+{
+   int i;
+
+   OSUninterruptibleSpinLock_Acquire(&sLock);
+   memset(&sStats, 0, sizeof(sStats));
+   for (i = 0; i < WUT_SOCKET_STATS_SOCKETS; ++i) {
+      BOOL open = sFdStats[i].open;
+      memset(&sFdStats[i], 0, sizeof(WUTSocketFdStats));
+      sFdStats[i].open = open;
+   }
+   OSUninterruptibleSpinLock_Release(&sLock);
+}
+
+static void
+__wut_socket_stats_append(char *buffer,
+                          size_t size,
+                          size_t *length,
+                          const char *format,
+                          ...)
+{
+   va_list args;
+   int rc;
+
+   va_start(args, format);
+   if (*length < size) {
+      rc = vsnprintf(buffer + *length, size - *length, format, args);
+   } else {
+      rc = vsnprintf(NULL, 0, format, args);
+   }
+   va_end(args);
+
+   if (rc > 0) {
+      *length += rc;
+   }
+}
+
+int
+WUTFormatSocketStats(char *buffer,
+                     size_t size)
+{
+   __wut_socket_stats_snapshot *snapshot;
+   WUTSocketStats *stats;
+   size_t length = 0;
+   int i, j;
+
+   if (!buffer && size) {
+      errno = EINVAL;
+      return -1;
+   }
+
+   // Too large for the stack of most threads
+   snapshot = (__wut_socket_stats_snapshot *)malloc(sizeof(__wut_socket_stats_snapshot));
+   if (!snapshot) {
+      errno = ENOMEM;
+      return -1;
+   }
+
+   OSUninterruptibleSpinLock_Acquire(&sLock);
+   snapshot->stats = sStats;
+   memcpy(snapshot->fds, sFdStats, sizeof(sFdStats));
+   OSUninterruptibleSpinLock_Release(&sLock);
+
+   stats = &snapshot->stats;
+
+   if (size) {
+      buffer[0] = '\0';
+   }
+
+   __wut_socket_stats_append(buffer, size, &length,
+                             "%-10s %8s %8s %8s %12s %10s %10s\n",
+                             "call", "calls", "errors", "eagain", "bytes", "avg_us", "max_us");
+   for (i = 0; i < WUT_SOCKET_CALL_COUNT; ++i) {
+      WUTSocketCallStats *call = &stats->calls[i];
+      if (!call->calls) {
+         continue;
+      }
+
+      __wut_socket_stats_append(buffer, size, &length,
+                                "%-10s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %12" PRIu64 " %10" PRIu64 " %10" PRIu32 "\n",
+                                sCallInfo[i].name, call->calls, call->errors,
+                                call->wouldBlock, call->bytes,
+                                call->totalUs / call->calls, call->maxUs);
+   }
+
+   __wut_socket_stats_append(buffer, size, &length, "\nlatency_us\n");
+   for (i = 0; i < WUT_SOCKET_CALL_COUNT; ++i) {
+      WUTSocketCallStats *call = &stats->calls[i];
+      if (!call->calls) {
+         continue;
+      }
+
+      __wut_socket_stats_append(buffer, size, &length, "%-10s", sCallInfo[i].name);
+      for (j = 0; j < WUT_SOCKET_STATS_BUCKETS; ++j) {
+         if (call->latency[j]) {
+            // Bucket j holds calls of at least 2^j microseconds
+            __wut_socket_stats_append(buffer, size, &length, " %s%" PRIu32 ":%" PRIu32,
+                                      j ? ">=" : "<",
+                                      j ? (uint32_t)1 << j : (uint32_t)2,
+                                      call->latency[j]);
+         }
+      }
+      __wut_socket_stats_append(buffer, size, &length, "\n");
+   }
+
+   __wut_socket_stats_append(buffer, size, &length, "\nerrno      count\n");
+   for (i = 0; i < WUT_SOCKET_STATS_ERRNO_MAX; ++i) {
+      if (stats->errors[i]) {
+         __wut_socket_stats_append(buffer, size, &length, "%-10d %" PRIu32 "\n",
+                                   i, stats->errors[i]);
+      }
+   }
+
+   __wut_socket_stats_append(buffer, size, &length,
+                             "\n%4s %2s %8s %8s %8s %12s %12s %12s\n",
+                             "sl", "st", "calls", "errors", "eagain",
+                             "rx_bytes", "tx_bytes", "time_us");
+   for (i = 0; i < WUT_SOCKET_STATS_SOCKETS; ++i) {
+      WUTSocketFdStats *socket = &snapshot->fds[i];
+      if (!socket->calls) {
+         continue;
+      }
+
+      __wut_socket_stats_append(buffer, size, &length,
+                                "%4d %2s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n",
+                                i, socket->open ? "op" : "cl", socket->calls,
+                                socket->errors, socket->wouldBlock,
+                                socket->bytesReceived, socket->bytesSent,
+                                socket->totalUs);
+   }
+
+   free(snapshot);
+   return (int)length;
+}
+
+#else
+
+int
+WUTGetSocketStats(WUTSocketStats *outStats)
+{
+   errno = ENOSYS;
+   return -1;
+}
+
+int
+WUTGetSocketFdStats(int fd,
+                    WUTSocketFdStats *outStats)
+{
+   errno = ENOSYS;
+   return -1;
+}
+
+void
+WUTResetSocketStats(void)
+{
+}
+
+int
+WUTFormatSocketStats(char *buffer,
+                     size_t size)
+{
+   errno = ENOSYS;
+   return -1;
+}
+
+#endif
@@ -6,7 +6,11 @@ __wut_socket_write(struct _reent *r,
                    const char *ptr,
                    size_t len)
 {
-   int sockfd = *(int *)fd;
-   int rc     = RPLWRAP(send)(sockfd, ptr, len, 0);
-   return (ssize_t)__wut_get_nsysnet_result(r, rc);
+   int sockfd   = ((__wut_socket_file *)fd)->sockfd;
+   OSTime start = __wut_socket_stats_start();
+   int rc       = RPLWRAP(send)(sockfd, ptr, len, 0);
+   rc = __wut_get_nsysnet_result(r, rc);
+   __wut_set_nsysnet_blocked(sockfd, rc, r->_errno, TRUE);
+   __wut_socket_stats_record(WUT_SOCKET_CALL_WRITE, sockfd, start, rc, r->_errno);
+   return (ssize_t)rc;
 }
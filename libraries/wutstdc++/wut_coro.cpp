@@ -0,0 +1,428 @@
+#include "wut_gthread.h"
+
+#include <wut_coro.h>
+#include <wut_pool.h>
+#include <wut_thread.h>
+
+#include <gx2/event.h>
+#include <errno.h>
+#include <malloc.h>
+#include <stdlib.h>
+
+#define __WUT_CORO_FRAME_CLASSES     (6)
+#define __WUT_CORO_FRAME_MIN_SIZE    (64)
+#define __WUT_CORO_FRAMES_PER_CHUNK  (32)
+#define __WUT_CORO_FRAME_ALIGN       (16)
+#define __WUT_CORO_POLL_MIN_MS       (1)
+#define __WUT_CORO_POLL_MAX_MS       (16)
+#define __WUT_CORO_GPU_POLL_MAX_MS   (2)
+
+/*
+ * Frames are served from pools of 64 to 2048 bytes, doubling each class,
+ * bigger frames come from the heap.
+ */
+static WUTPool sFramePools[__WUT_CORO_FRAME_CLASSES];
+static __wut_once_t sFramePoolsOnce = __WUT_ONCE_VALUE_INIT;
+
+static void
+__wut_coro_init_frame_pools()
+{
+   for (uint32_t i = 0; i < __WUT_CORO_FRAME_CLASSES; ++i) {
+      WUTInitPool(&sFramePools[i], __WUT_CORO_FRAME_MIN_SIZE << i, __WUT_CORO_FRAME_ALIGN,
+                  __WUT_CORO_FRAMES_PER_CHUNK, 0);
+   }
+}
+
+static int
+__wut_coro_frame_class(std::size_t size)
+{
+   for (int i = 0; i < __WUT_CORO_FRAME_CLASSES; ++i) {
+      if (size <= ((std::size_t)__WUT_CORO_FRAME_MIN_SIZE << i)) {
+         return i;
+      }
+   }
+
+   return -1;
+}
+
+namespace wut
+{
+
+namespace coro
+{
+
+namespace detail
+{
+
+void *
+allocate_frame(std::size_t size)
+{
+   int sizeClass = __wut_coro_frame_class(size);
+   if (sizeClass < 0) {
+      return memalign(__WUT_CORO_FRAME_ALIGN, size);
+   }
+
+   __wut_once(&sFramePoolsOnce, __wut_coro_init_frame_pools);
+   return WUTAllocFromPool(&sFramePools[sizeClass]);
+}
+
+void
+free_frame(void *frame,
+           std::size_t size)
+{
+   int sizeClass = __wut_coro_frame_class(size);
+   if (sizeClass < 0) {
+      free(frame);
+   } else {
+      WUTFreeToPool(&sFramePools[sizeClass], frame);
+   }
+}
+
+} // namespace detail
+
+Executor::Executor()
+{
+   OSInitSpinLock(&mLock);
+   OSInitEventEx(&mWakeEvent, FALSE, OS_EVENT_MODE_AUTO, (char *)"wut::coro::Executor");
+   mPollBackoff = __WUT_CORO_POLL_MIN_MS;
+}
+
+Executor::~Executor()
+{
+   free(mPollFds);
+}
+
+void
+Executor::post(Operation *operation)
+{
+   operation->next = nullptr;
+
+   OSUninterruptibleSpinLock_Acquire(&mLock);
+   if (mTail) {
+      mTail->next = operation;
+   } else {
+      mHead = operation;
+   }
+   mTail = operation;
+   OSUninterruptibleSpinLock_Release(&mLock);
+
+   // The event stays signalled until the executor next waits, so a post
+   // made while it is running is not lost.
+   OSSignalEvent(&mWakeEvent);
+}
+
+void
+Executor::wait_socket(SocketWait *wait)
+{
+   wait->revents  = 0;
+   wait->nextWait = mSocketWaits;
+   mSocketWaits   = wait;
+   mSocketWaitCount++;
+}
+
+void
+Executor::wait_gpu(GpuWait *wait)
+{
+   wait->nextWait = mGpuWaits;
+   mGpuWaits      = wait;
+}
+
+void
+Executor::wait_timer(TimerWait *wait)
+{
+   TimerWait **itr;
+
+   OSUninterruptibleSpinLock_Acquire(&mLock);
+   for (itr = &mTimerWaits; *itr && (*itr)->deadline <= wait->deadline; itr = &(*itr)->nextWait);
+   wait->nextWait = *itr;
+   *itr           = wait;
+   OSUninterruptibleSpinLock_Release(&mLock);
+
+   // Let the executor recalculate how long to sleep
+   OSSignalEvent(&mWakeEvent);
+}
+
+uint32_t
+Executor::run_ready()
+{
+   Operation *operation;
+   uint32_t count = 0;
+
+   // Take the whole list, operations posted while running wait for the next
+   // round so sockets and timestamps are still checked regularly.
+   OSUninterruptibleSpinLock_Acquire(&mLock);
+   operation = mHead;
+   mHead     = nullptr;
+   mTail     = nullptr;
+   OSUninterruptibleSpinLock_Release(&mLock);
+
+   while (operation) {
+      Operation *next = operation->next;
+      operation->complete(operation);
+      operation = next;
+      count++;
+   }
+
+   return count;
+}
+
+/*
+ * poll fails as a whole if any fd is not a usable socket, so find out which
+ * waits are ready or broken by polling each fd on its own.
+ */
+void
+Executor::poll_each_socket()
+{
+   for (uint32_t i = 0; i < mSocketWaitCount; ++i) {
+      if (::poll(&mPollFds[i], 1, 0) < 0) {
+         mPollFds[i].revents = (errno == EBADF || errno == ENOTSOCK) ? POLLNVAL : POLLERR;
+      }
+   }
+}
+
+uint32_t
+Executor::poll_waits()
+{
+   uint32_t count = 0;
+
+   if (mTimerWaits) {
+      OSTime now        = OSGetSystemTime();
+      TimerWait *expired = nullptr;
+
+      OSUninterruptibleSpinLock_Acquire(&mLock);
+      if (mTimerWaits && mTimerWaits->deadline <= now) {
+         TimerWait *last = mTimerWaits;
+         while (last->nextWait && last->nextWait->deadline <= now) {
+            last = last->nextWait;
+         }
+
+         expired        = mTimerWaits;
+         mTimerWaits    = last->nextWait;
+         last->nextWait = nullptr;
+      }
+      OSUninterruptibleSpinLock_Release(&mLock);
+
+      while (expired) {
+         TimerWait *next = expired->nextWait;
+         post(expired);
+         expired = next;
+         count++;
+      }
+   }
+
+   if (mGpuWaits) {
+      OSTime retired  = GX2GetRetiredTimeStamp();
+      GpuWait **itr   = &mGpuWaits;
+
+      while (*itr) {
+         GpuWait *wait = *itr;
+         if (retired >= wait->timestamp) {
+            *itr = wait->nextWait;
+            post(wait);
+            count++;
+         } else {
+            itr = &wait->nextWait;
+         }
+      }
+   }
+
+   if (mSocketWaitCount) {
+      SocketWait *wait;
+      uint32_t i = 0;
+      int ready;
+
+      if (mPollCapacity < mSocketWaitCount) {
+         struct pollfd *fds = (struct pollfd *)realloc(mPollFds, mSocketWaitCount * sizeof(struct pollfd));
+         if (!fds) {
+            return count;
+         }
+
+         mPollFds      = fds;
+         mPollCapacity = mSocketWaitCount;
+      }
+
+      for (wait = mSocketWaits; wait; wait = wait->nextWait, ++i) {
+         mPollFds[i].fd      = wait->fd;
+         mPollFds[i].events  = wait->events;
+         mPollFds[i].revents = 0;
+      }
+
+      ready = ::poll(mPollFds, mSocketWaitCount, 0);
+      if (ready < 0) {
+         poll_each_socket();
+      }
+
+      if (ready != 0) {
+         SocketWait **itr = &mSocketWaits;
+
+         for (i = 0; *itr; ++i) {
+            wait = *itr;
+            if (mPollFds[i].revents) {
+               wait->revents = mPollFds[i].revents;
+               *itr          = wait->nextWait;
+               mSocketWaitCount--;
+               post(wait);
+               count++;
+            } else {
+               itr = &wait->nextWait;
+            }
+         }
+      }
+   }
+
+   return count;
+}
+
+void
+Executor::run()
+{
+   while (!mStopping) {
+      if (run_ready()) {
+         mPollBackoff = __WUT_CORO_POLL_MIN_MS;
+      }
+
+      if (mStopping) {
+         break;
+      }
+
+      if (mSocketWaits || mGpuWaits || mTimerWaits) {
+         OSTime sleepTicks = -1;
+
+         if (poll_waits() || mHead) {
+            mPollBackoff = __WUT_CORO_POLL_MIN_MS;
+            continue;
+         }
+
+         if (mSocketWaits || mGpuWaits) {
+            // Neither poll nor GPU timestamps can wake the executor, so sleep
+            // on the wake event for a while and poll again, backing off the
+            // longer nothing becomes ready.
+            uint32_t sleepMs = mPollBackoff;
+            if (mGpuWaits && sleepMs > __WUT_CORO_GPU_POLL_MAX_MS) {
+               sleepMs = __WUT_CORO_GPU_POLL_MAX_MS;
+            }
+
+            sleepTicks   = (OSTime)OSMillisecondsToTicks(sleepMs);
+            mPollBackoff = mPollBackoff * 2 > __WUT_CORO_POLL_MAX_MS ? __WUT_CORO_POLL_MAX_MS : mPollBackoff * 2;
+         }
+
+         OSUninterruptibleSpinLock_Acquire(&mLock);
+         if (mTimerWaits) {
+            OSTime untilTimer = mTimerWaits->deadline - OSGetSystemTime();
+            if (untilTimer < 0) {
+               untilTimer = 0;
+            }
+
+            if (sleepTicks < 0 || untilTimer < sleepTicks) {
+               sleepTicks = untilTimer;
+            }
+         }
+         OSUninterruptibleSpinLock_Release(&mLock);
+
+         if (sleepTicks < 0) {
+            OSWaitEvent(&mWakeEvent);
+         } else if (sleepTicks > 0) {
+            OSWaitEventWithTimeout(&mWakeEvent, OSTicksToNanoseconds(sleepTicks));
+         }
+      } else if (!mHead) {
+         OSWaitEvent(&mWakeEvent);
+      }
+   }
+}
+
+uint32_t
+Executor::poll()
+{
+   uint32_t count = run_ready();
+
+   if (mSocketWaits || mGpuWaits || mTimerWaits) {
+      poll_waits();
+      count += run_ready();
+   }
+
+   return count;
+}
+
+void
+Executor::stop()
+{
+   mStopping = 1;
+   OSSignalEvent(&mWakeEvent);
+}
+
+void
+Executor::restart()
+{
+   mStopping = 0;
+   OSResetEvent(&mWakeEvent);
+}
+
+static void *
+__wut_coro_executor_main(void *arg)
+{
+   static_cast<Executor *>(arg)->run();
+   return NULL;
+}
+
+PerCoreExecutor::PerCoreExecutor()
+{
+}
+
+PerCoreExecutor::~PerCoreExecutor()
+{
+   stop();
+}
+
+bool
+PerCoreExecutor::start()
+{
+   static const OSThreadAttributes affinity[CoreCount] = {
+      OS_THREAD_ATTRIB_AFFINITY_CPU0,
+      OS_THREAD_ATTRIB_AFFINITY_CPU1,
+      OS_THREAD_ATTRIB_AFFINITY_CPU2,
+   };
+
+   for (uint32_t i = 0; i < CoreCount; ++i) {
+      WUTThreadAttr attr;
+
+      if (mThreads[i]) {
+         continue;
+      }
+
+      WUTInitThreadAttr(&attr);
+      attr.affinity = affinity[i];
+      attr.name     = "wut::coro::PerCoreExecutor";
+
+      mExecutors[i].restart();
+      if (WUTCreateThread(&mThreads[i], &attr, __wut_coro_executor_main, &mExecutors[i]) != 0) {
+         mThreads[i] = NULL;
+         stop();
+         return false;
+      }
+   }
+
+   return true;
+}
+
+void
+PerCoreExecutor::stop()
+{
+   for (uint32_t i = 0; i < CoreCount; ++i) {
+      if (mThreads[i]) {
+         mExecutors[i].stop();
+         OSJoinThread(mThreads[i], NULL);
+         mThreads[i] = NULL;
+      }
+   }
+}
+
+Executor &
+PerCoreExecutor::next()
+{
+   uint32_t index = __atomic_fetch_add(&mNext, 1, __ATOMIC_RELAXED);
+   return mExecutors[index % CoreCount];
+}
+
+} // namespace coro
+
+} // namespace wut
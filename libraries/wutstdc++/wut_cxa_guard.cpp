@@ -0,0 +1,40 @@
+#include "wut_gthread.h"
+
+/*
+ * Guards for function-local statics, replacing the libsupc++ versions so
+ * threads racing on an initialiser sleep instead of spinning. This lives in
+ * its own object so it is only linked in place of libsupc++'s guard.o.
+ *
+ * The generic C++ ABI guard is 64 bits, the compiler only checks the first
+ * byte before calling __cxa_guard_acquire. The second word holds the
+ * __wut_once state.
+ */
+
+static inline __wut_once_t *
+__wut_guard_state(uint64_t *guard)
+{
+   return (__wut_once_t *)guard + 1;
+}
+
+extern "C" int
+__cxa_guard_acquire(uint64_t *guard)
+{
+   if (__atomic_load_n((uint8_t *)guard, __ATOMIC_ACQUIRE)) {
+      return 0;
+   }
+
+   return __wut_once_begin(__wut_guard_state(guard)) ? 1 : 0;
+}
+
+extern "C" void
+__cxa_guard_release(uint64_t *guard)
+{
+   __atomic_store_n((uint8_t *)guard, 1, __ATOMIC_RELEASE);
+   __wut_once_end(__wut_guard_state(guard), __WUT_ONCE_VALUE_DONE);
+}
+
+extern "C" void
+__cxa_guard_abort(uint64_t *guard)
+{
+   __wut_once_end(__wut_guard_state(guard), __WUT_ONCE_VALUE_INIT);
+}
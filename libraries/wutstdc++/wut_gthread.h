@@ -8,12 +8,17 @@
 
 #include "../wutnewlib/wut_thread_specific.h"
 
-#define __WUT_MAX_KEYS               (128)
+#define __WUT_KEYS_PER_BLOCK         (64)
+#define __WUT_MAX_KEY_BLOCKS         (64)
+#define __WUT_MAX_KEYS               (__WUT_KEYS_PER_BLOCK * __WUT_MAX_KEY_BLOCKS)
+#define __WUT_KEY_DESTRUCTOR_ITERATIONS (4)
 #define __WUT_STACK_SIZE             (128 * 1024)
+#define __WUT_THREAD_POOL_SIZE       (4)
 
 #define __WUT_ONCE_VALUE_INIT        (0)
 #define __WUT_ONCE_VALUE_STARTED     (1)
 #define __WUT_ONCE_VALUE_DONE        (2)
+#define __WUT_ONCE_VALUE_WAITERS     (4)
 
 #define __WUT_KEY_THREAD_SPECIFIC_ID WUT_THREAD_SPECIFIC_0
 
@@ -55,6 +60,13 @@ int
 __wut_once(__wut_once_t *once,
            void (*func)(void));
 
+bool
+__wut_once_begin(__wut_once_t *once);
+
+void
+__wut_once_end(__wut_once_t *once,
+               uint32_t result);
+
 void
 __wut_key_cleanup(OSThread *thread);
 
@@ -4,27 +4,228 @@
 #include <sys/errno.h>
 #include <sys/time.h>
 
-#include <coreinit/alarm.h>
+#include <coreinit/event.h>
+#include <coreinit/interrupts.h>
 #include <coreinit/systeminfo.h>
 #include <coreinit/time.h>
 
+#define __WUT_COND_WAITING  (0)
+#define __WUT_COND_SIGNALED (1)
+#define __WUT_COND_TIMEDOUT (2)
+
+/*
+ * Every waiter sleeps on its own auto-reset event, queued in FIFO order on
+ * the condition. Signal wakes exactly one waiter, broadcast wakes them all.
+ *
+ * A waiter leaves the queue either because a signal claimed it or because it
+ * timed out, whichever moves its state away from __WUT_COND_WAITING first.
+ */
+struct __wut_cond_waiter_t
+{
+   __wut_cond_waiter_t *next;
+   volatile uint32_t state;
+   OSEvent event;
+};
+
+struct __wut_cond_t
+{
+   volatile uint32_t lock;
+   __wut_cond_waiter_t *head;
+   __wut_cond_waiter_t *tail;
+};
+static_assert(sizeof(__wut_cond_t) <= sizeof(OSCondition),
+              "__wut_cond_t must fit inside __gthread_cond_t");
+
+static inline __wut_cond_t *
+__wut_cond_from_os(OSCondition *cond)
+{
+   return (__wut_cond_t *)cond;
+}
+
+static inline BOOL
+__wut_cond_lock(__wut_cond_t *cond)
+{
+   // Keep the lock hold time short by not getting preempted while holding it
+   BOOL enabled = OSDisableInterrupts();
+   while (!OSCompareAndSwapAtomic(&cond->lock, 0, 1));
+   return enabled;
+}
+
+static inline void
+__wut_cond_unlock(__wut_cond_t *cond,
+                  BOOL enabled)
+{
+   OSSwapAtomic(&cond->lock, 0);
+   OSRestoreInterrupts(enabled);
+}
+
+static __wut_cond_waiter_t *
+__wut_cond_pop(__wut_cond_t *cond)
+{
+   __wut_cond_waiter_t *waiter;
+
+   while ((waiter = cond->head)) {
+      cond->head = waiter->next;
+      if (!cond->head) {
+         cond->tail = NULL;
+      }
+
+      // Skip waiters which are already on their way out after a timeout
+      if (OSCompareAndSwapAtomic(&waiter->state, __WUT_COND_WAITING, __WUT_COND_SIGNALED)) {
+         return waiter;
+      }
+   }
+
+   return NULL;
+}
+
+static void
+__wut_cond_remove(__wut_cond_t *cond,
+                  __wut_cond_waiter_t *waiter)
+{
+   __wut_cond_waiter_t *prev = NULL, *itr;
+   BOOL enabled              = __wut_cond_lock(cond);
+
+   for (itr = cond->head; itr; prev = itr, itr = itr->next) {
+      if (itr == waiter) {
+         if (prev) {
+            prev->next = itr->next;
+         } else {
+            cond->head = itr->next;
+         }
+
+         if (cond->tail == itr) {
+            cond->tail = prev;
+         }
+         break;
+      }
+   }
+
+   __wut_cond_unlock(cond, enabled);
+}
+
+/*
+ * Release every level of the mutex, returns the recursion count to restore.
+ */
+static int32_t
+__wut_cond_release_mutex(OSMutex *mutex,
+                         bool recursive)
+{
+   int32_t count = recursive ? mutex->count : 1;
+
+   for (int32_t i = 0; i < count; ++i) {
+      OSUnlockMutex(mutex);
+   }
+
+   return count;
+}
+
+static void
+__wut_cond_acquire_mutex(OSMutex *mutex,
+                         int32_t count)
+{
+   for (int32_t i = 0; i < count; ++i) {
+      OSLockMutex(mutex);
+   }
+}
+
+/*
+ * Wait on the condition, timeout is in nanoseconds or negative to wait
+ * forever. Returns 0 when woken by a signal or ETIMEDOUT.
+ */
+static int
+__wut_cond_wait_internal(OSCondition *os_cond,
+                         OSMutex *mutex,
+                         bool recursive,
+                         int64_t timeout)
+{
+   __wut_cond_t *cond = __wut_cond_from_os(os_cond);
+   __wut_cond_waiter_t waiter;
+   int32_t mutexCount;
+   BOOL enabled;
+
+   waiter.next  = NULL;
+   waiter.state = __WUT_COND_WAITING;
+   OSInitEvent(&waiter.event, FALSE, OS_EVENT_MODE_AUTO);
+
+   enabled = __wut_cond_lock(cond);
+   if (cond->tail) {
+      cond->tail->next = &waiter;
+   } else {
+      cond->head = &waiter;
+   }
+   cond->tail = &waiter;
+   __wut_cond_unlock(cond, enabled);
+
+   mutexCount = __wut_cond_release_mutex(mutex, recursive);
+
+   if (timeout < 0) {
+      OSWaitEvent(&waiter.event);
+   } else if (!OSWaitEventWithTimeout(&waiter.event, (OSTime)timeout)) {
+      if (OSCompareAndSwapAtomic(&waiter.state, __WUT_COND_WAITING, __WUT_COND_TIMEDOUT)) {
+         __wut_cond_remove(cond, &waiter);
+      } else {
+         // A signal claimed us just as we timed out, consume its wakeup so
+         // the event is not touched after we return.
+         OSWaitEvent(&waiter.event);
+      }
+   }
+
+   __wut_cond_acquire_mutex(mutex, mutexCount);
+   return (waiter.state == __WUT_COND_TIMEDOUT) ? ETIMEDOUT : 0;
+}
+
 void
 __wut_cond_init_function(OSCondition *cond)
 {
-   OSInitCond(cond);
+   __wut_cond_t *wut_cond = __wut_cond_from_os(cond);
+   wut_cond->lock         = 0;
+   wut_cond->head         = NULL;
+   wut_cond->tail         = NULL;
 }
 
 int
-__wut_cond_broadcast(OSCondition *cond)
+__wut_cond_broadcast(OSCondition *os_cond)
 {
-   OSSignalCond(cond);
+   __wut_cond_t *cond = __wut_cond_from_os(os_cond);
+   __wut_cond_waiter_t *waiters = NULL, *waiter;
+   BOOL enabled;
+
+   enabled = __wut_cond_lock(cond);
+   while ((waiter = __wut_cond_pop(cond))) {
+      waiter->next = waiters;
+      waiters      = waiter;
+   }
+   __wut_cond_unlock(cond, enabled);
+
+   while (waiters) {
+      waiter  = waiters;
+      waiters = waiter->next;
+      OSSignalEvent(&waiter->event);
+   }
+
    return 0;
 }
 
 int
-__wut_cond_signal(OSCondition *cond)
+__wut_cond_signal(OSCondition *os_cond)
 {
-   OSSignalCond(cond);
+   __wut_cond_t *cond = __wut_cond_from_os(os_cond);
+   __wut_cond_waiter_t *waiter;
+   BOOL enabled;
+
+   if (!cond->head) {
+      return 0;
+   }
+
+   enabled = __wut_cond_lock(cond);
+   waiter  = __wut_cond_pop(cond);
+   __wut_cond_unlock(cond, enabled);
+
+   if (waiter) {
+      OSSignalEvent(&waiter->event);
+   }
+
    return 0;
 }
 
@@ -32,32 +233,12 @@ int
 __wut_cond_wait(OSCondition *cond,
                 OSMutex *mutex)
 {
-   OSWaitCond(cond, mutex);
-   return 0;
-}
-
-struct __wut_cond_timedwait_data_t
-{
-   OSCondition *cond;
-   bool timed_out;
-};
-
-static void
-__wut_cond_timedwait_alarm_callback(OSAlarm *alarm,
-                                    OSContext *context)
-{
-   __wut_cond_timedwait_data_t *data = (__wut_cond_timedwait_data_t *)OSGetAlarmUserData(alarm);
-   data->timed_out                   = true;
-   OSSignalCond(data->cond);
+   return __wut_cond_wait_internal(cond, mutex, false, -1);
 }
 
 int
 __wut_cond_timedwait(OSCondition *cond, OSMutex *mutex, const __gthread_time_t *abs_timeout)
 {
-   __wut_cond_timedwait_data_t data;
-   data.timed_out = false;
-   data.cond      = cond;
-
    OSTime time    = OSGetTime();
    OSTime timeout =
       OSSecondsToTicks(abs_timeout->tv_sec - EPOCH_DIFF_SECS(WIIU_OSTIME_EPOCH_YEAR)) +
@@ -68,26 +249,15 @@ __wut_cond_timedwait(OSCondition *cond, OSMutex *mutex, const __gthread_time_t *
       return ETIMEDOUT;
    }
 
-   // Set an alarm
-   OSAlarm alarm;
-   OSCreateAlarm(&alarm);
-   OSSetAlarmUserData(&alarm, &data);
-   OSSetAlarm(&alarm, timeout - time,
-              &__wut_cond_timedwait_alarm_callback);
-
-   // Wait on the condition
-   OSWaitCond(cond, mutex);
-
-   OSCancelAlarm(&alarm);
-   return data.timed_out ? ETIMEDOUT : 0;
+   return __wut_cond_wait_internal(cond, mutex, false,
+                                   (int64_t)OSTicksToNanoseconds(timeout - time));
 }
 
 int
 __wut_cond_wait_recursive(OSCondition *cond,
                           OSMutex *mutex)
 {
-   OSWaitCond(cond, mutex);
-   return 0;
+   return __wut_cond_wait_internal(cond, mutex, true, -1);
 }
 
 int
@@ -4,13 +4,40 @@
 #include <string.h>
 #include <sys/errno.h>
 
+/*
+ * Keys are allocated in blocks on demand. Every key carries a sequence
+ * number which is odd while the key is in use and bumped on create and
+ * delete, per-thread values remember the sequence they were set with so a
+ * recycled key never sees a value left behind by its previous owner.
+ */
 struct __wut_key_table_entry
 {
-   bool in_use;
+   volatile uint32_t seq;
    void (*dtor)(void *);
 };
 
-static __wut_key_table_entry key_table[__WUT_MAX_KEYS];
+struct __wut_key_block
+{
+   __wut_key_table_entry entries[__WUT_KEYS_PER_BLOCK];
+};
+
+struct __wut_key_value
+{
+   uint32_t seq;
+   const void *value;
+};
+
+/*
+ * Per-thread values, only ever accessed by the owning thread so get and set
+ * need no locking.
+ */
+struct __wut_thread_keys
+{
+   uint32_t capacity;
+   __wut_key_value values[];
+};
+
+static __wut_key_block *volatile key_blocks[__WUT_MAX_KEY_BLOCKS];
 
 static OSMutex key_mutex;
 static __wut_once_t init_once_control = __WUT_ONCE_VALUE_INIT;
@@ -19,7 +46,23 @@ static void
 init()
 {
    __wut_mutex_init_function(&key_mutex);
-   memset(key_table, 0, sizeof(key_table));
+}
+
+static inline __wut_key_table_entry *
+__wut_get_key_entry(uint32_t index)
+{
+   __wut_key_block *block;
+
+   if (index >= __WUT_MAX_KEYS) {
+      return NULL;
+   }
+
+   block = key_blocks[index / __WUT_KEYS_PER_BLOCK];
+   if (!block) {
+      return NULL;
+   }
+
+   return &block->entries[index % __WUT_KEYS_PER_BLOCK];
 }
 
 int
@@ -31,15 +74,29 @@ __wut_key_create(__wut_key_t *key,
    __wut_mutex_lock(&key_mutex);
 
    for (uint32_t i = 0; i < __WUT_MAX_KEYS; ++i) {
-      if (key_table[i].in_use) {
+      __wut_key_table_entry *entry = __wut_get_key_entry(i);
+      if (!entry) {
+         __wut_key_block *block = (__wut_key_block *)malloc(sizeof(__wut_key_block));
+         if (!block) {
+            res = ENOMEM;
+            break;
+         }
+
+         // Publish the block only once it is cleared, readers do not lock
+         memset(block, 0, sizeof(__wut_key_block));
+         __atomic_store_n(&key_blocks[i / __WUT_KEYS_PER_BLOCK], block, __ATOMIC_RELEASE);
+         entry = &block->entries[0];
+      }
+
+      if (entry->seq & 1) {
          continue;
       }
 
-      key_table[i].in_use = 1;
-      key_table[i].dtor   = dtor;
+      entry->dtor = dtor;
+      entry->seq  = entry->seq + 1;
 
-      res                 = 0;
-      key->index          = i;
+      res         = 0;
+      key->index  = i;
       break;
    }
 
@@ -50,70 +107,119 @@ __wut_key_create(__wut_key_t *key,
 int
 __wut_key_delete(__wut_key_t key)
 {
+   __wut_key_table_entry *entry = __wut_get_key_entry(key.index);
+   int res                      = EINVAL;
+
    __wut_mutex_lock(&key_mutex);
-   key_table[key.index].in_use = 0;
-   key_table[key.index].dtor   = NULL;
+   if (entry && (entry->seq & 1)) {
+      entry->seq  = entry->seq + 1;
+      entry->dtor = NULL;
+      res         = 0;
+   }
    __wut_mutex_unlock(&key_mutex);
-   return -1;
+   return res;
 }
 
-static const void **
-__wut_get_thread_keys()
+static __wut_thread_keys *
+__wut_get_thread_keys(uint32_t index)
 {
-   const void **keys = (const void **)wut_get_thread_specific(__WUT_KEY_THREAD_SPECIFIC_ID);
-   if (!keys) {
-      keys = (const void **)malloc(sizeof(void *) * sizeof(__WUT_MAX_KEYS));
-      if (!keys) {
-         return NULL;
-      }
+   __wut_thread_keys *keys = (__wut_thread_keys *)wut_get_thread_specific(__WUT_KEY_THREAD_SPECIFIC_ID);
+   uint32_t capacity, oldCapacity = keys ? keys->capacity : 0;
 
-      memset(keys, 0, sizeof(void *) * sizeof(__WUT_MAX_KEYS));
-      wut_set_thread_specific(__WUT_KEY_THREAD_SPECIFIC_ID, keys);
+   if (index < oldCapacity) {
+      return keys;
    }
 
+   // Grow to cover the requested key, rounded up to a whole key block
+   capacity = (index + __WUT_KEYS_PER_BLOCK) & ~(__WUT_KEYS_PER_BLOCK - 1);
+   keys     = (__wut_thread_keys *)realloc(keys, sizeof(__wut_thread_keys) + capacity * sizeof(__wut_key_value));
+   if (!keys) {
+      return NULL;
+   }
+
+   memset(&keys->values[oldCapacity], 0, (capacity - oldCapacity) * sizeof(__wut_key_value));
+   keys->capacity = capacity;
+   wut_set_thread_specific(__WUT_KEY_THREAD_SPECIFIC_ID, keys);
    return keys;
 }
 
 void *
 __wut_getspecific(__wut_key_t key)
 {
-   const void **keys = __wut_get_thread_keys();
-   if (!keys) {
+   __wut_thread_keys *keys = (__wut_thread_keys *)wut_get_thread_specific(__WUT_KEY_THREAD_SPECIFIC_ID);
+   __wut_key_table_entry *entry;
+
+   if (!keys || key.index >= keys->capacity) {
       return NULL;
    }
 
-   return (void *)(keys[key.index]);
+   entry = __wut_get_key_entry(key.index);
+   if (!entry || keys->values[key.index].seq != entry->seq) {
+      return NULL;
+   }
+
+   return (void *)keys->values[key.index].value;
 }
 
 int
 __wut_setspecific(__wut_key_t key,
                   const void *ptr)
 {
-   const void **keys = __wut_get_thread_keys();
+   __wut_key_table_entry *entry = __wut_get_key_entry(key.index);
+   __wut_thread_keys *keys;
+
+   if (!entry || !(entry->seq & 1)) {
+      return EINVAL;
+   }
+
+   keys = __wut_get_thread_keys(key.index);
    if (!keys) {
-      return -1;
+      return ENOMEM;
    }
 
-   keys[key.index] = ptr;
+   keys->values[key.index].seq   = entry->seq;
+   keys->values[key.index].value = ptr;
    return 0;
 }
 
 void
 __wut_key_cleanup(OSThread *thread)
 {
-   void **keys = (void **)wut_get_thread_specific(__WUT_KEY_THREAD_SPECIFIC_ID);
+   __wut_thread_keys *keys = (__wut_thread_keys *)wut_get_thread_specific(__WUT_KEY_THREAD_SPECIFIC_ID);
    if (!keys) {
       return;
    }
 
-   __wut_mutex_lock(&key_mutex);
+   // Like POSIX, keep calling destructors while they set new values, up to
+   // a fixed number of passes.
+   for (int pass = 0; pass < __WUT_KEY_DESTRUCTOR_ITERATIONS; ++pass) {
+      bool called = false;
+
+      for (uint32_t i = 0; i < keys->capacity; ++i) {
+         __wut_key_table_entry *entry = __wut_get_key_entry(i);
+         const void *value            = keys->values[i].value;
+         void (*dtor)(void *);
+
+         if (!entry || !value || keys->values[i].seq != entry->seq) {
+            continue;
+         }
+
+         dtor                  = entry->dtor;
+         keys->values[i].value = NULL;
+         if (dtor) {
+            dtor((void *)value);
+            called = true;
+
+            // The destructor may have grown the array
+            keys = (__wut_thread_keys *)wut_get_thread_specific(__WUT_KEY_THREAD_SPECIFIC_ID);
+         }
+      }
 
-   for (int i = 0; i < __WUT_MAX_KEYS; ++i) {
-      if (key_table[i].in_use && key_table[i].dtor && keys[i]) {
-         key_table[i].dtor(keys[i]);
+      if (!called) {
+         break;
       }
    }
 
-   __wut_mutex_unlock(&key_mutex);
+   wut_set_thread_specific(__WUT_KEY_THREAD_SPECIFIC_ID, NULL);
    free(keys);
 }
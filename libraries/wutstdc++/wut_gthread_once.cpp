@@ -1,22 +1,93 @@
 #include "wut_gthread.h"
 
+#include <coreinit/spinlock.h>
+
+#define __WUT_ONCE_SPIN_COUNT (1000)
+
+/*
+ * Threads waiting for any once or guard to finish sleep on a single shared
+ * condition, initialisers finishing with waiters present wake all of them
+ * and each re-checks its own state.
+ */
+static OSSpinLock sOnceInitLock;
+static bool sOnceWaitInitialised = false;
+static OSMutex sOnceWaitMutex;
+static OSCondition sOnceWaitCond;
+
+static void
+__wut_once_lock_wait()
+{
+   OSUninterruptibleSpinLock_Acquire(&sOnceInitLock);
+   if (!sOnceWaitInitialised) {
+      OSInitMutex(&sOnceWaitMutex);
+      OSInitCond(&sOnceWaitCond);
+      sOnceWaitInitialised = true;
+   }
+   OSUninterruptibleSpinLock_Release(&sOnceInitLock);
+
+   OSLockMutex(&sOnceWaitMutex);
+}
+
+bool
+__wut_once_begin(__wut_once_t *once)
+{
+   uint32_t value = __WUT_ONCE_VALUE_INIT;
+   uint32_t spin  = 0;
+
+   while (true) {
+      if (OSCompareAndSwapAtomicEx(once,
+                                   __WUT_ONCE_VALUE_INIT,
+                                   __WUT_ONCE_VALUE_STARTED,
+                                   &value)) {
+         return true;
+      }
+
+      if (value == __WUT_ONCE_VALUE_DONE) {
+         return false;
+      }
+
+      // Most initialisers are short, give them a moment before sleeping
+      if (spin < __WUT_ONCE_SPIN_COUNT) {
+         spin++;
+         continue;
+      }
+
+      __wut_once_lock_wait();
+      value = *once;
+      while (value != __WUT_ONCE_VALUE_DONE && value != __WUT_ONCE_VALUE_INIT) {
+         if (!(value & __WUT_ONCE_VALUE_WAITERS) &&
+             !OSCompareAndSwapAtomicEx(once, value, value | __WUT_ONCE_VALUE_WAITERS, &value)) {
+            continue;
+         }
+
+         OSWaitCond(&sOnceWaitCond, &sOnceWaitMutex);
+         value = *once;
+      }
+      OSUnlockMutex(&sOnceWaitMutex);
+
+      // Either done, or the initialiser gave up and we may try ourselves
+      value = __WUT_ONCE_VALUE_INIT;
+   }
+}
+
+void
+__wut_once_end(__wut_once_t *once,
+               uint32_t result)
+{
+   if (OSSwapAtomic(once, result) & __WUT_ONCE_VALUE_WAITERS) {
+      __wut_once_lock_wait();
+      OSSignalCond(&sOnceWaitCond);
+      OSUnlockMutex(&sOnceWaitMutex);
+   }
+}
+
 int
 __wut_once(__wut_once_t *once,
            void (*func)(void))
 {
-   uint32_t value = 0;
-
-   if (OSCompareAndSwapAtomicEx(once,
-                                __WUT_ONCE_VALUE_INIT,
-                                __WUT_ONCE_VALUE_STARTED,
-                                &value)) {
+   if (__wut_once_begin(once)) {
       func();
-      OSSwapAtomic(once,
-                   __WUT_ONCE_VALUE_DONE);
-   } else if (value != __WUT_ONCE_VALUE_DONE) {
-      while (!OSCompareAndSwapAtomic(once,
-                                     __WUT_ONCE_VALUE_DONE,
-                                     __WUT_ONCE_VALUE_DONE));
+      __wut_once_end(once, __WUT_ONCE_VALUE_DONE);
    }
 
    return 0;
@@ -1,17 +1,102 @@
 #include "wut_gthread.h"
+#include <wut_thread.h>
 
+#include <coreinit/spinlock.h>
 #include <malloc.h>
 #include <stdint.h>
 #include <string.h>
 #include <sys/errno.h>
 uint32_t __attribute__((weak)) __wut_thread_default_stack_size = __WUT_STACK_SIZE;
 
+/*
+ * Number of finished threads whose OSThread and stack are kept for reuse.
+ */
+uint32_t __attribute__((weak)) __wut_thread_pool_size = __WUT_THREAD_POOL_SIZE;
+
+/*
+ * The OSThread and its stack share one allocation so a pooled thread can be
+ * recycled as a whole.
+ */
+struct __wut_thread_block
+{
+   __wut_thread_block *next;
+   uint32_t stackSize;
+   uint32_t padding[2];
+   OSThread thread;
+};
+
+#define __WUT_THREAD_BLOCK_HEADER_SIZE ((sizeof(__wut_thread_block) + 15) & ~15)
+
+static OSSpinLock sThreadPoolLock;
+static __wut_thread_block *sThreadPool = NULL;
+static uint32_t sThreadPoolCount       = 0;
+
+static __wut_once_t sNextAttrOnce      = __WUT_ONCE_VALUE_INIT;
+static __wut_key_t sNextAttrKey;
+
+static void
+__wut_thread_init_next_attr_key()
+{
+   __wut_key_create(&sNextAttrKey, NULL);
+}
+
+static inline __wut_thread_block *
+__wut_thread_get_block(OSThread *thread)
+{
+   return (__wut_thread_block *)((uint8_t *)thread - offsetof(__wut_thread_block, thread));
+}
+
+static __wut_thread_block *
+__wut_thread_alloc_block(uint32_t stackSize)
+{
+   __wut_thread_block *block = NULL, **prev;
+
+   OSUninterruptibleSpinLock_Acquire(&sThreadPoolLock);
+   for (prev = &sThreadPool; *prev; prev = &(*prev)->next) {
+      if ((*prev)->stackSize == stackSize) {
+         block = *prev;
+         *prev = block->next;
+         sThreadPoolCount--;
+         break;
+      }
+   }
+   OSUninterruptibleSpinLock_Release(&sThreadPoolLock);
+
+   if (!block) {
+      block = (__wut_thread_block *)memalign(16, __WUT_THREAD_BLOCK_HEADER_SIZE + stackSize);
+      if (!block) {
+         return NULL;
+      }
+
+      block->stackSize = stackSize;
+   }
+
+   memset(&block->thread, 0, sizeof(OSThread));
+   return block;
+}
+
+static void
+__wut_thread_free_block(__wut_thread_block *block)
+{
+   OSUninterruptibleSpinLock_Acquire(&sThreadPoolLock);
+   if (sThreadPoolCount < __wut_thread_pool_size) {
+      block->next = sThreadPool;
+      sThreadPool = block;
+      sThreadPoolCount++;
+      block       = NULL;
+   }
+   OSUninterruptibleSpinLock_Release(&sThreadPoolLock);
+
+   if (block) {
+      free(block);
+   }
+}
+
 static void
 __wut_thread_deallocator(OSThread *thread,
                          void *stack)
 {
-   free(thread);
-   free(stack);
+   __wut_thread_free_block(__wut_thread_get_block(thread));
 }
 
 static void
@@ -20,34 +105,36 @@ __wut_thread_cleanup(OSThread *thread, void *stack)
    __wut_key_cleanup(thread);
 }
 
-int
-__wut_thread_create(OSThread **outThread,
-                    void *(*entryPoint)(void *),
-                    void *entryArgs)
+static int
+__wut_thread_create_with_attr(OSThread **outThread,
+                              const WUTThreadAttr *attr,
+                              void *(*entryPoint)(void *),
+                              void *entryArgs)
 {
-   OSThread *thread = (OSThread *)memalign(16, sizeof(OSThread));
-   if (!thread) {
-      return ENOMEM;
+   WUTThreadAttr defaults;
+   if (!attr) {
+      WUTInitThreadAttr(&defaults);
+      attr = &defaults;
    }
 
-   memset(thread, 0, sizeof(OSThread));
-
-   char *stack = (char *)memalign(16, __wut_thread_default_stack_size);
-   if (!stack) {
-      free(thread);
+   uint32_t stackSize = attr->stackSize ? ((attr->stackSize + 15) & ~15) : __wut_thread_default_stack_size;
+   __wut_thread_block *block = __wut_thread_alloc_block(stackSize);
+   if (!block) {
       return ENOMEM;
    }
 
+   OSThread *thread = &block->thread;
+   char *stack      = (char *)block + __WUT_THREAD_BLOCK_HEADER_SIZE;
+
    if (!OSCreateThread(thread,
                        (OSThreadEntryPointFn)entryPoint,
                        (int)entryArgs,
                        NULL,
-                       stack + __wut_thread_default_stack_size,
-                       __wut_thread_default_stack_size,
-                       16,
-                       OS_THREAD_ATTRIB_AFFINITY_ANY)) {
-      free(thread);
-      free(stack);
+                       stack + stackSize,
+                       stackSize,
+                       attr->priority,
+                       attr->affinity)) {
+      __wut_thread_free_block(block);
       return EINVAL;
    }
 
@@ -55,14 +142,34 @@ __wut_thread_create(OSThread **outThread,
    OSSetThreadDeallocator(thread, &__wut_thread_deallocator);
    OSSetThreadCleanupCallback(thread, &__wut_thread_cleanup);
 
-   // Set a thread run quantum to 1 millisecond, to force the threads to
-   // behave more like pre-emptive scheduling rather than co-operative.
-   OSSetThreadRunQuantum(thread, 1000);
+   if (attr->name) {
+      OSSetThreadName(thread, attr->name);
+   }
+
+   // A run quantum forces the threads to behave more like pre-emptive
+   // scheduling rather than co-operative.
+   if (attr->quantum) {
+      OSSetThreadRunQuantum(thread, attr->quantum);
+   }
 
    OSResumeThread(thread);
    return 0;
 }
 
+int
+__wut_thread_create(OSThread **outThread,
+                    void *(*entryPoint)(void *),
+                    void *entryArgs)
+{
+   const WUTThreadAttr *attr = NULL;
+
+   if (sNextAttrOnce == __WUT_ONCE_VALUE_DONE) {
+      attr = (const WUTThreadAttr *)__wut_getspecific(sNextAttrKey);
+   }
+
+   return __wut_thread_create_with_attr(outThread, attr, entryPoint, entryArgs);
+}
+
 int
 __wut_thread_join(OSThread *thread,
                   void **outValue)
@@ -100,3 +207,29 @@ __wut_thread_yield()
    OSYieldThread();
    return 0;
 }
+
+void
+WUTInitThreadAttr(WUTThreadAttr *attr)
+{
+   attr->stackSize = 0;
+   attr->affinity  = OS_THREAD_ATTRIB_AFFINITY_ANY;
+   attr->priority  = 16;
+   attr->quantum   = 1000;
+   attr->name      = NULL;
+}
+
+int
+WUTCreateThread(OSThread **outThread,
+                const WUTThreadAttr *attr,
+                void *(*entryPoint)(void *),
+                void *entryArgs)
+{
+   return __wut_thread_create_with_attr(outThread, attr, entryPoint, entryArgs);
+}
+
+void
+WUTSetNextThreadAttr(const WUTThreadAttr *attr)
+{
+   __wut_once(&sNextAttrOnce, __wut_thread_init_next_attr_key);
+   __wut_setspecific(sNextAttrKey, attr);
+}
@@ -0,0 +1,208 @@
+#include <coreinit/atomic64.h>
+#include <coreinit/spinlock.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * libatomic entry points for the operations Espresso cannot do inline.
+ *
+ * GCC emits calls to these for 64-bit atomics, for example std::atomic of
+ * uint64_t or double, and for atomics of any other size that is not 1, 2 or
+ * 4 bytes. 8-byte operations map onto the coreinit 64-bit atomics, anything
+ * else takes one of a set of spinlocks chosen by hashing the address.
+ *
+ * The definitions use assembler names because GCC does not allow defining
+ * functions with the names of its own builtins.
+ */
+
+#define __WUT_ATOMIC_LOCK_COUNT (64)
+#define __WUT_ATOMIC_LOCK_SHIFT (4)
+
+#define __WUT_ATOMIC_EXPORT(name) __asm__(#name)
+
+static OSSpinLock sAtomicLocks[__WUT_ATOMIC_LOCK_COUNT];
+
+static inline OSSpinLock *
+__wut_atomic_lock(const volatile void *ptr)
+{
+   uint32_t hash = (uint32_t)ptr >> __WUT_ATOMIC_LOCK_SHIFT;
+   hash ^= hash >> 6;
+   return &sAtomicLocks[hash % __WUT_ATOMIC_LOCK_COUNT];
+}
+
+static inline bool
+__wut_atomic_cas_8(volatile void *ptr,
+                   uint64_t *expected,
+                   uint64_t desired)
+{
+   // On failure the value seen by the swap is written back to expected
+   return OSCompareAndSwapAtomicEx64((volatile uint64_t *)ptr, *expected, desired, expected);
+}
+
+uint64_t
+__wut_atomic_load_8(const volatile void *ptr, int model)
+   __WUT_ATOMIC_EXPORT(__atomic_load_8);
+
+uint64_t
+__wut_atomic_load_8(const volatile void *ptr, int model)
+{
+   return OSGetAtomic64((volatile uint64_t *)ptr);
+}
+
+void
+__wut_atomic_store_8(volatile void *ptr, uint64_t value, int model)
+   __WUT_ATOMIC_EXPORT(__atomic_store_8);
+
+void
+__wut_atomic_store_8(volatile void *ptr, uint64_t value, int model)
+{
+   OSSetAtomic64((volatile uint64_t *)ptr, value);
+}
+
+uint64_t
+__wut_atomic_exchange_8(volatile void *ptr, uint64_t value, int model)
+   __WUT_ATOMIC_EXPORT(__atomic_exchange_8);
+
+uint64_t
+__wut_atomic_exchange_8(volatile void *ptr, uint64_t value, int model)
+{
+   return OSSwapAtomic64((volatile uint64_t *)ptr, value);
+}
+
+bool
+__wut_atomic_compare_exchange_8(volatile void *ptr, void *expected, uint64_t desired,
+                                bool weak, int success, int failure)
+   __WUT_ATOMIC_EXPORT(__atomic_compare_exchange_8);
+
+bool
+__wut_atomic_compare_exchange_8(volatile void *ptr, void *expected, uint64_t desired,
+                                bool weak, int success, int failure)
+{
+   return __wut_atomic_cas_8(ptr, (uint64_t *)expected, desired);
+}
+
+/*
+ * fetch_op returns the old value, op_fetch the new one. Add, and, or and xor
+ * have a coreinit equivalent, the rest go through a compare and swap loop.
+ */
+#define __WUT_ATOMIC_OP_8(op, os_op, expr)                                             \
+   uint64_t __wut_atomic_fetch_##op##_8(volatile void *ptr, uint64_t value, int model) \
+      __WUT_ATOMIC_EXPORT(__atomic_fetch_##op##_8);                                    \
+   uint64_t __wut_atomic_##op##_fetch_8(volatile void *ptr, uint64_t value, int model) \
+      __WUT_ATOMIC_EXPORT(__atomic_##op##_fetch_8);                                    \
+                                                                                       \
+   uint64_t                                                                            \
+   __wut_atomic_fetch_##op##_8(volatile void *ptr, uint64_t value, int model)          \
+   {                                                                                   \
+      return os_op;                                                                    \
+   }                                                                                   \
+                                                                                       \
+   uint64_t                                                                            \
+   __wut_atomic_##op##_fetch_8(volatile void *ptr, uint64_t value, int model)          \
+   {                                                                                   \
+      uint64_t old = __wut_atomic_fetch_##op##_8(ptr, value, model);                   \
+      return expr;                                                                     \
+   }
+
+static inline uint64_t
+__wut_atomic_fetch_nand_loop(volatile void *ptr,
+                             uint64_t value)
+{
+   uint64_t old = OSGetAtomic64((volatile uint64_t *)ptr);
+   while (!__wut_atomic_cas_8(ptr, &old, ~(old & value)));
+   return old;
+}
+
+__WUT_ATOMIC_OP_8(add, (uint64_t)OSAddAtomic64((volatile int64_t *)ptr, (int64_t)value), old + value)
+__WUT_ATOMIC_OP_8(sub, (uint64_t)OSAddAtomic64((volatile int64_t *)ptr, -(int64_t)value), old - value)
+__WUT_ATOMIC_OP_8(and, OSAndAtomic64((volatile uint64_t *)ptr, value), old & value)
+__WUT_ATOMIC_OP_8(or, OSOrAtomic64((volatile uint64_t *)ptr, value), old | value)
+__WUT_ATOMIC_OP_8(xor, OSXorAtomic64((volatile uint64_t *)ptr, value), old ^ value)
+__WUT_ATOMIC_OP_8(nand, __wut_atomic_fetch_nand_loop(ptr, value), ~(old & value))
+
+/*
+ * Generic versions for arbitrary sizes.
+ */
+void
+__wut_atomic_load(size_t size, const volatile void *ptr, void *ret, int model)
+   __WUT_ATOMIC_EXPORT(__atomic_load);
+
+void
+__wut_atomic_load(size_t size, const volatile void *ptr, void *ret, int model)
+{
+   OSSpinLock *lock = __wut_atomic_lock(ptr);
+   OSUninterruptibleSpinLock_Acquire(lock);
+   memcpy(ret, (const void *)ptr, size);
+   OSUninterruptibleSpinLock_Release(lock);
+}
+
+void
+__wut_atomic_store(size_t size, volatile void *ptr, void *value, int model)
+   __WUT_ATOMIC_EXPORT(__atomic_store);
+
+void
+__wut_atomic_store(size_t size, volatile void *ptr, void *value, int model)
+{
+   OSSpinLock *lock = __wut_atomic_lock(ptr);
+   OSUninterruptibleSpinLock_Acquire(lock);
+   memcpy((void *)ptr, value, size);
+   OSUninterruptibleSpinLock_Release(lock);
+}
+
+void
+__wut_atomic_exchange(size_t size, volatile void *ptr, void *value, void *ret, int model)
+   __WUT_ATOMIC_EXPORT(__atomic_exchange);
+
+void
+__wut_atomic_exchange(size_t size, volatile void *ptr, void *value, void *ret, int model)
+{
+   OSSpinLock *lock = __wut_atomic_lock(ptr);
+   OSUninterruptibleSpinLock_Acquire(lock);
+   memcpy(ret, (const void *)ptr, size);
+   memcpy((void *)ptr, value, size);
+   OSUninterruptibleSpinLock_Release(lock);
+}
+
+bool
+__wut_atomic_compare_exchange(size_t size, volatile void *ptr, void *expected,
+                              void *desired, int success, int failure)
+   __WUT_ATOMIC_EXPORT(__atomic_compare_exchange);
+
+bool
+__wut_atomic_compare_exchange(size_t size, volatile void *ptr, void *expected,
+                              void *desired, int success, int failure)
+{
+   OSSpinLock *lock = __wut_atomic_lock(ptr);
+   bool result;
+
+   OSUninterruptibleSpinLock_Acquire(lock);
+   result = memcmp((const void *)ptr, expected, size) == 0;
+   if (result) {
+      memcpy((void *)ptr, desired, size);
+   } else {
+      memcpy(expected, (const void *)ptr, size);
+   }
+   OSUninterruptibleSpinLock_Release(lock);
+   return result;
+}
+
+bool
+__wut_atomic_is_lock_free(size_t size, const volatile void *ptr)
+   __WUT_ATOMIC_EXPORT(__atomic_is_lock_free);
+
+bool
+__wut_atomic_is_lock_free(size_t size, const volatile void *ptr)
+{
+   // Only the sizes Espresso handles with lwarx/stwcx. are truly lock free
+   switch (size) {
+   case 1:
+      return true;
+   case 2:
+      return ((uint32_t)ptr & 1) == 0;
+   case 4:
+      return ((uint32_t)ptr & 3) == 0;
+   default:
+      return false;
+   }
+}
@@ -0,0 +1,112 @@
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+
+#include <whb/log.h>
+#include <whb/log_console.h>
+#include <whb/proc.h>
+
+#include <wut_thread.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define INCREMENTS_PER_THREAD 100000
+
+struct Pair
+{
+   uint64_t a;
+   uint64_t b;
+};
+
+static const OSThreadAttributes sCoreAffinity[] = {
+   OS_THREAD_ATTRIB_AFFINITY_CPU0,
+   OS_THREAD_ATTRIB_AFFINITY_CPU1,
+   OS_THREAD_ATTRIB_AFFINITY_CPU2,
+};
+
+static void
+incrementCounter(std::atomic<uint32_t> &counter)
+{
+   counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void
+incrementCounter(std::atomic<uint64_t> &counter)
+{
+   counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void
+incrementCounter(std::atomic<double> &counter)
+{
+   double value = counter.load(std::memory_order_relaxed);
+   while (!counter.compare_exchange_weak(value, value + 1.0, std::memory_order_relaxed));
+}
+
+static void
+incrementCounter(std::atomic<Pair> &counter)
+{
+   Pair value = counter.load(std::memory_order_relaxed);
+   while (!counter.compare_exchange_weak(value, Pair { value.a + 1, value.b + 2 },
+                                         std::memory_order_relaxed));
+}
+
+/*
+ * Every thread is pinned to its own core and hammers the same counter, so
+ * with more than one thread every operation is contended.
+ */
+template<typename Counter>
+static void
+benchCounter(const char *name,
+             int numThreads)
+{
+   std::vector<std::thread> threads;
+   Counter counter {};
+
+   OSTime start = OSGetSystemTime();
+   for (int i = 0; i < numThreads; ++i) {
+      WUTThreadAttr attr;
+      WUTInitThreadAttr(&attr);
+      attr.affinity = sCoreAffinity[i];
+
+      threads.push_back(wut::make_thread(attr, [&counter]() {
+         for (int j = 0; j < INCREMENTS_PER_THREAD; ++j) {
+            incrementCounter(counter);
+         }
+      }));
+   }
+
+   for (auto &thread : threads) {
+      thread.join();
+   }
+
+   uint64_t us  = OSTicksToMicroseconds(OSGetSystemTime() - start);
+   uint32_t ops = numThreads * INCREMENTS_PER_THREAD;
+   WHBLogPrintf("%-8s %d thread(s): %u ops in %llu us (%llu per second, lock free: %s)",
+                name, numThreads, ops, us, us ? (ops * 1000000ull) / us : 0,
+                counter.is_lock_free() ? "yes" : "no");
+}
+
+int
+main(int argc, char **argv)
+{
+   WHBProcInit();
+   WHBLogConsoleInit();
+
+   for (int threads = 1; threads <= 3; ++threads) {
+      benchCounter<std::atomic<uint32_t>>("uint32_t", threads);
+      benchCounter<std::atomic<uint64_t>>("uint64_t", threads);
+      benchCounter<std::atomic<double>>("double", threads);
+      benchCounter<std::atomic<Pair>>("Pair", threads);
+   }
+
+   while (WHBProcIsRunning()) {
+      WHBLogConsoleDraw();
+      OSSleepTicks(OSMillisecondsToTicks(100));
+   }
+
+   WHBLogConsoleFree();
+   WHBProcShutdown();
+   return 0;
+}
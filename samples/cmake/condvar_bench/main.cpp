@@ -0,0 +1,136 @@
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+
+#include <whb/log.h>
+#include <whb/log_console.h>
+#include <whb/proc.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define PING_PONG_ROUNDS   20000
+#define QUEUE_ITEMS        50000
+#define NUM_CONSUMERS      3
+
+static uint64_t
+elapsedUs(OSTime start)
+{
+   return OSTicksToMicroseconds(OSGetSystemTime() - start);
+}
+
+/*
+ * Two threads hand a token back and forth, every round is one notify_one
+ * and one wait on each side.
+ */
+static void
+benchPingPong()
+{
+   std::mutex mutex;
+   std::condition_variable cond;
+   bool ping = true;
+
+   OSTime start = OSGetSystemTime();
+   std::thread other([&]() {
+      for (int i = 0; i < PING_PONG_ROUNDS; ++i) {
+         std::unique_lock<std::mutex> lock(mutex);
+         cond.wait(lock, [&]() { return !ping; });
+         ping = true;
+         cond.notify_one();
+      }
+   });
+
+   for (int i = 0; i < PING_PONG_ROUNDS; ++i) {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&]() { return ping; });
+      ping = false;
+      cond.notify_one();
+   }
+
+   other.join();
+
+   uint64_t us = elapsedUs(start);
+   WHBLogPrintf("ping-pong: %d round trips in %llu us (%llu per second)",
+                PING_PONG_ROUNDS, us, us ? (PING_PONG_ROUNDS * 1000000ull) / us : 0);
+}
+
+/*
+ * One producer feeds several consumers which poll with wait_for, so every
+ * item exercises the timed wait path and a single-waiter notify.
+ */
+static void
+benchProducerConsumer()
+{
+   std::mutex mutex;
+   std::condition_variable cond;
+   std::deque<int> queue;
+   std::vector<std::thread> consumers;
+   bool done          = false;
+   uint32_t timeouts  = 0;
+   uint32_t received  = 0;
+
+   OSTime start = OSGetSystemTime();
+   for (int i = 0; i < NUM_CONSUMERS; ++i) {
+      consumers.emplace_back([&]() {
+         std::unique_lock<std::mutex> lock(mutex);
+         while (true) {
+            if (!cond.wait_for(lock, std::chrono::milliseconds(10),
+                               [&]() { return done || !queue.empty(); })) {
+               timeouts++;
+               continue;
+            }
+
+            if (queue.empty()) {
+               break;
+            }
+
+            queue.pop_front();
+            received++;
+         }
+      });
+   }
+
+   for (int i = 0; i < QUEUE_ITEMS; ++i) {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         queue.push_back(i);
+      }
+      cond.notify_one();
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      done = true;
+   }
+   cond.notify_all();
+
+   for (auto &consumer : consumers) {
+      consumer.join();
+   }
+
+   uint64_t us = elapsedUs(start);
+   WHBLogPrintf("producer/consumer: %u items to %d consumers in %llu us (%llu per second, %u timeouts)",
+                received, NUM_CONSUMERS, us, us ? (received * 1000000ull) / us : 0, timeouts);
+}
+
+int
+main(int argc, char **argv)
+{
+   WHBProcInit();
+   WHBLogConsoleInit();
+
+   benchPingPong();
+   benchProducerConsumer();
+
+   while (WHBProcIsRunning()) {
+      WHBLogConsoleDraw();
+      OSSleepTicks(OSMillisecondsToTicks(100));
+   }
+
+   WHBLogConsoleFree();
+   WHBProcShutdown();
+   return 0;
+}
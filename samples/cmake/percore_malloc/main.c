@@ -0,0 +1,164 @@
+#include <coreinit/core.h>
+#include <coreinit/memdefaultheap.h>
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <whb/log.h>
+#include <whb/log_console.h>
+#include <whb/proc.h>
+
+#define NUM_CORES       3
+#define NUM_SLOTS       256
+#define NUM_ITERATIONS  100000
+#define NUM_REMOTE      4096
+#define THREAD_STACK    (64 * 1024)
+
+/*
+ * Give every core its own 8 MiB heap, see wutmalloc for details. Set this to
+ * 0 to measure the same workload against the shared default heap lock.
+ */
+uint32_t __wut_malloc_per_core_heap_size = 8 * 1024 * 1024;
+
+void
+__init_wut_malloc(void);
+
+typedef enum
+{
+   BENCH_CHURN,
+   BENCH_REMOTE_ALLOC,
+   BENCH_REMOTE_FREE,
+} BenchMode;
+
+static OSThread sThreads[NUM_CORES];
+static uint8_t sStacks[NUM_CORES][THREAD_STACK] __attribute__((aligned(16)));
+static void *sRemoteBlocks[NUM_CORES][NUM_REMOTE];
+static BenchMode sMode;
+static uint32_t sNumThreads;
+
+/*
+ * Keep coreinit's default heap instead of routing it through malloc, which
+ * lets the application use wutmalloc rather than the newlib sbrk heap.
+ */
+void
+__preinit_user(MEMHeapHandle *mem1,
+               MEMHeapHandle *foreground,
+               MEMHeapHandle *mem2)
+{
+   CoreInitDefaultHeap(mem1, foreground, mem2);
+}
+
+static uint32_t
+nextRandom(uint32_t *state)
+{
+   uint32_t x = *state;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   *state = x;
+   return x;
+}
+
+static int
+benchThread(int argc,
+            const char **argv)
+{
+   uint32_t core  = (uint32_t)argc;
+   uint32_t state = 0x9E3779B9u * (core + 1);
+   void *slots[NUM_SLOTS];
+   uint32_t i;
+
+   switch (sMode) {
+   case BENCH_CHURN:
+      memset(slots, 0, sizeof(slots));
+      for (i = 0; i < NUM_ITERATIONS; ++i) {
+         uint32_t slot = nextRandom(&state) % NUM_SLOTS;
+         free(slots[slot]);
+         slots[slot] = malloc(16 + (nextRandom(&state) % 496));
+      }
+
+      for (i = 0; i < NUM_SLOTS; ++i) {
+         free(slots[i]);
+      }
+      break;
+   case BENCH_REMOTE_ALLOC:
+      for (i = 0; i < NUM_REMOTE; ++i) {
+         sRemoteBlocks[core][i] = malloc(16 + (nextRandom(&state) % 496));
+      }
+      break;
+   case BENCH_REMOTE_FREE:
+      // Free the blocks allocated by the neighbouring core
+      for (i = 0; i < NUM_REMOTE; ++i) {
+         free(sRemoteBlocks[(core + 1) % sNumThreads][i]);
+      }
+      break;
+   }
+
+   return 0;
+}
+
+static OSTime
+runBench(BenchMode mode,
+         uint32_t numThreads)
+{
+   OSTime start;
+   uint32_t i;
+
+   sMode       = mode;
+   sNumThreads = numThreads;
+   start       = OSGetSystemTime();
+
+   for (i = 0; i < numThreads; ++i) {
+      OSCreateThread(&sThreads[i], benchThread, (int32_t)i, NULL,
+                     sStacks[i] + THREAD_STACK, THREAD_STACK, 16,
+                     OS_THREAD_ATTRIB_AFFINITY_CPU0 << i);
+      OSResumeThread(&sThreads[i]);
+   }
+
+   for (i = 0; i < numThreads; ++i) {
+      OSJoinThread(&sThreads[i], NULL);
+   }
+
+   return OSGetSystemTime() - start;
+}
+
+static void
+runAll(void)
+{
+   uint32_t n;
+
+   for (n = 1; n <= NUM_CORES && n <= OSGetCoreCount(); ++n) {
+      uint64_t churnUs  = OSTicksToMicroseconds(runBench(BENCH_CHURN, n));
+      uint64_t allocUs  = OSTicksToMicroseconds(runBench(BENCH_REMOTE_ALLOC, n));
+      uint64_t remoteUs = OSTicksToMicroseconds(runBench(BENCH_REMOTE_FREE, n));
+      uint64_t ops      = (uint64_t)NUM_ITERATIONS * 2 * n;
+
+      WHBLogPrintf("%u core(s): churn %llu kops/s, remote free %llu us (alloc %llu us)",
+                   n, churnUs ? (ops * 1000) / churnUs : 0, remoteUs, allocUs);
+   }
+
+   malloc_stats();
+}
+
+int
+main(int argc, char **argv)
+{
+   WHBProcInit();
+   WHBLogConsoleInit();
+
+   __init_wut_malloc();
+
+   WHBLogPrintf("Per-core heap size: 0x%08X", __wut_malloc_per_core_heap_size);
+   runAll();
+
+   while (WHBProcIsRunning()) {
+      WHBLogConsoleDraw();
+      OSSleepTicks(OSMillisecondsToTicks(100));
+   }
+
+   WHBLogConsoleFree();
+   WHBProcShutdown();
+   return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <wut.h>
+#include <coreinit/memheap.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Reserve host memory for a heap. The memory is mapped below 4 GiB so
+ * pointers into it survive the 32-bit casts used by code written for the
+ * console.
+ */
+void *
+hostAllocArena(uint32_t size);
+
+void
+hostFreeArena(void *arena,
+              uint32_t size);
+
+/*
+ * Create an expanded heap with MEM_HEAP_FLAG_USE_LOCK to stand in for the
+ * coreinit default heap and point MEMAllocFromDefaultHeap* at it.
+ */
+MEMHeapHandle
+hostInitDefaultHeap(uint32_t size);
+
+/*
+ * Set the core the calling thread pretends to run on, OSGetCoreId returns
+ * this and OSDisableInterrupts serialises threads assigned to the same core.
+ */
+void
+hostSetCoreId(uint32_t core);
+
+void
+hostLockHeap(MEMHeapHandle heap);
+
+void
+hostUnlockHeap(MEMHeapHandle heap);
+
+#ifdef __cplusplus
+}
+#endif
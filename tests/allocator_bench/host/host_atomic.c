@@ -0,0 +1,73 @@
+#include <coreinit/atomic.h>
+
+BOOL
+OSCompareAndSwapAtomic(volatile uint32_t *ptr,
+                       uint32_t compare,
+                       uint32_t value)
+{
+   return __atomic_compare_exchange_n(ptr, &compare, value, FALSE,
+                                      __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+BOOL
+OSCompareAndSwapAtomicEx(volatile uint32_t *ptr,
+                         uint32_t compare,
+                         uint32_t value,
+                         uint32_t *old)
+{
+   BOOL result = __atomic_compare_exchange_n(ptr, &compare, value, FALSE,
+                                             __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+   *old        = compare;
+   return result;
+}
+
+uint32_t
+OSSwapAtomic(volatile uint32_t *ptr,
+             uint32_t value)
+{
+   return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+int32_t
+OSAddAtomic(volatile int32_t *ptr,
+            int32_t value)
+{
+   return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+uint32_t
+OSAndAtomic(volatile uint32_t *ptr,
+            uint32_t value)
+{
+   return __atomic_fetch_and(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+uint32_t
+OSOrAtomic(volatile uint32_t *ptr,
+           uint32_t value)
+{
+   return __atomic_fetch_or(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+uint32_t
+OSXorAtomic(volatile uint32_t *ptr,
+            uint32_t value)
+{
+   return __atomic_fetch_xor(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+BOOL
+OSTestAndClearAtomic(volatile uint32_t *ptr,
+                     uint32_t bit)
+{
+   uint32_t mask = 1u << bit;
+   return (__atomic_fetch_and(ptr, ~mask, __ATOMIC_SEQ_CST) & mask) != 0;
+}
+
+BOOL
+OSTestAndSetAtomic(volatile uint32_t *ptr,
+                   uint32_t bit)
+{
+   uint32_t mask = 1u << bit;
+   return (__atomic_fetch_or(ptr, mask, __ATOMIC_SEQ_CST) & mask) != 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+/*
+ * Definitions newlib provides on the console that the wut allocator sources
+ * rely on, force-included when building them for the host.
+ */
+#include <stdio.h>
+
+struct _reent
+{
+   int _errno;
+};
+
+#define fiprintf fprintf
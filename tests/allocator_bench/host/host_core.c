@@ -0,0 +1,169 @@
+#include "host.h"
+
+#include <coreinit/core.h>
+#include <coreinit/interrupts.h>
+#include <coreinit/spinlock.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define HOST_NUM_CORES (3)
+
+static pthread_mutex_t sCoreMutex[HOST_NUM_CORES] = {
+   PTHREAD_MUTEX_INITIALIZER,
+   PTHREAD_MUTEX_INITIALIZER,
+   PTHREAD_MUTEX_INITIALIZER,
+};
+
+static volatile uint32_t sNextThreadId     = 1;
+static __thread uint32_t sThreadId         = 0;
+static __thread uint32_t sCoreId           = 1;
+static __thread BOOL sInterruptsDisabled   = FALSE;
+
+static uint32_t
+hostGetThreadId(void)
+{
+   if (!sThreadId) {
+      sThreadId = __atomic_fetch_add(&sNextThreadId, 1, __ATOMIC_SEQ_CST);
+   }
+
+   return sThreadId;
+}
+
+void
+hostSetCoreId(uint32_t core)
+{
+   sCoreId = core % HOST_NUM_CORES;
+}
+
+uint32_t
+OSGetCoreCount()
+{
+   return HOST_NUM_CORES;
+}
+
+uint32_t
+OSGetCoreId()
+{
+   return sCoreId;
+}
+
+uint32_t
+OSGetMainCoreId()
+{
+   return 1;
+}
+
+BOOL
+OSIsMainCore()
+{
+   return sCoreId == 1;
+}
+
+/*
+ * With interrupts disabled nothing else can run on a core, emulate that by
+ * holding a mutex per pretend core.
+ */
+BOOL
+OSDisableInterrupts()
+{
+   if (sInterruptsDisabled) {
+      return FALSE;
+   }
+
+   pthread_mutex_lock(&sCoreMutex[sCoreId]);
+   sInterruptsDisabled = TRUE;
+   return TRUE;
+}
+
+BOOL
+OSEnableInterrupts()
+{
+   BOOL enabled = !sInterruptsDisabled;
+   if (sInterruptsDisabled) {
+      sInterruptsDisabled = FALSE;
+      pthread_mutex_unlock(&sCoreMutex[sCoreId]);
+   }
+
+   return enabled;
+}
+
+BOOL
+OSRestoreInterrupts(BOOL enable)
+{
+   BOOL enabled = !sInterruptsDisabled;
+   if (enable) {
+      OSEnableInterrupts();
+   } else {
+      OSDisableInterrupts();
+   }
+
+   return enabled;
+}
+
+BOOL
+OSIsInterruptEnabled()
+{
+   return !sInterruptsDisabled;
+}
+
+void
+OSInitSpinLock(OSSpinLock *spinlock)
+{
+   spinlock->owner     = 0;
+   spinlock->recursion = 0;
+}
+
+BOOL
+OSTryAcquireSpinLock(OSSpinLock *spinlock)
+{
+   uint32_t self     = hostGetThreadId();
+   uint32_t expected = 0;
+
+   if (__atomic_load_n(&spinlock->owner, __ATOMIC_RELAXED) == self) {
+      spinlock->recursion++;
+      return TRUE;
+   }
+
+   return __atomic_compare_exchange_n(&spinlock->owner, &expected, self, FALSE,
+                                      __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+BOOL
+OSAcquireSpinLock(OSSpinLock *spinlock)
+{
+   while (!OSTryAcquireSpinLock(spinlock)) {
+      sched_yield();
+   }
+
+   return TRUE;
+}
+
+BOOL
+OSReleaseSpinLock(OSSpinLock *spinlock)
+{
+   if (spinlock->recursion) {
+      spinlock->recursion--;
+      return TRUE;
+   }
+
+   __atomic_store_n(&spinlock->owner, 0, __ATOMIC_RELEASE);
+   return TRUE;
+}
+
+BOOL
+OSUninterruptibleSpinLock_Acquire(OSSpinLock *spinlock)
+{
+   return OSAcquireSpinLock(spinlock);
+}
+
+BOOL
+OSUninterruptibleSpinLock_TryAcquire(OSSpinLock *spinlock)
+{
+   return OSTryAcquireSpinLock(spinlock);
+}
+
+BOOL
+OSUninterruptibleSpinLock_Release(OSSpinLock *spinlock)
+{
+   return OSReleaseSpinLock(spinlock);
+}
@@ -0,0 +1,470 @@
+#include "host.h"
+
+#include <coreinit/memexpheap.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * A first-fit expanded heap with the same allocation semantics as coreinit:
+ * positive alignment allocates from the head, negative alignment from the
+ * tail, free blocks are kept in address order and coalesced on free.
+ */
+
+#define HOST_EXP_ALIGN          (8)
+#define HOST_EXP_USED           (1u << 31)
+#define HOST_EXP_FROM_TAIL      (1u << 30)
+#define HOST_EXP_PAD_MASK       (0x00FFFFFFu)
+
+typedef struct HostExpBlock HostExpBlock;
+typedef struct HostExpHeap HostExpHeap;
+
+struct HostExpBlock
+{
+   //! HOST_EXP_USED | HOST_EXP_FROM_TAIL | padding before the header
+   uint32_t attribs;
+
+   //! Bytes available after the header
+   uint32_t size;
+
+   HostExpBlock *prev;
+   HostExpBlock *next;
+};
+
+struct HostExpHeap
+{
+   MEMHeapHeader header;
+   HostExpBlock *freeHead;
+   HostExpBlock *freeTail;
+   MEMExpHeapMode mode;
+   uint16_t groupId;
+};
+
+#define HOST_EXP_HEADER_SIZE ((uintptr_t)sizeof(HostExpBlock))
+#define HOST_EXP_MIN_SPLIT   (HOST_EXP_HEADER_SIZE + HOST_EXP_ALIGN)
+
+static inline uintptr_t
+alignUp(uintptr_t value,
+        uintptr_t align)
+{
+   return (value + align - 1) & ~(align - 1);
+}
+
+static inline uintptr_t
+alignDown(uintptr_t value,
+          uintptr_t align)
+{
+   return value & ~(align - 1);
+}
+
+static inline uintptr_t
+blockStart(HostExpBlock *block)
+{
+   return (uintptr_t)block - (block->attribs & HOST_EXP_PAD_MASK);
+}
+
+static inline uintptr_t
+blockEnd(HostExpBlock *block)
+{
+   return (uintptr_t)block + HOST_EXP_HEADER_SIZE + block->size;
+}
+
+static inline HostExpBlock *
+blockFromPtr(void *ptr)
+{
+   return (HostExpBlock *)((uintptr_t)ptr - HOST_EXP_HEADER_SIZE);
+}
+
+static HostExpBlock *
+makeFreeBlock(uintptr_t start,
+              uintptr_t end)
+{
+   HostExpBlock *block = (HostExpBlock *)start;
+   block->attribs      = 0;
+   block->size         = (uint32_t)(end - start - HOST_EXP_HEADER_SIZE);
+   block->prev         = NULL;
+   block->next         = NULL;
+   return block;
+}
+
+static void
+removeFree(HostExpHeap *heap,
+           HostExpBlock *block)
+{
+   if (block->prev) {
+      block->prev->next = block->next;
+   } else {
+      heap->freeHead = block->next;
+   }
+
+   if (block->next) {
+      block->next->prev = block->prev;
+   } else {
+      heap->freeTail = block->prev;
+   }
+}
+
+static void
+insertFreeAfter(HostExpHeap *heap,
+                HostExpBlock *prev,
+                HostExpBlock *block)
+{
+   block->prev = prev;
+   block->next = prev ? prev->next : heap->freeHead;
+
+   if (block->next) {
+      block->next->prev = block;
+   } else {
+      heap->freeTail = block;
+   }
+
+   if (prev) {
+      prev->next = block;
+   } else {
+      heap->freeHead = block;
+   }
+}
+
+/*
+ * Insert a free region in address order, merging it with its neighbours.
+ */
+static void
+insertFree(HostExpHeap *heap,
+           uintptr_t start,
+           uintptr_t end)
+{
+   HostExpBlock *prev = NULL;
+   HostExpBlock *next = heap->freeHead;
+   HostExpBlock *block;
+
+   while (next && (uintptr_t)next < start) {
+      prev = next;
+      next = next->next;
+   }
+
+   if (next && end == (uintptr_t)next) {
+      end = blockEnd(next);
+      removeFree(heap, next);
+   }
+
+   if (prev && blockEnd(prev) == start) {
+      prev->size = (uint32_t)(end - (uintptr_t)prev - HOST_EXP_HEADER_SIZE);
+      return;
+   }
+
+   block = makeFreeBlock(start, end);
+   insertFreeAfter(heap, prev, block);
+}
+
+static void *
+allocFromHead(HostExpHeap *heap,
+              uint32_t size,
+              uint32_t alignment)
+{
+   HostExpBlock *free;
+
+   for (free = heap->freeHead; free; free = free->next) {
+      uintptr_t start = (uintptr_t)free;
+      uintptr_t end   = blockEnd(free);
+      uintptr_t data  = alignUp(start + HOST_EXP_HEADER_SIZE, alignment);
+      uintptr_t used  = data + size;
+      HostExpBlock *prev, *block;
+
+      if (used > end) {
+         continue;
+      }
+
+      prev = free->prev;
+      removeFree(heap, free);
+
+      // Return unused space at either end to the free list
+      if (alignUp(used, HOST_EXP_ALIGN) + HOST_EXP_MIN_SPLIT <= end) {
+         uintptr_t split = alignUp(used, HOST_EXP_ALIGN);
+         insertFreeAfter(heap, prev, makeFreeBlock(split, end));
+         end = split;
+      }
+
+      if (data - HOST_EXP_HEADER_SIZE - start >= HOST_EXP_MIN_SPLIT) {
+         insertFreeAfter(heap, prev, makeFreeBlock(start, data - HOST_EXP_HEADER_SIZE));
+         start = data - HOST_EXP_HEADER_SIZE;
+      }
+
+      block          = (HostExpBlock *)(data - HOST_EXP_HEADER_SIZE);
+      block->attribs = HOST_EXP_USED | (uint32_t)((uintptr_t)block - start);
+      block->size    = (uint32_t)(end - data);
+      return (void *)data;
+   }
+
+   return NULL;
+}
+
+static void *
+allocFromTail(HostExpHeap *heap,
+              uint32_t size,
+              uint32_t alignment)
+{
+   HostExpBlock *free;
+
+   for (free = heap->freeTail; free; free = free->prev) {
+      uintptr_t start = (uintptr_t)free;
+      uintptr_t end   = blockEnd(free);
+      uintptr_t data, header;
+      HostExpBlock *prev, *block;
+
+      if (end - start < HOST_EXP_HEADER_SIZE + size) {
+         continue;
+      }
+
+      data   = alignDown(end - size, alignment);
+      header = data - HOST_EXP_HEADER_SIZE;
+      if (data < start + HOST_EXP_HEADER_SIZE) {
+         continue;
+      }
+
+      prev = free->prev;
+      removeFree(heap, free);
+
+      if (header - start >= HOST_EXP_MIN_SPLIT) {
+         insertFreeAfter(heap, prev, makeFreeBlock(start, header));
+         start = header;
+      }
+
+      block          = (HostExpBlock *)header;
+      block->attribs = HOST_EXP_USED | HOST_EXP_FROM_TAIL | (uint32_t)(header - start);
+      block->size    = (uint32_t)(end - data);
+      return (void *)data;
+   }
+
+   return NULL;
+}
+
+MEMHeapHandle
+MEMCreateExpHeapEx(void *base,
+                   uint32_t size,
+                   uint16_t flags)
+{
+   uintptr_t start = alignUp((uintptr_t)base, HOST_EXP_ALIGN);
+   uintptr_t end   = alignDown((uintptr_t)base + size, HOST_EXP_ALIGN);
+   HostExpHeap *heap;
+
+   if (end < start + sizeof(HostExpHeap) + HOST_EXP_MIN_SPLIT) {
+      return NULL;
+   }
+
+   heap = (HostExpHeap *)start;
+   memset(heap, 0, sizeof(HostExpHeap));
+   heap->header.tag       = MEM_EXPANDED_HEAP_TAG;
+   heap->header.flags     = flags;
+   heap->header.dataStart = (void *)alignUp(start + sizeof(HostExpHeap), HOST_EXP_ALIGN);
+   heap->header.dataEnd   = (void *)end;
+   heap->mode             = MEM_EXP_HEAP_MODE_FIRST_FREE;
+   OSInitSpinLock(&heap->header.lock);
+
+   insertFree(heap, (uintptr_t)heap->header.dataStart, end);
+   return &heap->header;
+}
+
+void *
+MEMDestroyExpHeap(MEMHeapHandle handle)
+{
+   handle->tag = 0;
+   return handle;
+}
+
+void *
+MEMAllocFromExpHeapEx(MEMHeapHandle handle,
+                      uint32_t size,
+                      int alignment)
+{
+   HostExpHeap *heap = (HostExpHeap *)handle;
+   void *ptr;
+
+   if (size == 0) {
+      size = 1;
+   }
+
+   size = (uint32_t)alignUp(size, HOST_EXP_ALIGN);
+
+   hostLockHeap(handle);
+   if (alignment < 0) {
+      ptr = allocFromTail(heap, size, (uint32_t)-alignment < HOST_EXP_ALIGN ? HOST_EXP_ALIGN : (uint32_t)-alignment);
+   } else {
+      ptr = allocFromHead(heap, size, (uint32_t)alignment < HOST_EXP_ALIGN ? HOST_EXP_ALIGN : (uint32_t)alignment);
+   }
+   hostUnlockHeap(handle);
+
+   if (ptr && (handle->flags & MEM_HEAP_FLAG_ZERO_ALLOCATED)) {
+      memset(ptr, 0, size);
+   }
+
+   return ptr;
+}
+
+void
+MEMFreeToExpHeap(MEMHeapHandle handle,
+                 void *ptr)
+{
+   HostExpBlock *block;
+
+   if (!ptr) {
+      return;
+   }
+
+   block = blockFromPtr(ptr);
+
+   hostLockHeap(handle);
+   insertFree((HostExpHeap *)handle, blockStart(block), blockEnd(block));
+   hostUnlockHeap(handle);
+}
+
+MEMExpHeapMode
+MEMSetAllocModeForExpHeap(MEMHeapHandle handle,
+                          MEMExpHeapMode mode)
+{
+   HostExpHeap *heap       = (HostExpHeap *)handle;
+   MEMExpHeapMode previous = heap->mode;
+   heap->mode              = mode;
+   return previous;
+}
+
+MEMExpHeapMode
+MEMGetAllocModeForExpHeap(MEMHeapHandle handle)
+{
+   return ((HostExpHeap *)handle)->mode;
+}
+
+uint32_t
+MEMResizeForMBlockExpHeap(MEMHeapHandle handle,
+                          void *ptr,
+                          uint32_t size)
+{
+   HostExpHeap *heap   = (HostExpHeap *)handle;
+   HostExpBlock *block = blockFromPtr(ptr);
+   HostExpBlock *next;
+   uintptr_t data      = (uintptr_t)ptr;
+   uintptr_t end;
+   uint32_t result = 0;
+
+   size = (uint32_t)alignUp(size ? size : 1, HOST_EXP_ALIGN);
+
+   hostLockHeap(handle);
+   end = blockEnd(block);
+
+   if (data + size > end) {
+      // Grow into the free block directly after us, if there is one
+      for (next = heap->freeHead; next && (uintptr_t)next < end; next = next->next) {
+      }
+
+      if (next && (uintptr_t)next == end && blockEnd(next) >= data + size) {
+         end = blockEnd(next);
+         removeFree(heap, next);
+      }
+   }
+
+   if (data + size <= end) {
+      if (data + size + HOST_EXP_MIN_SPLIT <= end) {
+         insertFree(heap, data + size, end);
+         end = data + size;
+      }
+
+      block->size = (uint32_t)(end - data);
+      result      = block->size;
+   }
+
+   hostUnlockHeap(handle);
+   return result;
+}
+
+uint32_t
+MEMGetTotalFreeSizeForExpHeap(MEMHeapHandle handle)
+{
+   HostExpHeap *heap = (HostExpHeap *)handle;
+   HostExpBlock *block;
+   uint32_t total = 0;
+
+   hostLockHeap(handle);
+   for (block = heap->freeHead; block; block = block->next) {
+      total += block->size;
+   }
+   hostUnlockHeap(handle);
+   return total;
+}
+
+uint32_t
+MEMGetAllocatableSizeForExpHeapEx(MEMHeapHandle handle,
+                                  int alignment)
+{
+   HostExpHeap *heap = (HostExpHeap *)handle;
+   HostExpBlock *block;
+   uint32_t largest = 0;
+   uintptr_t align;
+
+   if (alignment < 0) {
+      alignment = -alignment;
+   }
+
+   align = (uintptr_t)alignment < HOST_EXP_ALIGN ? HOST_EXP_ALIGN : (uintptr_t)alignment;
+
+   hostLockHeap(handle);
+   for (block = heap->freeHead; block; block = block->next) {
+      uintptr_t data = alignUp((uintptr_t)block + HOST_EXP_HEADER_SIZE, align);
+      uintptr_t end  = blockEnd(block);
+      if (data < end && end - data > largest) {
+         largest = (uint32_t)alignDown(end - data, HOST_EXP_ALIGN);
+      }
+   }
+   hostUnlockHeap(handle);
+   return largest;
+}
+
+uint16_t
+MEMSetGroupIDForExpHeap(MEMHeapHandle handle,
+                        uint16_t id)
+{
+   HostExpHeap *heap = (HostExpHeap *)handle;
+   uint16_t previous = heap->groupId;
+   heap->groupId     = id;
+   return previous;
+}
+
+uint16_t
+MEMGetGroupIDForExpHeap(MEMHeapHandle handle)
+{
+   return ((HostExpHeap *)handle)->groupId;
+}
+
+uint32_t
+MEMGetSizeForMBlockExpHeap(void *ptr)
+{
+   return blockFromPtr(ptr)->size;
+}
+
+uint16_t
+MEMGetGroupIDForMBlockExpHeap(void *ptr)
+{
+   return 0;
+}
+
+MEMExpHeapDirection
+MEMGetAllocDirForMBlockExpHeap(void *ptr)
+{
+   return (blockFromPtr(ptr)->attribs & HOST_EXP_FROM_TAIL) ? MEM_EXP_HEAP_DIR_FROM_BOTTOM : MEM_EXP_HEAP_DIR_FROM_TOP;
+}
+
+BOOL
+MEMCheckExpHeap(MEMHeapHandle handle,
+                MEMExpHeapCheckFlags mode)
+{
+   HostExpHeap *heap = (HostExpHeap *)handle;
+   HostExpBlock *block;
+   BOOL result = TRUE;
+
+   hostLockHeap(handle);
+   for (block = heap->freeHead; block; block = block->next) {
+      if (block->next && blockEnd(block) >= (uintptr_t)block->next) {
+         result = FALSE;
+         break;
+      }
+   }
+   hostUnlockHeap(handle);
+   return result;
+}
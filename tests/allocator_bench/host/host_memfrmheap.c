@@ -0,0 +1,220 @@
+#include "host.h"
+
+#include <coreinit/memfrmheap.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HOST_FRM_ALIGN (4)
+
+typedef struct HostFrmHeap HostFrmHeap;
+
+struct HostFrmHeap
+{
+   MEMHeapHeader header;
+   uintptr_t head;
+   uintptr_t tail;
+   MEMFrmHeapState *previousState;
+};
+
+static inline uintptr_t
+alignUp(uintptr_t value,
+        uintptr_t align)
+{
+   return (value + align - 1) & ~(align - 1);
+}
+
+static inline uintptr_t
+alignDown(uintptr_t value,
+          uintptr_t align)
+{
+   return value & ~(align - 1);
+}
+
+MEMHeapHandle
+MEMCreateFrmHeapEx(void *base,
+                   uint32_t size,
+                   uint32_t flags)
+{
+   uintptr_t start = alignUp((uintptr_t)base, HOST_FRM_ALIGN);
+   uintptr_t end   = alignDown((uintptr_t)base + size, HOST_FRM_ALIGN);
+   HostFrmHeap *heap;
+
+   if (end < start + sizeof(HostFrmHeap)) {
+      return NULL;
+   }
+
+   heap = (HostFrmHeap *)start;
+   memset(heap, 0, sizeof(HostFrmHeap));
+   heap->header.tag       = MEM_FRAME_HEAP_TAG;
+   heap->header.flags     = flags;
+   heap->header.dataStart = (void *)alignUp(start + sizeof(HostFrmHeap), HOST_FRM_ALIGN);
+   heap->header.dataEnd   = (void *)end;
+   heap->head             = (uintptr_t)heap->header.dataStart;
+   heap->tail             = end;
+   OSInitSpinLock(&heap->header.lock);
+   return &heap->header;
+}
+
+void *
+MEMDestroyFrmHeap(MEMHeapHandle handle)
+{
+   handle->tag = 0;
+   return handle;
+}
+
+void *
+MEMAllocFromFrmHeapEx(MEMHeapHandle handle,
+                      uint32_t size,
+                      int alignment)
+{
+   HostFrmHeap *heap = (HostFrmHeap *)handle;
+   uintptr_t ptr     = 0;
+
+   if (size == 0) {
+      size = 1;
+   }
+
+   hostLockHeap(handle);
+   if (alignment < 0) {
+      uintptr_t start = alignDown(heap->tail - size, (uintptr_t)-alignment);
+      if (heap->tail - heap->head >= size && start >= heap->head) {
+         heap->tail = start;
+         ptr        = start;
+      }
+   } else {
+      uintptr_t start = alignUp(heap->head, alignment ? (uintptr_t)alignment : HOST_FRM_ALIGN);
+      if (start + size <= heap->tail) {
+         heap->head = start + size;
+         ptr        = start;
+      }
+   }
+   hostUnlockHeap(handle);
+
+   if (ptr && (handle->flags & MEM_HEAP_FLAG_ZERO_ALLOCATED)) {
+      memset((void *)ptr, 0, size);
+   }
+
+   return (void *)ptr;
+}
+
+void
+MEMFreeToFrmHeap(MEMHeapHandle handle,
+                 MEMFrmHeapFreeMode mode)
+{
+   HostFrmHeap *heap = (HostFrmHeap *)handle;
+
+   hostLockHeap(handle);
+   if (mode & MEM_FRM_HEAP_FREE_HEAD) {
+      heap->head          = (uintptr_t)handle->dataStart;
+      heap->previousState = NULL;
+   }
+
+   if (mode & MEM_FRM_HEAP_FREE_TAIL) {
+      heap->tail = (uintptr_t)handle->dataEnd;
+   }
+   hostUnlockHeap(handle);
+}
+
+BOOL
+MEMRecordStateForFrmHeap(MEMHeapHandle handle,
+                         uint32_t tag)
+{
+   HostFrmHeap *heap = (HostFrmHeap *)handle;
+   uintptr_t head    = heap->head;
+   MEMFrmHeapState *state;
+
+   state = (MEMFrmHeapState *)MEMAllocFromFrmHeapEx(handle, sizeof(MEMFrmHeapState), 4);
+   if (!state) {
+      return FALSE;
+   }
+
+   hostLockHeap(handle);
+   state->tag          = tag;
+   state->head         = (void *)head;
+   state->tail         = (void *)heap->tail;
+   state->previous     = heap->previousState;
+   heap->previousState = state;
+   hostUnlockHeap(handle);
+   return TRUE;
+}
+
+BOOL
+MEMFreeByStateToFrmHeap(MEMHeapHandle handle,
+                        uint32_t tag)
+{
+   HostFrmHeap *heap = (HostFrmHeap *)handle;
+   MEMFrmHeapState *state;
+   BOOL result = FALSE;
+
+   hostLockHeap(handle);
+   for (state = heap->previousState; state; state = state->previous) {
+      if (tag == 0 || state->tag == tag) {
+         heap->head          = (uintptr_t)state->head;
+         heap->tail          = (uintptr_t)state->tail;
+         heap->previousState = state->previous;
+         result              = TRUE;
+         break;
+      }
+   }
+   hostUnlockHeap(handle);
+   return result;
+}
+
+uint32_t
+MEMAdjustFrmHeap(MEMHeapHandle handle)
+{
+   HostFrmHeap *heap = (HostFrmHeap *)handle;
+   uint32_t size;
+
+   hostLockHeap(handle);
+   if (heap->tail != (uintptr_t)handle->dataEnd) {
+      // Cannot shrink while there are allocations at the tail
+      size = 0;
+   } else {
+      handle->dataEnd = (void *)heap->head;
+      heap->tail      = heap->head;
+      size            = (uint32_t)(heap->head - (uintptr_t)heap);
+   }
+   hostUnlockHeap(handle);
+   return size;
+}
+
+uint32_t
+MEMResizeForMBlockFrmHeap(MEMHeapHandle handle,
+                          uint32_t addr,
+                          uint32_t size)
+{
+   HostFrmHeap *heap = (HostFrmHeap *)handle;
+   uint32_t result   = 0;
+
+   hostLockHeap(handle);
+   // Only the most recent head allocation can be resized
+   if (addr >= (uintptr_t)handle->dataStart && addr < heap->head &&
+       (uintptr_t)addr + size <= heap->tail) {
+      heap->head = (uintptr_t)addr + size;
+      result     = size;
+   }
+   hostUnlockHeap(handle);
+   return result;
+}
+
+uint32_t
+MEMGetAllocatableSizeForFrmHeapEx(MEMHeapHandle handle,
+                                  int alignment)
+{
+   HostFrmHeap *heap = (HostFrmHeap *)handle;
+   uintptr_t start;
+   uint32_t size = 0;
+
+   if (alignment < 0) {
+      alignment = -alignment;
+   }
+
+   hostLockHeap(handle);
+   start = alignUp(heap->head, alignment ? (uintptr_t)alignment : HOST_FRM_ALIGN);
+   if (start < heap->tail) {
+      size = (uint32_t)(heap->tail - start);
+   }
+   hostUnlockHeap(handle);
+   return size;
+}
@@ -0,0 +1,123 @@
+#include "host.h"
+
+#include <coreinit/memdefaultheap.h>
+#include <coreinit/memexpheap.h>
+#include <coreinit/spinlock.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#ifndef MAP_32BIT
+#define MAP_32BIT 0
+#endif
+
+MEMAllocFromDefaultHeapFn MEMAllocFromDefaultHeap     = NULL;
+MEMAllocFromDefaultHeapExFn MEMAllocFromDefaultHeapEx = NULL;
+MEMFreeToDefaultHeapFn MEMFreeToDefaultHeap           = NULL;
+
+static MEMHeapHandle sBaseHeaps[MEM_BASE_HEAP_FG + 1];
+static MEMHeapHandle sDefaultHeap = NULL;
+
+void *
+hostAllocArena(uint32_t size)
+{
+   void *arena = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+   if (arena == MAP_FAILED) {
+      return NULL;
+   }
+
+   if ((uintptr_t)arena + size > 0x100000000ull) {
+      // Console code stores pointers in 32-bit integers
+      munmap(arena, size);
+      return NULL;
+   }
+
+   return arena;
+}
+
+void
+hostFreeArena(void *arena,
+              uint32_t size)
+{
+   munmap(arena, size);
+}
+
+void
+hostLockHeap(MEMHeapHandle heap)
+{
+   if (heap->flags & MEM_HEAP_FLAG_USE_LOCK) {
+      OSUninterruptibleSpinLock_Acquire(&heap->lock);
+   }
+}
+
+void
+hostUnlockHeap(MEMHeapHandle heap)
+{
+   if (heap->flags & MEM_HEAP_FLAG_USE_LOCK) {
+      OSUninterruptibleSpinLock_Release(&heap->lock);
+   }
+}
+
+static void *
+hostAllocFromDefaultHeap(uint32_t size)
+{
+   return MEMAllocFromExpHeapEx(sDefaultHeap, size, 4);
+}
+
+static void *
+hostAllocFromDefaultHeapEx(uint32_t size,
+                           int32_t alignment)
+{
+   return MEMAllocFromExpHeapEx(sDefaultHeap, size, alignment);
+}
+
+static void
+hostFreeToDefaultHeap(void *ptr)
+{
+   MEMFreeToExpHeap(sDefaultHeap, ptr);
+}
+
+MEMHeapHandle
+hostInitDefaultHeap(uint32_t size)
+{
+   void *arena = hostAllocArena(size);
+   if (!arena) {
+      return NULL;
+   }
+
+   sDefaultHeap = MEMCreateExpHeapEx(arena, size, MEM_HEAP_FLAG_USE_LOCK);
+   if (!sDefaultHeap) {
+      hostFreeArena(arena, size);
+      return NULL;
+   }
+
+   MEMAllocFromDefaultHeap          = hostAllocFromDefaultHeap;
+   MEMAllocFromDefaultHeapEx        = hostAllocFromDefaultHeapEx;
+   MEMFreeToDefaultHeap             = hostFreeToDefaultHeap;
+   sBaseHeaps[MEM_BASE_HEAP_MEM2]   = sDefaultHeap;
+   return sDefaultHeap;
+}
+
+MEMHeapHandle
+MEMGetBaseHeapHandle(MEMBaseHeapType type)
+{
+   if (type > MEM_BASE_HEAP_FG) {
+      return NULL;
+   }
+
+   return sBaseHeaps[type];
+}
+
+MEMHeapHandle
+MEMSetBaseHeapHandle(MEMBaseHeapType type,
+                     MEMHeapHandle handle)
+{
+   MEMHeapHandle previous;
+   if (type > MEM_BASE_HEAP_FG) {
+      return NULL;
+   }
+
+   previous         = sBaseHeaps[type];
+   sBaseHeaps[type] = handle;
+   return previous;
+}
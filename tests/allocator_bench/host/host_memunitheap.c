@@ -0,0 +1,124 @@
+#include "host.h"
+
+#include <coreinit/memunitheap.h>
+#include <stdint.h>
+#include <string.h>
+
+static inline uintptr_t
+alignUp(uintptr_t value,
+        uintptr_t align)
+{
+   return (value + align - 1) & ~(align - 1);
+}
+
+MEMHeapHandle
+MEMCreateUnitHeapEx(void *base,
+                    uint32_t size,
+                    uint32_t blockSize,
+                    int32_t alignment,
+                    uint16_t flags)
+{
+   uintptr_t start = alignUp((uintptr_t)base, 4);
+   uintptr_t end   = (uintptr_t)base + size;
+   uintptr_t align = (alignment > (int32_t)sizeof(void *)) ? (uintptr_t)alignment : sizeof(void *);
+   MEMUnitHeap *heap;
+   MEMUnitHeapFreeBlock **last;
+   uintptr_t block;
+
+   if (end < start + sizeof(MEMUnitHeap)) {
+      return NULL;
+   }
+
+   heap = (MEMUnitHeap *)start;
+   memset(heap, 0, sizeof(MEMUnitHeap));
+   heap->header.tag       = MEM_UNIT_HEAP_TAG;
+   heap->header.flags     = flags;
+   heap->header.dataStart = (void *)alignUp(start + sizeof(MEMUnitHeap), align);
+   heap->header.dataEnd   = (void *)end;
+   heap->blockSize        = (uint32_t)alignUp(blockSize < sizeof(void *) ? sizeof(void *) : blockSize, align);
+   OSInitSpinLock(&heap->header.lock);
+
+   last = &heap->freeBlocks;
+   for (block = (uintptr_t)heap->header.dataStart; block + heap->blockSize <= end; block += heap->blockSize) {
+      *last = (MEMUnitHeapFreeBlock *)block;
+      last  = &(*last)->next;
+   }
+
+   *last = NULL;
+   return &heap->header;
+}
+
+void *
+MEMDestroyUnitHeap(MEMHeapHandle handle)
+{
+   handle->tag = 0;
+   return handle;
+}
+
+void *
+MEMAllocFromUnitHeap(MEMHeapHandle handle)
+{
+   MEMUnitHeap *heap = (MEMUnitHeap *)handle;
+   MEMUnitHeapFreeBlock *block;
+
+   hostLockHeap(handle);
+   block = heap->freeBlocks;
+   if (block) {
+      heap->freeBlocks = block->next;
+   }
+   hostUnlockHeap(handle);
+
+   if (block && (handle->flags & MEM_HEAP_FLAG_ZERO_ALLOCATED)) {
+      memset(block, 0, heap->blockSize);
+   }
+
+   return block;
+}
+
+void
+MEMFreeToUnitHeap(MEMHeapHandle handle,
+                  void *ptr)
+{
+   MEMUnitHeap *heap = (MEMUnitHeap *)handle;
+   MEMUnitHeapFreeBlock *block;
+
+   if (!ptr) {
+      return;
+   }
+
+   block = (MEMUnitHeapFreeBlock *)ptr;
+
+   hostLockHeap(handle);
+   block->next      = heap->freeBlocks;
+   heap->freeBlocks = block;
+   hostUnlockHeap(handle);
+}
+
+void
+MEMiDumpUnitHeap(MEMHeapHandle handle)
+{
+}
+
+uint32_t
+MEMCountFreeBlockForUnitHeap(MEMHeapHandle handle)
+{
+   MEMUnitHeap *heap = (MEMUnitHeap *)handle;
+   MEMUnitHeapFreeBlock *block;
+   uint32_t count = 0;
+
+   hostLockHeap(handle);
+   for (block = heap->freeBlocks; block; block = block->next) {
+      count++;
+   }
+   hostUnlockHeap(handle);
+   return count;
+}
+
+uint32_t
+MEMCalcHeapSizeForUnitHeap(uint32_t blockSize,
+                           uint32_t count,
+                           int32_t alignment)
+{
+   uintptr_t align = (alignment > (int32_t)sizeof(void *)) ? (uintptr_t)alignment : sizeof(void *);
+   return (uint32_t)(sizeof(MEMUnitHeap) + align + alignUp(blockSize, align) * count);
+}
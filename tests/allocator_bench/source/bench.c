@@ -0,0 +1,291 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define CHURN_SLOTS         512
+#define CHURN_ITERATIONS    20000
+#define RING_SIZE           1024
+#define PRODUCER_BLOCKS     20000
+#define REALLOC_BUFFERS     64
+#define REALLOC_MAX_SIZE    (256 * 1024)
+#define AGING_ROUNDS        200
+#define AGING_BATCH         64
+#define AGING_MAX_LIVE      2048
+#define MAX_THREADS         8
+
+typedef struct
+{
+   const BenchAllocator *allocator;
+   uint32_t iterations;
+} ChurnContext;
+
+typedef struct
+{
+   const BenchAllocator *allocator;
+   uint32_t count;
+   void *volatile ring[RING_SIZE];
+   volatile uint32_t head;
+   volatile uint32_t tail;
+} RingContext;
+
+static uint32_t
+nextRandom(uint32_t *state)
+{
+   uint32_t x = *state;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   *state = x;
+   return x;
+}
+
+/*
+ * Mostly small objects with the occasional larger buffer.
+ */
+static size_t
+randomSize(uint32_t *state)
+{
+   uint32_t r = nextRandom(state);
+   if ((r & 0xF) < 13) {
+      return 16 + ((r >> 4) % 240);
+   }
+
+   return 256 + ((r >> 4) % 8192);
+}
+
+static void
+report(const BenchAllocator *allocator,
+       const char *name,
+       uint32_t threads,
+       uint64_t ops,
+       uint64_t ns,
+       uint64_t extra)
+{
+   char line[256];
+   uint64_t opsPerSec = ns ? (ops * 1000000000ull) / ns : 0;
+
+   snprintf(line, sizeof(line), "%s,%s,%u,%llu,%llu,%llu,%llu",
+            allocator->name, name, (unsigned int)threads,
+            (unsigned long long)ops, (unsigned long long)ns,
+            (unsigned long long)opsPerSec, (unsigned long long)extra);
+   benchOutput(line);
+}
+
+static void
+churnThread(uint32_t index,
+            void *context)
+{
+   ChurnContext *ctx = (ChurnContext *)context;
+   uint32_t state    = 0x9E3779B9u * (index + 1);
+   void *slots[CHURN_SLOTS];
+   uint32_t i;
+
+   memset(slots, 0, sizeof(slots));
+
+   for (i = 0; i < ctx->iterations; ++i) {
+      uint32_t slot = nextRandom(&state) % CHURN_SLOTS;
+      ctx->allocator->free(slots[slot]);
+      slots[slot] = ctx->allocator->alloc(randomSize(&state));
+   }
+
+   for (i = 0; i < CHURN_SLOTS; ++i) {
+      ctx->allocator->free(slots[i]);
+   }
+}
+
+static void
+benchChurn(const BenchAllocator *allocator,
+           uint32_t scale,
+           uint32_t threads)
+{
+   ChurnContext ctx;
+   uint64_t start;
+
+   ctx.allocator  = allocator;
+   ctx.iterations = CHURN_ITERATIONS * scale;
+
+   start          = benchGetTimeNs();
+   benchRunThreads(threads, churnThread, &ctx);
+   report(allocator, "churn", threads, (uint64_t)ctx.iterations * 2 * threads,
+          benchGetTimeNs() - start, 0);
+}
+
+static void
+producerConsumerThread(uint32_t index,
+                       void *context)
+{
+   RingContext *ctx = (RingContext *)context;
+   uint32_t state   = 0x12345678u;
+   uint32_t i;
+
+   for (i = 0; i < ctx->count; ++i) {
+      if (index == 0) {
+         uint32_t head = __atomic_load_n(&ctx->head, __ATOMIC_RELAXED);
+         void *ptr     = ctx->allocator->alloc(randomSize(&state));
+
+         while (head - __atomic_load_n(&ctx->tail, __ATOMIC_ACQUIRE) >= RING_SIZE) {
+            benchYield();
+         }
+
+         ctx->ring[head % RING_SIZE] = ptr;
+         __atomic_store_n(&ctx->head, head + 1, __ATOMIC_RELEASE);
+      } else {
+         uint32_t tail = __atomic_load_n(&ctx->tail, __ATOMIC_RELAXED);
+
+         while (__atomic_load_n(&ctx->head, __ATOMIC_ACQUIRE) == tail) {
+            benchYield();
+         }
+
+         ctx->allocator->free(ctx->ring[tail % RING_SIZE]);
+         __atomic_store_n(&ctx->tail, tail + 1, __ATOMIC_RELEASE);
+      }
+   }
+}
+
+static void
+benchProducerConsumer(const BenchAllocator *allocator,
+                      uint32_t scale)
+{
+   static RingContext ctx;
+   uint64_t start;
+
+   memset(&ctx, 0, sizeof(ctx));
+   ctx.allocator = allocator;
+   ctx.count     = PRODUCER_BLOCKS * scale;
+
+   start         = benchGetTimeNs();
+   benchRunThreads(2, producerConsumerThread, &ctx);
+   report(allocator, "producer_consumer", 2, (uint64_t)ctx.count * 2,
+          benchGetTimeNs() - start, 0);
+}
+
+static void
+benchReallocGrowth(const BenchAllocator *allocator,
+                   uint32_t scale)
+{
+   void *buffers[REALLOC_BUFFERS];
+   uint64_t ops = 0, failed = 0, start;
+   uint32_t round, i;
+
+   start = benchGetTimeNs();
+
+   for (round = 0; round < scale; ++round) {
+      size_t size = 16;
+      memset(buffers, 0, sizeof(buffers));
+
+      // Grow all buffers in lockstep so their growth interleaves
+      while (size <= REALLOC_MAX_SIZE) {
+         for (i = 0; i < REALLOC_BUFFERS; ++i) {
+            void *ptr = allocator->realloc(buffers[i], size);
+            if (!ptr) {
+               failed++;
+               continue;
+            }
+
+            buffers[i] = ptr;
+            ops++;
+         }
+
+         size += size / 4 + 16;
+      }
+
+      for (i = 0; i < REALLOC_BUFFERS; ++i) {
+         allocator->free(buffers[i]);
+      }
+   }
+
+   report(allocator, "realloc_growth", 1, ops, benchGetTimeNs() - start, failed);
+}
+
+/*
+ * Find the largest single allocation that currently succeeds, no block can
+ * be larger than the free size of the heap.
+ */
+static size_t
+largestAllocation(const BenchAllocator *allocator)
+{
+   size_t low = 0, high = allocator->freeSize();
+
+   while (low < high) {
+      size_t mid = low + (high - low + 1) / 2;
+      void *ptr  = allocator->alloc(mid);
+      if (ptr) {
+         allocator->free(ptr);
+         low = mid;
+      } else {
+         high = mid - 1;
+      }
+   }
+
+   return low;
+}
+
+static void
+benchFragmentationAging(const BenchAllocator *allocator,
+                        uint32_t scale)
+{
+   static void *live[AGING_MAX_LIVE];
+   void *batch[AGING_BATCH];
+   uint32_t state = 0xCAFEF00Du;
+   uint32_t numLive = 0, round, i;
+   uint64_t ops = 0, start, ns;
+
+   start = benchGetTimeNs();
+
+   for (round = 0; round < AGING_ROUNDS * scale; ++round) {
+      for (i = 0; i < AGING_BATCH; ++i) {
+         batch[i] = allocator->alloc(randomSize(&state) * ((nextRandom(&state) & 7) + 1));
+         ops++;
+      }
+
+      // Keep a few blocks alive for the rest of the run, replacing random
+      // ones once the live set is full.
+      for (i = 0; i < AGING_BATCH; ++i) {
+         if ((nextRandom(&state) & 15) == 0) {
+            if (numLive < AGING_MAX_LIVE) {
+               live[numLive++] = batch[i];
+            } else {
+               uint32_t slot = nextRandom(&state) % AGING_MAX_LIVE;
+               allocator->free(live[slot]);
+               live[slot] = batch[i];
+            }
+         } else {
+            allocator->free(batch[i]);
+         }
+         ops++;
+      }
+   }
+
+   ns = benchGetTimeNs() - start;
+   report(allocator, "fragmentation_aging", 1, ops, ns, largestAllocation(allocator));
+
+   for (i = 0; i < numLive; ++i) {
+      allocator->free(live[i]);
+   }
+}
+
+void
+benchPrintHeader(void)
+{
+   benchOutput("allocator,case,threads,ops,ns,ops_per_sec,extra");
+}
+
+void
+benchRunAll(const BenchAllocator *allocator,
+            uint32_t scale)
+{
+   uint32_t threads, cores = benchGetCoreCount();
+
+   if (cores > MAX_THREADS) {
+      cores = MAX_THREADS;
+   }
+
+   for (threads = 1; threads <= cores; ++threads) {
+      benchChurn(allocator, scale, threads);
+   }
+
+   benchProducerConsumer(allocator, scale);
+   benchReallocGrowth(allocator, scale);
+   benchFragmentationAging(allocator, scale);
+}
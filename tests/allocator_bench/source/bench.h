@@ -0,0 +1,60 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct BenchAllocator BenchAllocator;
+
+struct BenchAllocator
+{
+   const char *name;
+   void *(*alloc)(size_t size);
+   void *(*realloc)(void *ptr, size_t size);
+   void (*free)(void *ptr);
+
+   //! Free bytes in the heap behind the allocator, bounds the search for
+   //! the largest allocation.
+   size_t (*freeSize)(void);
+};
+
+typedef void (*BenchThreadFn)(uint32_t index, void *context);
+
+/*
+ * Provided by the platform (bench_cafe.c or bench_host.c).
+ */
+uint64_t
+benchGetTimeNs(void);
+
+uint32_t
+benchGetCoreCount(void);
+
+void
+benchYield(void);
+
+void
+benchRunThreads(uint32_t count,
+                BenchThreadFn func,
+                void *context);
+
+void
+benchOutput(const char *line);
+
+/*
+ * Run every benchmark against an allocator, scale multiplies the amount of
+ * work done by each case. Results are written as CSV lines:
+ *
+ *    allocator,case,threads,ops,ns,ops_per_sec,extra
+ */
+void
+benchPrintHeader(void);
+
+void
+benchRunAll(const BenchAllocator *allocator,
+            uint32_t scale);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,189 @@
+#include "bench.h"
+
+#include <coreinit/core.h>
+#include <coreinit/memexpheap.h>
+#include <coreinit/memheap.h>
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wut_heap.h>
+
+#include <whb/log.h>
+#include <whb/log_console.h>
+#include <whb/log_udp.h>
+#include <whb/proc.h>
+
+#define BENCH_SCALE       5
+#define CAFE_MAX_THREADS  3
+#define THREAD_STACK      (64 * 1024)
+
+/*
+ * Leave half of MEM2 outside of the newlib heap so the expanded heap
+ * allocator has the same amount of memory to work with.
+ */
+const WUTHeapLayout __wut_heap_layout = {
+   .mallocSize = WUT_HEAP_PERCENT(50),
+};
+
+static OSThread sThreads[CAFE_MAX_THREADS];
+static uint8_t sStacks[CAFE_MAX_THREADS][THREAD_STACK] __attribute__((aligned(16)));
+static BenchThreadFn sThreadFn;
+static void *sThreadContext;
+static MEMHeapHandle sHeap;
+
+uint64_t
+benchGetTimeNs(void)
+{
+   return (uint64_t)OSTicksToNanoseconds(OSGetSystemTime());
+}
+
+uint32_t
+benchGetCoreCount(void)
+{
+   return OSGetCoreCount();
+}
+
+void
+benchYield(void)
+{
+   OSYieldThread();
+}
+
+static int
+threadEntry(int argc,
+            const char **argv)
+{
+   sThreadFn((uint32_t)argc, sThreadContext);
+   return 0;
+}
+
+void
+benchRunThreads(uint32_t count,
+                BenchThreadFn func,
+                void *context)
+{
+   uint32_t i;
+
+   if (count > CAFE_MAX_THREADS) {
+      count = CAFE_MAX_THREADS;
+   }
+
+   sThreadFn      = func;
+   sThreadContext = context;
+
+   for (i = 0; i < count; ++i) {
+      OSCreateThread(&sThreads[i], threadEntry, (int32_t)i, NULL,
+                     sStacks[i] + THREAD_STACK, THREAD_STACK, 16,
+                     OS_THREAD_ATTRIB_AFFINITY_CPU0 << (i % 3));
+      OSResumeThread(&sThreads[i]);
+   }
+
+   for (i = 0; i < count; ++i) {
+      OSJoinThread(&sThreads[i], NULL);
+   }
+}
+
+void
+benchOutput(const char *line)
+{
+   WHBLogPrint(line);
+   WHBLogConsoleDraw();
+}
+
+static void *
+newlibAlloc(size_t size)
+{
+   return malloc(size);
+}
+
+static void *
+newlibRealloc(void *ptr, size_t size)
+{
+   return realloc(ptr, size);
+}
+
+static void
+newlibFree(void *ptr)
+{
+   free(ptr);
+}
+
+static void *
+expHeapAlloc(size_t size)
+{
+   return MEMAllocFromExpHeapEx(sHeap, (uint32_t)size, 0x40);
+}
+
+static void *
+expHeapRealloc(void *ptr, size_t size)
+{
+   void *newPtr;
+   uint32_t oldSize;
+
+   if (!ptr) {
+      return expHeapAlloc(size);
+   }
+
+   if (MEMResizeForMBlockExpHeap(sHeap, ptr, (uint32_t)size)) {
+      return ptr;
+   }
+
+   newPtr = expHeapAlloc(size);
+   if (newPtr) {
+      oldSize = MEMGetSizeForMBlockExpHeap(ptr);
+      memcpy(newPtr, ptr, oldSize < size ? oldSize : size);
+      MEMFreeToExpHeap(sHeap, ptr);
+   }
+
+   return newPtr;
+}
+
+static void
+expHeapFree(void *ptr)
+{
+   if (ptr) {
+      MEMFreeToExpHeap(sHeap, ptr);
+   }
+}
+
+static size_t
+newlibFreeSize(void)
+{
+   return WUTGetMallocHeapMaxSize();
+}
+
+static size_t
+expHeapFreeSize(void)
+{
+   return MEMGetTotalFreeSizeForExpHeap(sHeap);
+}
+
+static const BenchAllocator sNewlib  = { "newlib", newlibAlloc, newlibRealloc, newlibFree, newlibFreeSize };
+static const BenchAllocator sExpHeap = { "expheap", expHeapAlloc, expHeapRealloc, expHeapFree, expHeapFreeSize };
+
+int
+main(int argc, char **argv)
+{
+   WHBProcInit();
+   WHBLogConsoleInit();
+   WHBLogUdpInit();
+
+   sHeap = MEMGetBaseHeapHandle(MEM_BASE_HEAP_MEM2);
+
+   benchPrintHeader();
+   benchRunAll(&sNewlib, BENCH_SCALE);
+   benchRunAll(&sExpHeap, BENCH_SCALE);
+   malloc_stats();
+
+   while (WHBProcIsRunning()) {
+      WHBLogConsoleDraw();
+      OSSleepTicks(OSMillisecondsToTicks(100));
+   }
+
+   WHBLogUdpDeinit();
+   WHBLogConsoleFree();
+   WHBProcShutdown();
+   return 0;
+}
@@ -0,0 +1,241 @@
+#include "bench.h"
+#include "../host/host.h"
+
+#include <coreinit/memexpheap.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HOST_HEAP_SIZE     (256 * 1024 * 1024)
+#define HOST_CORE_HEAP     (32 * 1024 * 1024)
+#define HOST_MAX_THREADS   8
+
+extern uint32_t __wut_malloc_per_core_heap_size;
+
+void
+__init_wut_malloc(void);
+
+typedef struct
+{
+   BenchThreadFn func;
+   void *context;
+   uint32_t index;
+} HostThread;
+
+static MEMHeapHandle sHeap;
+static struct _reent sReent;
+
+uint64_t
+benchGetTimeNs(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint32_t
+benchGetCoreCount(void)
+{
+   // Match the console, OSGetCoreCount on the host stand-in returns 3
+   return 3;
+}
+
+void
+benchYield(void)
+{
+   sched_yield();
+}
+
+static void *
+hostThreadEntry(void *arg)
+{
+   HostThread *thread = (HostThread *)arg;
+   hostSetCoreId(thread->index % benchGetCoreCount());
+   thread->func(thread->index, thread->context);
+   return NULL;
+}
+
+void
+benchRunThreads(uint32_t count,
+                BenchThreadFn func,
+                void *context)
+{
+   pthread_t handles[HOST_MAX_THREADS];
+   HostThread threads[HOST_MAX_THREADS];
+   uint32_t i;
+
+   if (count > HOST_MAX_THREADS) {
+      count = HOST_MAX_THREADS;
+   }
+
+   for (i = 0; i < count; ++i) {
+      threads[i].func    = func;
+      threads[i].context = context;
+      threads[i].index   = i;
+      pthread_create(&handles[i], NULL, hostThreadEntry, &threads[i]);
+   }
+
+   for (i = 0; i < count; ++i) {
+      pthread_join(handles[i], NULL);
+   }
+}
+
+void
+benchOutput(const char *line)
+{
+   puts(line);
+   fflush(stdout);
+}
+
+static void *
+libcAlloc(size_t size)
+{
+   return malloc(size);
+}
+
+static void *
+libcRealloc(void *ptr, size_t size)
+{
+   return realloc(ptr, size);
+}
+
+static void
+libcFree(void *ptr)
+{
+   free(ptr);
+}
+
+static void *
+expHeapAlloc(size_t size)
+{
+   return MEMAllocFromExpHeapEx(sHeap, (uint32_t)size, 0x40);
+}
+
+static void *
+expHeapRealloc(void *ptr, size_t size)
+{
+   void *newPtr;
+   uint32_t oldSize;
+
+   if (!ptr) {
+      return expHeapAlloc(size);
+   }
+
+   if (MEMResizeForMBlockExpHeap(sHeap, ptr, (uint32_t)size)) {
+      return ptr;
+   }
+
+   newPtr = expHeapAlloc(size);
+   if (newPtr) {
+      oldSize = MEMGetSizeForMBlockExpHeap(ptr);
+      memcpy(newPtr, ptr, oldSize < size ? oldSize : size);
+      MEMFreeToExpHeap(sHeap, ptr);
+   }
+
+   return newPtr;
+}
+
+static void
+expHeapFree(void *ptr)
+{
+   if (ptr) {
+      MEMFreeToExpHeap(sHeap, ptr);
+   }
+}
+
+/*
+ * The wutmalloc entry points, built from libraries/wutmalloc for the host
+ * under their newlib reentrant names so they do not replace libc malloc.
+ */
+void *
+_malloc_r(struct _reent *r, size_t size);
+
+void *
+_realloc_r(struct _reent *r, void *ptr, size_t size);
+
+void
+_free_r(struct _reent *r, void *ptr);
+
+static void *
+wutAlloc(size_t size)
+{
+   return _malloc_r(&sReent, size);
+}
+
+static void *
+wutRealloc(void *ptr, size_t size)
+{
+   return _realloc_r(&sReent, ptr, size);
+}
+
+static void
+wutFree(void *ptr)
+{
+   _free_r(&sReent, ptr);
+}
+
+/*
+ * glibc maps large blocks on demand, so give it the same budget as the
+ * stand-in heap which backs both expheap and wutmalloc.
+ */
+static size_t
+libcFreeSize(void)
+{
+   return HOST_HEAP_SIZE;
+}
+
+static size_t
+expHeapFreeSize(void)
+{
+   return MEMGetTotalFreeSizeForExpHeap(sHeap);
+}
+
+static const BenchAllocator sLibc       = { "libc", libcAlloc, libcRealloc, libcFree, libcFreeSize };
+static const BenchAllocator sExpHeap    = { "expheap", expHeapAlloc, expHeapRealloc, expHeapFree, expHeapFreeSize };
+static const BenchAllocator sWutMalloc  = { "wutmalloc", wutAlloc, wutRealloc, wutFree, expHeapFreeSize };
+static const BenchAllocator sWutPerCore = { "wutmalloc_percore", wutAlloc, wutRealloc, wutFree, expHeapFreeSize };
+
+int
+main(int argc, char **argv)
+{
+   uint32_t scale = 5;
+
+   if (argc > 1) {
+      if (!strcmp(argv[1], "--quick")) {
+         scale = 1;
+      } else {
+         scale = (uint32_t)strtoul(argv[1], NULL, 0);
+         if (!scale) {
+            fprintf(stderr, "usage: %s [--quick | scale]\n", argv[0]);
+            return 1;
+         }
+      }
+   }
+
+   sHeap = hostInitDefaultHeap(HOST_HEAP_SIZE);
+   if (!sHeap) {
+      fprintf(stderr, "failed to create host default heap\n");
+      return 1;
+   }
+
+   benchPrintHeader();
+   benchRunAll(&sLibc, scale);
+   benchRunAll(&sExpHeap, scale);
+   benchRunAll(&sWutMalloc, scale);
+
+   // Per-core heaps can only be enabled once, so this has to run last
+   __wut_malloc_per_core_heap_size = HOST_CORE_HEAP;
+   __init_wut_malloc();
+   benchRunAll(&sWutPerCore, scale);
+
+   if (MEMGetTotalFreeSizeForExpHeap(sHeap) + 3 * HOST_CORE_HEAP + 0x1000 < HOST_HEAP_SIZE) {
+      fprintf(stderr, "leak detected in the host default heap\n");
+      return 1;
+   }
+
+   return 0;
+}
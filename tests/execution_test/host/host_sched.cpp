@@ -0,0 +1,59 @@
+#include <wut_sched.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#define HOST_NUM_WORKERS (3)
+
+/*
+ * Stand-in for the wut_sched WUTParallelFor, ranges are handed out to one
+ * thread per console core in whatever order they ask for them so the
+ * algorithms see the same interleaving as on the workers.
+ */
+void
+WUTParallelFor(uint32_t begin,
+               uint32_t end,
+               uint32_t grain,
+               WUTParallelForFn function,
+               void *arg)
+{
+   std::atomic<uint64_t> next { begin };
+   std::vector<std::thread> threads;
+
+   if (end <= begin) {
+      return;
+   }
+
+   if (!grain) {
+      grain = (end - begin) / (HOST_NUM_WORKERS * 4);
+      if (!grain) {
+         grain = 1;
+      }
+   }
+
+   auto worker = [&]() {
+      while (true) {
+         uint64_t rangeBegin = next.fetch_add(grain);
+         if (rangeBegin >= end) {
+            break;
+         }
+
+         uint64_t rangeEnd = rangeBegin + grain;
+         function(static_cast<uint32_t>(rangeBegin),
+                  static_cast<uint32_t>(rangeEnd < end ? rangeEnd : end),
+                  arg);
+      }
+   };
+
+   // The calling thread works too, like a wait on the console scheduler
+   for (uint32_t i = 1; i < HOST_NUM_WORKERS; ++i) {
+      threads.emplace_back(worker);
+   }
+
+   worker();
+
+   for (auto &thread : threads) {
+      thread.join();
+   }
+}
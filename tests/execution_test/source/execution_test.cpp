@@ -0,0 +1,281 @@
+#include "execution_test.h"
+
+#include <wut_execution.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+/*
+ * Sizes either side of the serial cutoff and the chunk boundaries, plus a
+ * few large ranges which are split across every worker.
+ */
+static const uint32_t sSizes[] = {
+   0, 1, 2, 511, 512, 1023, 1024, 1025, 4097, 65536, 100003, 262147,
+};
+
+static uint32_t sFailures = 0;
+static uint32_t sChecks   = 0;
+
+static void
+check(bool ok,
+      const char *name,
+      uint32_t size)
+{
+   char line[128];
+
+   sChecks++;
+   if (!ok) {
+      sFailures++;
+      snprintf(line, sizeof(line), "FAIL %s size=%u", name, (unsigned int)size);
+      testOutput(line);
+   }
+}
+
+static std::vector<int32_t>
+makeInput(uint32_t size,
+          uint32_t seed)
+{
+   std::vector<int32_t> values(size);
+
+   // Small values with plenty of duplicates to exercise the stable sort
+   for (auto &value : values) {
+      seed  = seed * 1664525u + 1013904223u;
+      value = static_cast<int32_t>(seed >> 20) - 2048;
+   }
+
+   return values;
+}
+
+static void
+testForEach(uint32_t size)
+{
+   auto expected = makeInput(size, 1);
+   auto actual   = expected;
+   auto bump     = [](int32_t &value) { value = value * 3 + 1; };
+
+   std::for_each(expected.begin(), expected.end(), bump);
+   wut::for_each(wut::execution::par, actual.begin(), actual.end(), bump);
+   check(actual == expected, "for_each", size);
+
+   actual = makeInput(size, 1);
+   auto end = wut::for_each_n(wut::execution::par_unseq, actual.begin(), size, bump);
+   check(actual == expected && end == actual.end(), "for_each_n", size);
+}
+
+static void
+testTransform(uint32_t size)
+{
+   auto a = makeInput(size, 2);
+   auto b = makeInput(size, 3);
+   std::vector<int32_t> expected(size), actual(size);
+
+   auto negate = [](int32_t value) { return -value; };
+   std::transform(a.begin(), a.end(), expected.begin(), negate);
+   auto end = wut::transform(wut::execution::par, a.begin(), a.end(), actual.begin(), negate);
+   check(actual == expected && end == actual.end(), "transform", size);
+
+   std::transform(a.begin(), a.end(), b.begin(), expected.begin(), std::minus<>());
+   end = wut::transform(wut::execution::par, a.begin(), a.end(), b.begin(), actual.begin(), std::minus<>());
+   check(actual == expected && end == actual.end(), "transform binary", size);
+}
+
+static void
+testReduce(uint32_t size)
+{
+   auto a = makeInput(size, 4);
+   auto b = makeInput(size, 5);
+
+   int64_t expected = std::accumulate(a.begin(), a.end(), int64_t { 7 });
+   check(wut::reduce(wut::execution::par, a.begin(), a.end(), int64_t { 7 }) == expected,
+         "reduce", size);
+
+   // Unsigned wraparound keeps the sum independent of the grouping
+   auto b32  = std::vector<uint32_t>(b.begin(), b.end());
+   uint32_t sum = std::accumulate(b32.begin(), b32.end(), 0u);
+   check(wut::reduce(wut::execution::par, b32.begin(), b32.end()) == sum,
+         "reduce default init", size);
+
+   auto maxOp = [](int32_t x, int32_t y) { return x > y ? x : y; };
+   int32_t max = std::accumulate(a.begin(), a.end(), INT32_MIN, maxOp);
+   check(wut::reduce(wut::execution::par, a.begin(), a.end(), INT32_MIN, maxOp) == max,
+         "reduce max", size);
+
+   auto square = [](int32_t value) { return static_cast<int64_t>(value) * value; };
+   int64_t squares = 0;
+   for (auto value : a) {
+      squares += square(value);
+   }
+   check(wut::transform_reduce(wut::execution::par, a.begin(), a.end(), int64_t { 0 },
+                               std::plus<>(), square) == squares,
+         "transform_reduce", size);
+
+   int64_t dot = std::inner_product(a.begin(), a.end(), b.begin(), int64_t { 0 },
+                                    std::plus<>(), [](int32_t x, int32_t y) {
+                                       return static_cast<int64_t>(x) * y;
+                                    });
+   check(wut::transform_reduce(wut::execution::par, a.begin(), a.end(), b.begin(), int64_t { 0 },
+                               std::plus<>(), [](int32_t x, int32_t y) {
+                                  return static_cast<int64_t>(x) * y;
+                               }) == dot,
+         "transform_reduce binary", size);
+}
+
+static void
+testScans(uint32_t size)
+{
+   auto input = makeInput(size, 6);
+   std::vector<int64_t> wide(input.begin(), input.end());
+   std::vector<int64_t> expected(size), actual(size);
+
+   std::partial_sum(wide.begin(), wide.end(), expected.begin());
+   auto end = wut::inclusive_scan(wut::execution::par, wide.begin(), wide.end(), actual.begin());
+   check(actual == expected && end == actual.end(), "inclusive_scan", size);
+
+   // In place, the output aliases the input
+   actual = wide;
+   wut::inclusive_scan(wut::execution::par, actual.begin(), actual.end(), actual.begin());
+   check(actual == expected, "inclusive_scan in place", size);
+
+   int64_t running = 100;
+   for (uint32_t i = 0; i < size; ++i) {
+      expected[i] = running;
+      running += wide[i];
+   }
+   end = wut::exclusive_scan(wut::execution::par, wide.begin(), wide.end(), actual.begin(), int64_t { 100 });
+   check(actual == expected && end == actual.end(), "exclusive_scan", size);
+
+   actual = wide;
+   wut::exclusive_scan(wut::execution::par, actual.begin(), actual.end(), actual.begin(), int64_t { 100 });
+   check(actual == expected, "exclusive_scan in place", size);
+
+   auto twice = [](int32_t value) { return static_cast<int64_t>(value) * 2; };
+   std::vector<int64_t> transformed(size);
+   std::transform(input.begin(), input.end(), transformed.begin(), twice);
+
+   std::partial_sum(transformed.begin(), transformed.end(), expected.begin());
+   end = wut::transform_inclusive_scan(wut::execution::par, input.begin(), input.end(), actual.begin(),
+                                       std::plus<>(), twice);
+   check(actual == expected && end == actual.end(), "transform_inclusive_scan", size);
+
+   running = -5;
+   for (uint32_t i = 0; i < size; ++i) {
+      expected[i] = running;
+      running += transformed[i];
+   }
+   end = wut::transform_exclusive_scan(wut::execution::par, input.begin(), input.end(), actual.begin(),
+                                       int64_t { -5 }, std::plus<>(), twice);
+   check(actual == expected && end == actual.end(), "transform_exclusive_scan", size);
+}
+
+/*
+ * Accumulator without a default constructor, which the standard scans and
+ * reductions do not require.
+ */
+struct Total
+{
+   explicit Total(int64_t value) :
+      value(value)
+   {
+   }
+
+   Total
+   operator+(int32_t other) const
+   {
+      return Total { value + other };
+   }
+
+   int64_t value;
+};
+
+static void
+testScanNoDefault(uint32_t size)
+{
+   auto input = makeInput(size, 9);
+   std::vector<Total> expected, actual;
+   Total running { 3 };
+
+   for (auto value : input) {
+      expected.push_back(running);
+      running = running + value;
+   }
+
+   // In place, which scans through a temporary buffer
+   for (auto value : input) {
+      actual.push_back(Total { value });
+   }
+
+   auto add = [](const Total &x, const Total &y) { return Total { x.value + y.value }; };
+   wut::exclusive_scan(wut::execution::par, actual.begin(), actual.end(), actual.begin(), Total { 3 }, add);
+
+   bool ok = actual.size() == expected.size();
+   for (uint32_t i = 0; ok && i < size; ++i) {
+      ok = actual[i].value == expected[i].value;
+   }
+   check(ok, "exclusive_scan in place no default", size);
+
+   Total sum = wut::reduce(wut::execution::par, actual.begin(), actual.end(), Total { 0 }, add);
+   int64_t expectedSum = 0;
+   for (auto &total : expected) {
+      expectedSum += total.value;
+   }
+   check(sum.value == expectedSum, "reduce no default", size);
+}
+
+static void
+testSorts(uint32_t size)
+{
+   auto expected = makeInput(size, 7);
+   auto actual   = expected;
+
+   std::sort(expected.begin(), expected.end());
+   wut::sort(wut::execution::par, actual.begin(), actual.end());
+   check(actual == expected, "sort", size);
+
+   actual = makeInput(size, 7);
+   wut::sort(wut::execution::par_unseq, actual.begin(), actual.end(), std::greater<>());
+   std::reverse(actual.begin(), actual.end());
+   check(actual == expected, "sort descending", size);
+
+   // Pair every key with its position, equal keys must keep their order
+   auto keys = makeInput(size, 8);
+   std::vector<std::pair<int32_t, uint32_t>> stableExpected(size);
+   for (uint32_t i = 0; i < size; ++i) {
+      stableExpected[i] = { keys[i] & 0xF, i };
+   }
+
+   auto stableActual = stableExpected;
+   auto byKey        = [](const std::pair<int32_t, uint32_t> &x, const std::pair<int32_t, uint32_t> &y) {
+      return x.first < y.first;
+   };
+
+   std::stable_sort(stableExpected.begin(), stableExpected.end(), byKey);
+   wut::stable_sort(wut::execution::par, stableActual.begin(), stableActual.end(), byKey);
+   check(stableActual == stableExpected, "stable_sort", size);
+}
+
+uint32_t
+testRunAll(void)
+{
+   char line[128];
+
+   sFailures = 0;
+   sChecks   = 0;
+
+   for (auto size : sSizes) {
+      testForEach(size);
+      testTransform(size);
+      testReduce(size);
+      testScans(size);
+      testScanNoDefault(size);
+      testSorts(size);
+   }
+
+   snprintf(line, sizeof(line), "%u of %u checks passed",
+            (unsigned int)(sChecks - sFailures), (unsigned int)sChecks);
+   testOutput(line);
+   return sFailures;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Provided by the platform (execution_test_cafe.cpp or
+ * execution_test_host.cpp).
+ */
+void
+testOutput(const char *line);
+
+/*
+ * Compare every wut::execution algorithm against its serial std:: version
+ * over a range of sizes, returns the number of failed checks.
+ */
+uint32_t
+testRunAll(void);
+
+#ifdef __cplusplus
+}
+#endif
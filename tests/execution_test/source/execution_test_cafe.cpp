@@ -0,0 +1,36 @@
+#include "execution_test.h"
+
+#include <coreinit/thread.h>
+#include <coreinit/time.h>
+
+#include <whb/log.h>
+#include <whb/log_console.h>
+#include <whb/log_udp.h>
+#include <whb/proc.h>
+
+void
+testOutput(const char *line)
+{
+   WHBLogPrint(line);
+   WHBLogConsoleDraw();
+}
+
+int
+main(int argc, char **argv)
+{
+   WHBProcInit();
+   WHBLogConsoleInit();
+   WHBLogUdpInit();
+
+   testRunAll();
+
+   while (WHBProcIsRunning()) {
+      WHBLogConsoleDraw();
+      OSSleepTicks(OSMillisecondsToTicks(100));
+   }
+
+   WHBLogUdpDeinit();
+   WHBLogConsoleFree();
+   WHBProcShutdown();
+   return 0;
+}
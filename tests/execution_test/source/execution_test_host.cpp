@@ -0,0 +1,16 @@
+#include "execution_test.h"
+
+#include <cstdio>
+
+void
+testOutput(const char *line)
+{
+   puts(line);
+   fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+   return testRunAll() ? 1 : 0;
+}
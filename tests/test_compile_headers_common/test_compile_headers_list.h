@@ -1,5 +1,17 @@
 #include <wut.h>
+#include <wut_coro.h>
+#include <wut_dns.h>
+#include <wut_execution.h>
+#include <wut_green.h>
+#include <wut_heap.h>
+#include <wut_lock.h>
+#include <wut_net.h>
+#include <wut_nssl_pool.h>
+#include <wut_pool.h>
+#include <wut_sched.h>
+#include <wut_socket_stats.h>
 #include <wut_structsize.h>
+#include <wut_thread.h>
 #include <wut_types.h>
 #include <avm/cec.h>
 #include <avm/config.h>